@@ -28,6 +28,8 @@
 
 #include <float.h>
 #include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,6 +43,23 @@ struct animation_node_s
     animation_node next, prev;
 };
 
+/** \brief private animation node with its values converted for the typed getters
+ *
+ * The values are converted with the fps and locale of the animation.
+ */
+typedef struct
+{
+    animation_node node;
+    int frame;
+    mlt_keyframe_type keyframe_type;
+    int is_color;   /**< whether the value is a color per mlt_property_is_color() */
+    int is_numeric; /**< whether the value is numeric per mlt_property_is_numeric() */
+    double value;
+    int int_value;
+    mlt_color color;
+    mlt_rect rect;
+} animation_key;
+
 /** \brief Property Animation class
  *
  * This is the animation engine for a Property object. It is dependent upon
@@ -54,6 +73,14 @@ struct mlt_animation_s
     double fps;          /**< framerate to use when converting time clock strings to frame units */
     mlt_locale_t locale; /**< pointer to a locale to use when converting strings to numeric values */
     animation_node nodes; /**< a linked list of keyframes (and possibly non-keyframe values) */
+    unsigned int generation;     /**< incremented whenever the nodes change */
+    animation_key *keys;         /**< the nodes as an array, see animation_keys() */
+    int key_count;               /**< the number of nodes in keys */
+    int key_size;                /**< the allocated size of keys */
+    int keys_sorted;             /**< whether the frames in keys are in ascending order */
+    atomic_uint keys_generation; /**< the generation of the nodes in keys */
+    atomic_int cursor;           /**< the index of the last key found, a search hint */
+    pthread_mutex_t keys_mutex;  /**< serializes rebuilding keys */
 };
 
 /** \brief Keyframe type to string mapping
@@ -111,6 +138,8 @@ static int interpolate_item(mlt_animation_item item,
                             mlt_animation_item p[],
                             double fps,
                             mlt_locale_t locale);
+static animation_key *animation_keys(mlt_animation self, int *count);
+static int animation_find(mlt_animation self, animation_key *keys, int count, int position);
 
 static const char *keyframe_type_to_str(mlt_keyframe_type t)
 {
@@ -145,6 +174,8 @@ static mlt_keyframe_type str_to_keyframe_type(const char *s)
 mlt_animation mlt_animation_new()
 {
     mlt_animation self = calloc(1, sizeof(*self));
+    if (self)
+        pthread_mutex_init(&self->keys_mutex, NULL);
     return self;
 }
 
@@ -156,6 +187,9 @@ mlt_animation mlt_animation_new()
 
 void mlt_animation_interpolate(mlt_animation self)
 {
+    if (self)
+        self->generation++;
+
     // Parse all items to ensure non-keyframes are calculated correctly.
     if (self && self->nodes) {
         animation_node current = self->nodes;
@@ -200,6 +234,7 @@ void mlt_animation_interpolate(mlt_animation self)
 
 static int mlt_animation_drop(mlt_animation self, animation_node node)
 {
+    self->generation++;
     if (node == self->nodes) {
         self->nodes = node->next;
         if (self->nodes) {
@@ -457,11 +492,9 @@ int mlt_animation_get_item(mlt_animation self, mlt_animation_item item, int posi
 
     int error = 0;
     // Need to find the nearest keyframe to the position specified
-    animation_node node = self->nodes;
-
-    // Iterate through the keyframes until we reach last or have
-    while (node && node->next && position >= node->next->item.frame)
-        node = node->next;
+    int count = 0;
+    animation_key *keys = animation_keys(self, &count);
+    animation_node node = count ? keys[animation_find(self, keys, count, position)].node : NULL;
 
     if (node) {
         item->keyframe_type = node->item.keyframe_type;
@@ -522,6 +555,7 @@ int mlt_animation_insert(mlt_animation self, mlt_animation_item item)
 
     int error = 0;
     animation_node node = calloc(1, sizeof(*node));
+    self->generation++;
     node->item.frame = item->frame;
     node->item.is_key = 1;
     node->item.keyframe_type = item->keyframe_type;
@@ -904,6 +938,8 @@ void mlt_animation_close(mlt_animation self)
 {
     if (self) {
         mlt_animation_clean(self);
+        free(self->keys);
+        pthread_mutex_destroy(&self->keys_mutex);
         free(self);
     }
 }
@@ -1008,6 +1044,22 @@ const char *mlt_animation_get_string(mlt_animation self)
     return self->data;
 }
 
+/** Get a number that changes whenever the keyframes change.
+ *
+ * This can be used to cache something derived from the animation because,
+ * unlike the string, it is not affected by serialization.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \return the generation of the keyframes
+ */
+
+unsigned int mlt_animation_get_generation(mlt_animation self)
+{
+    if (!self)
+        return 0;
+    return self->generation;
+}
+
 /** Clear the cached serialization string.
  *
  * \private \memberof mlt_animation_s
@@ -1042,7 +1094,7 @@ static inline double distance(double x0, double y0, double x1, double y1)
     return sqrt(pow(x1 - x0, 2) + pow(y1 - y0, 2));
 }
 
-/** A Catmull–Rom interpolation function.
+/** Compute the cubic polynomial of a Catmull–Rom interpolation function.
  *
  * As described here:
  *   https://en.wikipedia.org/wiki/Centripetal_Catmull%E2%80%93Rom_spline
@@ -1071,20 +1123,21 @@ static inline double distance(double x0, double y0, double x1, double y1)
  *      0.0 results in a horizontal tangent at x1,y1 and x2,y2 (slope of 0).
  *      -1.0 results in the most natural slope at x1,y1 and x2,y2 unless x1 or x2 represents a peak.
  *      In the case of peaks, a horizontal tangent will be used to avoid overshoot.
+ * \param[out] coefficients a, b, c and d of a * t^3 + b * t^2 + c * t + d
 
  */
 
-static inline double catmull_rom_interpolate(double x0,
-                                             double y0,
-                                             double x1,
-                                             double y1,
-                                             double x2,
-                                             double y2,
-                                             double x3,
-                                             double y3,
-                                             double t,
-                                             double alpha,
-                                             double tension)
+static inline void catmull_rom_coefficients(double x0,
+                                            double y0,
+                                            double x1,
+                                            double y1,
+                                            double x2,
+                                            double y2,
+                                            double x3,
+                                            double y3,
+                                            double alpha,
+                                            double tension,
+                                            double coefficients[4])
 {
     // Correct first and last values.
     // If points are duplicated (e.g. for the first and last segments) assume the duplicated point
@@ -1107,13 +1160,48 @@ static inline double catmull_rom_interpolate(double x0,
         double t23 = pow(distance(x2, y2, x3, y3), alpha);
         m2 = fabs(tension) * (y2 - y1 + t12 * ((y3 - y2) / t23 - (y3 - y1) / (t12 + t23)));
     }
-    double a = 2.0 * (y1 - y2) + m1 + m2;
-    double b = -3.0 * (y1 - y2) - m1 - m1 - m2;
-    double c = m1;
-    double d = y1;
+    coefficients[0] = 2.0 * (y1 - y2) + m1 + m2;
+    coefficients[1] = -3.0 * (y1 - y2) - m1 - m1 - m2;
+    coefficients[2] = m1;
+    coefficients[3] = y1;
+}
+
+/** Evaluate a polynomial from catmull_rom_coefficients() at progress \p t.
+ *
+ * \private \memberof mlt_animation_s
+ */
+
+static inline double catmull_rom_evaluate(const double coefficients[4], double t)
+{
+    double a = coefficients[0];
+    double b = coefficients[1];
+    double c = coefficients[2];
+    double d = coefficients[3];
     return a * t * t * t + b * t * t + c * t + d;
 }
 
+/** A Catmull–Rom interpolation function, see catmull_rom_coefficients().
+ *
+ * \private \memberof mlt_animation_s
+ */
+
+static inline double catmull_rom_interpolate(double x0,
+                                             double y0,
+                                             double x1,
+                                             double y1,
+                                             double x2,
+                                             double y2,
+                                             double x3,
+                                             double y3,
+                                             double t,
+                                             double alpha,
+                                             double tension)
+{
+    double coefficients[4];
+    catmull_rom_coefficients(x0, y0, x1, y1, x2, y2, x3, y3, alpha, tension, coefficients);
+    return catmull_rom_evaluate(coefficients, t);
+}
+
 /** Easing functions
  *
  * The following easing functions are based on Robert Penner's Easing Functions
@@ -1514,3 +1602,625 @@ static int interpolate_item(mlt_animation_item item,
     }
     return error;
 }
+
+/** Get the nodes of the animation as an array, converting their values.
+ *
+ * The array is rebuilt on first use after the nodes change.
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param[out] count the number of keys
+ * \return the keys
+ */
+
+static animation_key *animation_keys(mlt_animation self, int *count)
+{
+    unsigned int generation = self->generation;
+
+    if (atomic_load_explicit(&self->keys_generation, memory_order_acquire) != generation) {
+        pthread_mutex_lock(&self->keys_mutex);
+        if (atomic_load_explicit(&self->keys_generation, memory_order_relaxed) != generation) {
+            animation_node node;
+            int n = 0;
+
+            for (node = self->nodes; node; node = node->next)
+                n++;
+            if (n > self->key_size) {
+                free(self->keys);
+                self->key_size = n;
+                self->keys = malloc(n * sizeof(*self->keys));
+            }
+            self->keys_sorted = 1;
+            for (node = self->nodes, n = 0; node; node = node->next, n++) {
+                animation_key *key = &self->keys[n];
+                mlt_property property = node->item.property;
+
+                key->node = node;
+                key->frame = node->item.frame;
+                key->keyframe_type = node->item.keyframe_type;
+                key->is_color = mlt_property_is_color(property);
+                key->is_numeric = mlt_property_is_numeric(property, self->locale);
+                key->value = mlt_property_get_double(property, self->fps, self->locale);
+                key->int_value = mlt_property_get_int(property, self->fps, self->locale);
+                key->color = mlt_property_get_color(property, self->fps, self->locale);
+                key->rect = mlt_property_get_rect(property, self->locale);
+                if (n > 0 && key->frame < key[-1].frame)
+                    self->keys_sorted = 0;
+            }
+            self->key_count = n;
+            atomic_store_explicit(&self->keys_generation, generation, memory_order_release);
+        }
+        pthread_mutex_unlock(&self->keys_mutex);
+    }
+    *count = self->key_count;
+    return self->keys;
+}
+
+/** Find the index of the node that precedes or is at a position.
+ *
+ * This is the last node at or before the position, or the first node if the
+ * position is before it. The previous result is tried first, followed by
+ * the node after it to suit sequential access, before a binary search.
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param keys the keys from animation_keys()
+ * \param count the number of keys (> 0)
+ * \param position the frame number
+ * \return the index into keys
+ */
+
+static int animation_find(mlt_animation self, animation_key *keys, int count, int position)
+{
+    int i = atomic_load_explicit(&self->cursor, memory_order_relaxed);
+
+    if (!self->keys_sorted) {
+        // Match the order of the list when the frames were changed out of order.
+        for (i = 0; i + 1 < count && position >= keys[i + 1].frame;)
+            i++;
+        return i;
+    }
+    if (i >= count || (i > 0 && keys[i].frame > position)) {
+        i = -1;
+    } else if (i + 1 < count && keys[i + 1].frame <= position) {
+        i++;
+        if (i + 1 < count && keys[i + 1].frame <= position)
+            i = -1;
+    }
+    if (i < 0) {
+        int low = 0;
+        int high = count - 1;
+        while (low < high) {
+            int middle = low + (high - low + 1) / 2;
+            if (keys[middle].frame <= position)
+                low = middle;
+            else
+                high = middle - 1;
+        }
+        i = low;
+    }
+    atomic_store_explicit(&self->cursor, i, memory_order_relaxed);
+    return i;
+}
+
+/** The kinds of result from animation_segment() */
+
+typedef enum {
+    segment_none,       /**< the animation is empty */
+    segment_key,        /**< the value is that of the first key */
+    segment_interpolate /**< the value is interpolated between the keys */
+} segment_type;
+
+/** Find the keys needed to get the value at a position.
+ *
+ * This follows mlt_animation_get_item(), but it does not copy any property.
+ * \private \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \param[out] p the four keys around the position, only p[1] is set unless interpolating
+ * \param[out] progress the position between p[1] and p[2] when interpolating
+ * \return the kind of result
+ */
+
+static segment_type animation_segment(mlt_animation self,
+                                      int position,
+                                      animation_key *p[],
+                                      double *progress)
+{
+    int count = 0;
+    animation_key *keys = animation_keys(self, &count);
+
+    if (!count)
+        return segment_none;
+
+    int i = animation_find(self, keys, count, position);
+    p[1] = &keys[i];
+    if (position <= keys[i].frame || i + 1 == count
+        || keys[i].keyframe_type == mlt_keyframe_discrete)
+        return segment_key;
+
+    p[0] = i > 0 ? &keys[i - 1] : &keys[i];
+    p[2] = &keys[i + 1];
+    p[3] = i + 2 < count ? &keys[i + 2] : &keys[i + 1];
+    *progress = (double) (position - p[1]->frame) / (double) (p[2]->frame - p[1]->frame);
+    return segment_interpolate;
+}
+
+/** Interpolate the color of a segment, following interpolate_item().
+ *
+ * \private \memberof mlt_animation_s
+ */
+
+static mlt_color interpolate_key_color(animation_key *p[], double progress)
+{
+    mlt_color value;
+    mlt_keyframe_type type = p[1]->keyframe_type;
+    value.r = CLAMP(interpolate_value(p[0]->frame,
+                                      p[0]->color.r,
+                                      p[1]->frame,
+                                      p[1]->color.r,
+                                      p[2]->frame,
+                                      p[2]->color.r,
+                                      p[3]->frame,
+                                      p[3]->color.r,
+                                      progress,
+                                      type),
+                    0,
+                    255);
+    value.g = CLAMP(interpolate_value(p[0]->frame,
+                                      p[0]->color.g,
+                                      p[1]->frame,
+                                      p[1]->color.g,
+                                      p[2]->frame,
+                                      p[2]->color.g,
+                                      p[3]->frame,
+                                      p[3]->color.g,
+                                      progress,
+                                      type),
+                    0,
+                    255);
+    value.b = CLAMP(interpolate_value(p[0]->frame,
+                                      p[0]->color.b,
+                                      p[1]->frame,
+                                      p[1]->color.b,
+                                      p[2]->frame,
+                                      p[2]->color.b,
+                                      p[3]->frame,
+                                      p[3]->color.b,
+                                      progress,
+                                      type),
+                    0,
+                    255);
+    value.a = CLAMP(interpolate_value(p[0]->frame,
+                                      p[0]->color.a,
+                                      p[1]->frame,
+                                      p[1]->color.a,
+                                      p[2]->frame,
+                                      p[2]->color.a,
+                                      p[3]->frame,
+                                      p[3]->color.a,
+                                      progress,
+                                      type),
+                    0,
+                    255);
+    return value;
+}
+
+/** Interpolate the number of a segment, following interpolate_item().
+ *
+ * \private \memberof mlt_animation_s
+ */
+
+static inline double interpolate_key_value(animation_key *p[], double progress)
+{
+    return interpolate_value(p[0]->frame,
+                             p[0]->value,
+                             p[1]->frame,
+                             p[1]->value,
+                             p[2]->frame,
+                             p[2]->value,
+                             p[3]->frame,
+                             p[3]->value,
+                             progress,
+                             p[1]->keyframe_type);
+}
+
+/** Pack a color as mlt_property_set_color() does.
+ *
+ * \private \memberof mlt_animation_s
+ */
+
+static inline int color_to_int(mlt_color color)
+{
+    return (int) (((uint32_t) color.r << 24) | (color.g << 16) | (color.b << 8) | color.a);
+}
+
+/** Get the real number at a frame position.
+ *
+ * This gives the same result as mlt_animation_get_item() followed by
+ * mlt_property_get_double() but without allocating or copying a property.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \param fps the frame rate to use when converting the value of a keyframe
+ * \param locale the locale to use when converting the value of a keyframe
+ * \return the real number
+ */
+
+double mlt_animation_get_double(mlt_animation self,
+                                int position,
+                                double fps,
+                                mlt_locale_t locale)
+{
+    animation_key *p[4];
+    double progress;
+
+    if (!self)
+        return 0.0;
+    switch (animation_segment(self, position, p, &progress)) {
+    case segment_none:
+        return 0.0;
+    case segment_interpolate:
+        if (p[1]->is_color)
+            return (double) color_to_int(interpolate_key_color(p, progress));
+        if (p[1]->is_numeric)
+            return interpolate_key_value(p, progress);
+        break;
+    case segment_key:
+        break;
+    }
+    if (fps == self->fps && locale == self->locale)
+        return p[1]->value;
+    return mlt_property_get_double(p[1]->node->item.property, fps, locale);
+}
+
+/** Get the integer at a frame position.
+ *
+ * This gives the same result as mlt_animation_get_item() followed by
+ * mlt_property_get_int() but without allocating or copying a property.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \param fps the frame rate to use when converting the value of a keyframe
+ * \param locale the locale to use when converting the value of a keyframe
+ * \return the integer
+ */
+
+int mlt_animation_get_int(mlt_animation self, int position, double fps, mlt_locale_t locale)
+{
+    animation_key *p[4];
+    double progress;
+
+    if (!self)
+        return 0;
+    switch (animation_segment(self, position, p, &progress)) {
+    case segment_none:
+        return 0;
+    case segment_interpolate:
+        if (p[1]->is_color)
+            return color_to_int(interpolate_key_color(p, progress));
+        if (p[1]->is_numeric)
+            return (int) interpolate_key_value(p, progress);
+        break;
+    case segment_key:
+        break;
+    }
+    if (fps == self->fps && locale == self->locale)
+        return p[1]->int_value;
+    return mlt_property_get_int(p[1]->node->item.property, fps, locale);
+}
+
+/** Get the color at a frame position.
+ *
+ * This gives the same result as mlt_animation_get_item() followed by
+ * mlt_property_get_color() but without allocating or copying a property.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \param fps the frame rate to use when converting the value of a keyframe
+ * \param locale the locale to use when converting the value of a keyframe
+ * \return the color
+ */
+
+mlt_color mlt_animation_get_color(mlt_animation self,
+                                  int position,
+                                  double fps,
+                                  mlt_locale_t locale)
+{
+    mlt_color result = {0, 0, 0, 0};
+    animation_key *p[4];
+    double progress;
+
+    if (!self)
+        return result;
+    switch (animation_segment(self, position, p, &progress)) {
+    case segment_none:
+        return result;
+    case segment_interpolate:
+        if (p[1]->is_color)
+            return interpolate_key_color(p, progress);
+        if (p[1]->is_numeric) {
+            int value = (int) interpolate_key_value(p, progress);
+            result.r = (value >> 24) & 0xff;
+            result.g = (value >> 16) & 0xff;
+            result.b = (value >> 8) & 0xff;
+            result.a = value & 0xff;
+            return result;
+        }
+        break;
+    case segment_key:
+        break;
+    }
+    if (fps == self->fps && locale == self->locale)
+        return p[1]->color;
+    return mlt_property_get_color(p[1]->node->item.property, fps, locale);
+}
+
+/** Get the rectangle at a frame position.
+ *
+ * This gives the same result as mlt_animation_get_item() followed by
+ * mlt_property_get_rect() but without allocating or copying a property.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param position the frame number
+ * \param locale the locale to use when converting the value of a keyframe
+ * \return the rectangle
+ */
+
+mlt_rect mlt_animation_get_rect(mlt_animation self, int position, mlt_locale_t locale)
+{
+    mlt_rect result = {DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN, DBL_MIN};
+    animation_key *p[4];
+    double progress;
+
+    if (!self)
+        return result;
+    switch (animation_segment(self, position, p, &progress)) {
+    case segment_none:
+        return result;
+    case segment_interpolate:
+        if (p[1]->is_color) {
+            result.x = color_to_int(interpolate_key_color(p, progress));
+        } else {
+            mlt_keyframe_type type = p[1]->keyframe_type;
+            result.x = interpolate_value(p[0]->frame,
+                                         p[0]->rect.x,
+                                         p[1]->frame,
+                                         p[1]->rect.x,
+                                         p[2]->frame,
+                                         p[2]->rect.x,
+                                         p[3]->frame,
+                                         p[3]->rect.x,
+                                         progress,
+                                         type);
+            result.y = interpolate_value(p[0]->frame,
+                                         p[0]->rect.y,
+                                         p[1]->frame,
+                                         p[1]->rect.y,
+                                         p[2]->frame,
+                                         p[2]->rect.y,
+                                         p[3]->frame,
+                                         p[3]->rect.y,
+                                         progress,
+                                         type);
+            result.w = interpolate_value(p[0]->frame,
+                                         p[0]->rect.w,
+                                         p[1]->frame,
+                                         p[1]->rect.w,
+                                         p[2]->frame,
+                                         p[2]->rect.w,
+                                         p[3]->frame,
+                                         p[3]->rect.w,
+                                         progress,
+                                         type);
+            result.h = interpolate_value(p[0]->frame,
+                                         p[0]->rect.h,
+                                         p[1]->frame,
+                                         p[1]->rect.h,
+                                         p[2]->frame,
+                                         p[2]->rect.h,
+                                         p[3]->frame,
+                                         p[3]->rect.h,
+                                         progress,
+                                         type);
+            result.o = interpolate_value(p[0]->frame,
+                                         p[0]->rect.o,
+                                         p[1]->frame,
+                                         p[1]->rect.o,
+                                         p[2]->frame,
+                                         p[2]->rect.o,
+                                         p[3]->frame,
+                                         p[3]->rect.o,
+                                         progress,
+                                         type);
+        }
+        return result;
+    case segment_key:
+        break;
+    }
+    if (locale == self->locale)
+        return p[1]->rect;
+    return mlt_property_get_rect(p[1]->node->item.property, locale);
+}
+
+/** Sample the interpolated numbers of a segment.
+ *
+ * This follows interpolate_value(), but the easing is chosen once for the
+ * whole segment so that each case is a loop of its own.
+ * \private \memberof mlt_animation_s
+ * \param p the four keys around the segment as from animation_segment()
+ * \param position the first frame number, after p[1]
+ * \param count the number of frames, ending at or before p[2]
+ * \param[out] values the numbers
+ */
+
+static void sample_segment(animation_key *p[], int position, int count, double *values)
+{
+    double x0 = p[0]->frame, y0 = p[0]->value;
+    double x1 = p[1]->frame, y1 = p[1]->value;
+    double x2 = p[2]->frame, y2 = p[2]->value;
+    double x3 = p[3]->frame, y3 = p[3]->value;
+    double span = p[2]->frame - p[1]->frame;
+    int offset = position - p[1]->frame;
+    double coefficients[4];
+    int n;
+
+#define SAMPLE(expression) \
+    for (n = 0; n < count; n++) { \
+        double t = (double) (offset + n) / span; \
+        values[n] = (expression); \
+    } \
+    return
+
+    switch (p[1]->keyframe_type) {
+    case mlt_keyframe_discrete:
+        break;
+    case mlt_keyframe_linear:
+        SAMPLE(linear_interpolate(y1, y2, t));
+    case mlt_keyframe_smooth_loose:
+        catmull_rom_coefficients(x0, y0, x1, y1, x2, y2, x3, y3, 0.0, 1.0, coefficients);
+        SAMPLE(catmull_rom_evaluate(coefficients, t));
+    case mlt_keyframe_smooth_natural:
+        catmull_rom_coefficients(x0, y0, x1, y1, x2, y2, x3, y3, 0.5, -1.0, coefficients);
+        SAMPLE(catmull_rom_evaluate(coefficients, t));
+    case mlt_keyframe_smooth_tight:
+        catmull_rom_coefficients(x0, y0, x1, y1, x2, y2, x3, y3, 0.5, 0.0, coefficients);
+        SAMPLE(catmull_rom_evaluate(coefficients, t));
+    case mlt_keyframe_sinusoidal_in:
+        SAMPLE(sinusoidal_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_sinusoidal_out:
+        SAMPLE(sinusoidal_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_sinusoidal_in_out:
+        SAMPLE(sinusoidal_interpolate(y1, y2, t, ease_inout));
+    case mlt_keyframe_quadratic_in:
+        SAMPLE(power_interpolate(y1, y2, t, 2, ease_in));
+    case mlt_keyframe_quadratic_out:
+        SAMPLE(power_interpolate(y1, y2, t, 2, ease_out));
+    case mlt_keyframe_quadratic_in_out:
+        SAMPLE(power_interpolate(y1, y2, t, 2, ease_inout));
+    case mlt_keyframe_cubic_in:
+        SAMPLE(power_interpolate(y1, y2, t, 3, ease_in));
+    case mlt_keyframe_cubic_out:
+        SAMPLE(power_interpolate(y1, y2, t, 3, ease_out));
+    case mlt_keyframe_cubic_in_out:
+        SAMPLE(power_interpolate(y1, y2, t, 3, ease_inout));
+    case mlt_keyframe_quartic_in:
+        SAMPLE(power_interpolate(y1, y2, t, 4, ease_in));
+    case mlt_keyframe_quartic_out:
+        SAMPLE(power_interpolate(y1, y2, t, 4, ease_out));
+    case mlt_keyframe_quartic_in_out:
+        SAMPLE(power_interpolate(y1, y2, t, 4, ease_inout));
+    case mlt_keyframe_quintic_in:
+        SAMPLE(power_interpolate(y1, y2, t, 5, ease_in));
+    case mlt_keyframe_quintic_out:
+        SAMPLE(power_interpolate(y1, y2, t, 5, ease_out));
+    case mlt_keyframe_quintic_in_out:
+        SAMPLE(power_interpolate(y1, y2, t, 5, ease_inout));
+    case mlt_keyframe_exponential_in:
+        SAMPLE(exponential_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_exponential_out:
+        SAMPLE(exponential_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_exponential_in_out:
+        SAMPLE(exponential_interpolate(y1, y2, t, ease_inout));
+    case mlt_keyframe_circular_in:
+        SAMPLE(circular_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_circular_out:
+        SAMPLE(circular_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_circular_in_out:
+        SAMPLE(circular_interpolate(y1, y2, t, ease_inout));
+    case mlt_keyframe_back_in:
+        SAMPLE(back_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_back_out:
+        SAMPLE(back_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_back_in_out:
+        SAMPLE(back_interpolate(y1, y2, t, ease_inout));
+    case mlt_keyframe_elastic_in:
+        SAMPLE(elastic_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_elastic_out:
+        SAMPLE(elastic_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_elastic_in_out:
+        SAMPLE(elastic_interpolate(y1, y2, t, ease_inout));
+    case mlt_keyframe_bounce_in:
+        SAMPLE(bounce_interpolate(y1, y2, t, ease_in));
+    case mlt_keyframe_bounce_out:
+        SAMPLE(bounce_interpolate(y1, y2, t, ease_out));
+    case mlt_keyframe_bounce_in_out:
+        SAMPLE(bounce_interpolate(y1, y2, t, ease_inout));
+    }
+#undef SAMPLE
+
+    for (n = 0; n < count; n++)
+        values[n] = y1;
+}
+
+/** Get the real numbers for a range of frame positions.
+ *
+ * This gives the same results as calling mlt_animation_get_double() for each
+ * position with the frame rate and locale of the animation, apart from rounding,
+ * but it finds the keyframes and chooses the interpolation only once per segment.
+ * Use it for values at many consecutive positions such as per audio sample.
+ * \public \memberof mlt_animation_s
+ * \param self an animation
+ * \param start the first frame number
+ * \param end the frame number after the last
+ * \param[out] values an array of \p end - \p start numbers to fill
+ * \return true if there was an error
+ */
+
+int mlt_animation_sample(mlt_animation self, int start, int end, double *values)
+{
+    if (!self || !values || end < start)
+        return 1;
+
+    int count = 0;
+    animation_key *keys = animation_keys(self, &count);
+    int position = start;
+
+    if (!count) {
+        memset(values, 0, (end - start) * sizeof(*values));
+        return 0;
+    }
+    if (!self->keys_sorted) {
+        for (; position < end; position++)
+            values[position - start] = mlt_animation_get_double(self,
+                                                                position,
+                                                                self->fps,
+                                                                self->locale);
+        return 0;
+    }
+
+    int i = animation_find(self, keys, count, start);
+    while (position < end) {
+        animation_key *p[4];
+        int stop;
+
+        while (i + 1 < count && keys[i + 1].frame <= position)
+            i++;
+        p[1] = &keys[i];
+        if (position <= p[1]->frame || i + 1 == count) {
+            // The value of the key applies up to and including its frame.
+            stop = i + 1 == count ? end : MIN(end, p[1]->frame + 1);
+            for (; position < stop; position++)
+                values[position - start] = p[1]->value;
+            continue;
+        }
+
+        p[0] = i > 0 ? &keys[i - 1] : &keys[i];
+        p[2] = &keys[i + 1];
+        p[3] = i + 2 < count ? &keys[i + 2] : &keys[i + 1];
+        stop = MIN(end, p[2]->frame);
+        if (p[1]->keyframe_type != mlt_keyframe_discrete && p[1]->is_color) {
+            for (; position < stop; position++) {
+                double progress = (double) (position - p[1]->frame)
+                                  / (double) (p[2]->frame - p[1]->frame);
+                mlt_color color = interpolate_key_color(p, progress);
+                values[position - start] = color_to_int(color);
+            }
+        } else if (p[1]->keyframe_type == mlt_keyframe_discrete || !p[1]->is_numeric) {
+            for (; position < stop; position++)
+                values[position - start] = p[1]->value;
+        } else {
+            sample_segment(p, position, stop - position, &values[position - start]);
+            position = stop;
+        }
+    }
+    return 0;
+}
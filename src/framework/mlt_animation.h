@@ -72,5 +72,17 @@ extern int mlt_animation_key_set_type(mlt_animation self, int index, mlt_keyfram
 extern int mlt_animation_key_set_frame(mlt_animation self, int index, int frame);
 extern void mlt_animation_shift_frames(mlt_animation self, int shift);
 extern const char *mlt_animation_get_string(mlt_animation self);
+extern unsigned int mlt_animation_get_generation(mlt_animation self);
+extern double mlt_animation_get_double(mlt_animation self,
+                                       int position,
+                                       double fps,
+                                       mlt_locale_t locale);
+extern int mlt_animation_get_int(mlt_animation self, int position, double fps, mlt_locale_t locale);
+extern mlt_color mlt_animation_get_color(mlt_animation self,
+                                         int position,
+                                         double fps,
+                                         mlt_locale_t locale);
+extern mlt_rect mlt_animation_get_rect(mlt_animation self, int position, mlt_locale_t locale);
+extern int mlt_animation_sample(mlt_animation self, int start, int end, double *values);
 
 #endif
@@ -774,3 +774,210 @@ mlt_channel_layout mlt_audio_channel_layout_default(int channels)
     }
     return mlt_channel_independent;
 }
+
+/** \brief Audio FIFO class
+ *
+ * A ring buffer of interleaved samples whose capacity is a power of two.
+ * A reader can encode straight from the buffer using mlt_audio_fifo_peek().
+ * When a write needs more room, the samples are copied to a larger buffer,
+ * so do not keep the pointers from mlt_audio_fifo_peek() across writes.
+ * An audio FIFO is not thread safe.
+ */
+
+struct mlt_audio_fifo_s
+{
+    uint8_t *buffer;
+    int sample_size;    /**< bytes per sample for all channels */
+    unsigned int size;  /**< capacity in samples, a power of two */
+    unsigned int read;  /**< position of the first sample to read */
+    unsigned int write; /**< position of the next sample to write */
+};
+
+/** Create a new audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param format an interleaved audio format
+ * \param channels the number of channels
+ * \return a new audio FIFO or NULL if the format is planar or invalid
+ */
+
+mlt_audio_fifo mlt_audio_fifo_new(mlt_audio_format format, int channels)
+{
+    if (format == mlt_audio_s32 || format == mlt_audio_float || channels <= 0)
+        return NULL;
+    int sample_size = mlt_audio_format_size(format, 1, channels);
+    if (sample_size <= 0)
+        return NULL;
+    mlt_audio_fifo self = calloc(1, sizeof(struct mlt_audio_fifo_s));
+    if (self)
+        self->sample_size = sample_size;
+    return self;
+}
+
+/** Destroy an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ */
+
+void mlt_audio_fifo_close(mlt_audio_fifo self)
+{
+    if (self) {
+        free(self->buffer);
+        free(self);
+    }
+}
+
+/** Get the number of samples in an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \return the number of samples waiting to be read
+ */
+
+int mlt_audio_fifo_samples(mlt_audio_fifo self)
+{
+    return self ? self->write - self->read : 0;
+}
+
+/** Grow the buffer to hold at least a number of samples.
+ *
+ * \private \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \param samples the number of samples to hold
+ * \return true if there was an error
+ */
+
+static int fifo_reserve(mlt_audio_fifo self, unsigned int samples)
+{
+    unsigned int size = self->size ? self->size : 1024;
+
+    if (samples <= self->size)
+        return 0;
+    while (size < samples) {
+        if (size > INT_MAX / 2 / (unsigned int) self->sample_size)
+            return 1;
+        size <<= 1;
+    }
+
+    uint8_t *buffer = malloc((size_t) size * self->sample_size);
+    if (!buffer)
+        return 1;
+    unsigned int used = self->write - self->read;
+    mlt_audio_fifo_read(self, buffer, used);
+    free(self->buffer);
+    self->buffer = buffer;
+    self->size = size;
+    self->read = 0;
+    self->write = used;
+    return 0;
+}
+
+/** Append interleaved samples to an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \param data the samples
+ * \param samples the number of samples
+ * \return the number of samples written, less than \p samples only when out of memory
+ */
+
+int mlt_audio_fifo_write(mlt_audio_fifo self, const void *data, int samples)
+{
+    if (!self || !data || samples <= 0)
+        return 0;
+    if (fifo_reserve(self, self->write - self->read + samples))
+        return 0;
+
+    unsigned int offset = self->write & (self->size - 1);
+    unsigned int first = MIN((unsigned int) samples, self->size - offset);
+    memcpy(self->buffer + (size_t) offset * self->sample_size, data, first * self->sample_size);
+    memcpy(self->buffer,
+           (const uint8_t *) data + (size_t) first * self->sample_size,
+           (samples - first) * self->sample_size);
+    self->write += samples;
+    return samples;
+}
+
+/** Get the location of samples in an audio FIFO without removing them.
+ *
+ * The samples may wrap around the end of the buffer, so they are returned as
+ * up to two spans. The second span has zero samples when the first one holds
+ * them all. The spans remain valid until the next write to the FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \param samples the maximum number of samples to peek
+ * \param[out] spans an array of two pointers to receive the start of each span
+ * \param[out] span_samples an array of two ints to receive the samples in each span
+ * \return the number of samples in both spans
+ */
+
+int mlt_audio_fifo_peek(mlt_audio_fifo self, int samples, void **spans, int *span_samples)
+{
+    unsigned int used = mlt_audio_fifo_samples(self);
+    unsigned int count = samples > 0 ? MIN((unsigned int) samples, used) : 0;
+
+    spans[0] = spans[1] = NULL;
+    span_samples[0] = span_samples[1] = 0;
+    if (!count)
+        return 0;
+
+    unsigned int offset = self->read & (self->size - 1);
+    span_samples[0] = MIN(count, self->size - offset);
+    span_samples[1] = count - span_samples[0];
+    spans[0] = self->buffer + (size_t) offset * self->sample_size;
+    spans[1] = span_samples[1] ? self->buffer : NULL;
+    return count;
+}
+
+/** Remove samples from the front of an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \param samples the number of samples to remove
+ */
+
+void mlt_audio_fifo_consume(mlt_audio_fifo self, int samples)
+{
+    unsigned int used = mlt_audio_fifo_samples(self);
+    if (self && samples > 0)
+        self->read += MIN((unsigned int) samples, used);
+}
+
+/** Copy samples out of an audio FIFO and remove them.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ * \param data the buffer to receive the samples
+ * \param samples the maximum number of samples to read
+ * \return the number of samples read
+ */
+
+int mlt_audio_fifo_read(mlt_audio_fifo self, void *data, int samples)
+{
+    void *spans[2];
+    int span_samples[2];
+    int count = mlt_audio_fifo_peek(self, samples, spans, span_samples);
+
+    if (count) {
+        size_t first = (size_t) span_samples[0] * self->sample_size;
+        memcpy(data, spans[0], first);
+        if (span_samples[1])
+            memcpy((uint8_t *) data + first, spans[1], span_samples[1] * self->sample_size);
+        mlt_audio_fifo_consume(self, count);
+    }
+    return count;
+}
+
+/** Remove all samples from an audio FIFO.
+ *
+ * \public \memberof mlt_audio_fifo_s
+ * \param self an audio FIFO
+ */
+
+void mlt_audio_fifo_clear(mlt_audio_fifo self)
+{
+    if (self)
+        self->read = self->write = 0;
+}
@@ -70,5 +70,13 @@ extern const char *mlt_audio_channel_layout_name(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_id(const char *name);
 extern int mlt_audio_channel_layout_channels(mlt_channel_layout layout);
 extern mlt_channel_layout mlt_audio_channel_layout_default(int channels);
+extern mlt_audio_fifo mlt_audio_fifo_new(mlt_audio_format format, int channels);
+extern void mlt_audio_fifo_close(mlt_audio_fifo self);
+extern int mlt_audio_fifo_samples(mlt_audio_fifo self);
+extern int mlt_audio_fifo_write(mlt_audio_fifo self, const void *data, int samples);
+extern int mlt_audio_fifo_peek(mlt_audio_fifo self, int samples, void **spans, int *span_samples);
+extern void mlt_audio_fifo_consume(mlt_audio_fifo self, int samples);
+extern int mlt_audio_fifo_read(mlt_audio_fifo self, void *data, int samples);
+extern void mlt_audio_fifo_clear(mlt_audio_fifo self);
 
 #endif
@@ -1,6 +1,6 @@
 /**
  * \file mlt_cache.c
- * \brief least recently used cache
+ * \brief sharded CLOCK cache
  * \see mlt_profile_s
  *
  * Copyright (C) 2007-2023 Meltytech, LLC
@@ -22,12 +22,16 @@
 
 #include "mlt_cache.h"
 #include "mlt_frame.h"
+#include "mlt_image.h"
 #include "mlt_log.h"
 #include "mlt_properties.h"
 #include "mlt_types.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 /** the maximum number of data objects to cache per line */
 #define MAX_CACHE_SIZE (200)
@@ -35,6 +39,12 @@
 /** the default number of data objects to cache per line */
 #define DEFAULT_CACHE_SIZE (4)
 
+/** the maximum number of shards in a cache, a power of two */
+#define MAX_CACHE_SHARDS (8)
+
+/** the number of items per shard below which a cache is not split further */
+#define CACHE_SHARD_ITEMS (16)
+
 /** \brief Cache item class
  *
  * A cache item is a structure holding information about a data object including
@@ -56,13 +66,41 @@ typedef struct mlt_cache_item_s
     mlt_destructor destructor; /**< a function to release or destroy the cached data */
 } mlt_cache_item_s;
 
+/** \brief an entry in a cache shard */
+
+typedef struct
+{
+    void *object;          /**< the owner of the data, or the cached frame in a frame cache */
+    mlt_position position; /**< the position of the cached frame in a frame cache */
+    size_t bytes;          /**< the number of bytes counted against the budget */
+    int referenced;        /**< the CLOCK reference bit, set when the entry is hit */
+} cache_entry;
+
+/** \brief one independently locked part of a cache */
+
+typedef struct
+{
+    pthread_mutex_t mutex; /**< a mutex to prevent multi-threaded race conditions */
+    cache_entry *entries;  /**< the entries in the order they were added */
+    int count;             /**< the number of entries in use */
+    int size;              /**< the number of entries allocated */
+    int hand;              /**< the index of the next entry considered for eviction */
+} cache_shard;
+
 /** \brief Cache class
  *
- * This is a utility class for implementing a Least Recently Used (LRU) cache
- * of data blobs indexed by the address of some other object (e.g., a service).
- * Instead of sorting and manipulating linked lists, it tries to be simple and
- * elegant by copying pointers between two arrays of fixed size to shuffle the
- * order of elements.
+ * This is a utility class for implementing a cache of data blobs indexed by
+ * the address of some other object (e.g., a service) or of frames indexed by
+ * position.
+ *
+ * Entries are spread by the hash of their key over up to \p MAX_CACHE_SHARDS
+ * shards that each have their own lock, so that threads using different
+ * entries do not wait for each other. Small caches use a single shard. The
+ * budget is a number of items and, optionally, a number of bytes (see
+ * mlt_cache_set_max_bytes()). A shard evicts with the CLOCK algorithm: a hit
+ * sets the entry's reference bit, and eviction takes the next entry without
+ * the bit while clearing the bits it passes, which approximates least
+ * recently used.
  *
  * This class is useful if you have a service that wants to cache something
  * somewhat large, but will not scale if there are many instances of the service.
@@ -76,23 +114,41 @@ typedef struct mlt_cache_item_s
  * of continually reading, parsing, and decoding. On the other hand, you might
  * want to load hundreds of pictures as individual producers, which would use
  * a lot of memory if every picture is held in memory!
+ *
+ * Frames are not kept by reference. A frame is deep copied when it is put and
+ * again when it is got, because filters may write to an image they requested
+ * without the writable flag, so neither the frame put nor the frame got may
+ * share an image with the cached one.
+ *
+ * \properties \em hits the number of gets that found an entry
+ * \properties \em misses the number of gets that did not find an entry
+ * \properties \em evictions the number of entries removed to stay within the budget
+ * \properties \em count the number of entries in the cache
+ * \properties \em bytes the number of bytes counted against the budget
+ * \properties \em size the maximum number of entries
+ * \properties \em max_bytes the maximum number of bytes or 0 for no limit
  */
 
 struct mlt_cache_s
 {
-    int count;      /**< the number of items currently in the cache */
-    int size;       /**< the maximum number of items permitted in the cache <= \p MAX_CACHE_SIZE */
-    int is_frames;  /**< indicates if this cache is used to cache frames */
-    void **current; /**< pointer to the current array of pointers */
-    void *A[MAX_CACHE_SIZE];
-    void *B[MAX_CACHE_SIZE];
-    pthread_mutex_t mutex;  /**< a mutex to prevent multi-threaded race conditions */
-    mlt_properties active;  /**< a list of cache items some of which may no longer
-	                            be in \p current but to which there are
+    int size; /**< the maximum number of items permitted in the cache <= \p MAX_CACHE_SIZE */
+    int64_t max_bytes;      /**< the maximum number of bytes permitted in the cache or 0 */
+    int is_frames;          /**< indicates if this cache is used to cache frames */
+    atomic_int shard_count; /**< the number of shards in use, a power of two */
+    cache_shard shards[MAX_CACHE_SHARDS];
+    atomic_int count;              /**< the number of entries in all shards */
+    atomic_int_fast64_t bytes;     /**< the sum of the bytes of the entries in all shards */
+    atomic_int_fast64_t hits;      /**< the number of gets that found an entry */
+    atomic_int_fast64_t misses;    /**< the number of gets that did not find an entry */
+    atomic_int_fast64_t evictions; /**< the number of entries removed to stay within the budget */
+    pthread_mutex_t mutex; /**< a mutex that protects the cache items, \p active, and \p garbage */
+    mlt_properties active; /**< a list of cache items some of which may no longer
+	                            be in a shard but to which there are
 	                            outstanding references */
     mlt_properties garbage; /**< a list cache items pending release. A cache item
 	                            is copied to this list when it is updated but there
 	                            are outstanding references to the old data object. */
+    mlt_properties properties; /**< the statistics reported by mlt_cache_properties() */
 };
 
 /** Get the data pointer from the cache item.
@@ -112,6 +168,7 @@ void *mlt_cache_item_data(mlt_cache_item item, int *size)
 
 /** Close a cache item given its parent object pointer.
  *
+ * The cache mutex must be locked.
  * \private \memberof mlt_cache_s
  * \param cache a cache
  * \param object the object to which the data object belongs
@@ -122,12 +179,6 @@ static void cache_object_close(mlt_cache cache, void *object, void *data)
 {
     char key[19];
 
-    if (cache->is_frames) {
-        // Frame caches are easy - just close the object as mlt_frame.
-        mlt_frame_close(object);
-        return;
-    }
-
     // Fetch the cache item from the active list by its owner's address
     sprintf(key, "%p", object);
     mlt_cache_item item = mlt_properties_get_data(cache->active, key, NULL);
@@ -173,6 +224,26 @@ static void cache_object_close(mlt_cache cache, void *object, void *data)
     }
 }
 
+/** Release the cache's reference to an entry.
+ *
+ * Frames are closed; other data is released through its cache item.
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param entry an entry removed from a shard
+ */
+
+static void cache_entry_close(mlt_cache cache, cache_entry *entry)
+{
+    if (cache->is_frames) {
+        // Frame caches are easy - just close the object as mlt_frame.
+        mlt_frame_close(entry->object);
+    } else {
+        pthread_mutex_lock(&cache->mutex);
+        cache_object_close(cache, entry->object, NULL);
+        pthread_mutex_unlock(&cache->mutex);
+    }
+}
+
 /** Close a cache item.
  *
  * Release a reference and call the destructor on the data object when all
@@ -191,6 +262,259 @@ void mlt_cache_item_close(mlt_cache_item item)
     }
 }
 
+/** Compute the hash of a cache key.
+ *
+ * \private \memberof mlt_cache_s
+ * \param key the owner's address or a frame position
+ * \return a hash whose high bits select the shard
+ */
+
+static uint32_t cache_hash(uintptr_t key)
+{
+    uint64_t hash = (uint64_t) key * UINT64_C(0x9E3779B97F4A7C15);
+    return (uint32_t) (hash >> 32);
+}
+
+/** Get the shard for a hash.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param hash the hash of the key
+ * \return the shard, which is not locked
+ */
+
+static cache_shard *cache_shard_for(mlt_cache cache, uint32_t hash)
+{
+    int count = atomic_load(&cache->shard_count);
+    return &cache->shards[count > 1 ? hash >> (32 - __builtin_ctz(count)) : 0];
+}
+
+/** Lock the shard for a hash.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param hash the hash of the key
+ * \return the locked shard
+ */
+
+static cache_shard *cache_lock_shard(mlt_cache cache, uint32_t hash)
+{
+    for (;;) {
+        cache_shard *shard = cache_shard_for(cache, hash);
+        pthread_mutex_lock(&shard->mutex);
+        // The shards may have been split or joined while waiting.
+        if (shard == cache_shard_for(cache, hash))
+            return shard;
+        pthread_mutex_unlock(&shard->mutex);
+    }
+}
+
+/** Find the entry for a key in a shard.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param shard a locked shard
+ * \param object the owner's address when not a frame cache
+ * \param position the frame position when a frame cache
+ * \return the index of the entry or -1 if not found
+ */
+
+static int shard_find(mlt_cache cache, cache_shard *shard, void *object, mlt_position position)
+{
+    for (int i = 0; i < shard->count; i++) {
+        if (cache->is_frames ? shard->entries[i].position == position
+                             : shard->entries[i].object == object)
+            return i;
+    }
+    return -1;
+}
+
+/** Add an entry to a shard.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param shard a locked shard
+ * \param entry the entry to add
+ * \return the index of the entry or -1 if there was an error
+ */
+
+static int shard_add(mlt_cache cache, cache_shard *shard, cache_entry *entry)
+{
+    if (shard->count == shard->size) {
+        int size = shard->size ? 2 * shard->size : 4;
+        cache_entry *entries = realloc(shard->entries, size * sizeof(cache_entry));
+        if (!entries)
+            return -1;
+        shard->entries = entries;
+        shard->size = size;
+    }
+    shard->entries[shard->count] = *entry;
+    atomic_fetch_add(&cache->count, 1);
+    atomic_fetch_add(&cache->bytes, entry->bytes);
+    return shard->count++;
+}
+
+/** Remove an entry from a shard.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param shard a locked shard
+ * \param i the index of the entry
+ * \param[out] entry the removed entry
+ */
+
+static void shard_remove(mlt_cache cache, cache_shard *shard, int i, cache_entry *entry)
+{
+    *entry = shard->entries[i];
+    atomic_fetch_sub(&cache->count, 1);
+    atomic_fetch_sub(&cache->bytes, entry->bytes);
+    shard->count--;
+    memmove(&shard->entries[i], &shard->entries[i + 1], (shard->count - i) * sizeof(cache_entry));
+    if (shard->hand > i)
+        shard->hand--;
+    if (shard->hand >= shard->count)
+        shard->hand = 0;
+}
+
+/** Determine if a cache holds more than its budget.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \return true if an entry should be evicted
+ */
+
+static int cache_is_full(mlt_cache cache)
+{
+    return atomic_load(&cache->count) > cache->size
+           || (cache->max_bytes > 0 && atomic_load(&cache->bytes) > cache->max_bytes);
+}
+
+/** Remove entries from a shard while the cache is over its budget.
+ *
+ * Hashing spreads the entries evenly over the shards, so the shard that
+ * receives an entry also gives up the entries to make room for it.
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param shard a locked shard
+ * \param keep the index of an entry not to evict or -1
+ * \param limit the maximum number of entries to evict
+ * \param[out] evicted the removed entries, which has room for \p limit entries
+ * \return the number of removed entries
+ */
+
+static int shard_evict(
+    mlt_cache cache, cache_shard *shard, int keep, int limit, cache_entry *evicted)
+{
+    int n = 0;
+
+    while (n < limit && shard->count > (keep >= 0) && cache_is_full(cache)) {
+        // Advance the clock hand to the next entry that was not used since it last passed.
+        int i = shard->hand;
+        if (i == keep || shard->entries[i].referenced) {
+            shard->entries[i].referenced = 0;
+            shard->hand = (i + 1) % shard->count;
+            continue;
+        }
+        shard_remove(cache, shard, i, &evicted[n++]);
+        if (keep > i)
+            keep--;
+    }
+    if (n > 0)
+        atomic_fetch_add(&cache->evictions, n);
+    return n;
+}
+
+/** Evict from each shard in turn while the cache is over its budget.
+ *
+ * This is needed when the shard that received an entry has nothing else to
+ * evict.
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ * \param skip the shard that received the entry, which already evicted what it could
+ */
+
+static void cache_trim(mlt_cache cache, cache_shard *skip)
+{
+    int evicted = 1;
+    while (evicted && cache_is_full(cache)) {
+        evicted = 0;
+        for (int i = 0; i < atomic_load(&cache->shard_count) && cache_is_full(cache); i++) {
+            cache_shard *shard = &cache->shards[i];
+            cache_entry entry;
+            if (shard == skip)
+                continue;
+            pthread_mutex_lock(&shard->mutex);
+            int n = shard_evict(cache, shard, -1, 1, &entry);
+            pthread_mutex_unlock(&shard->mutex);
+            if (n) {
+                cache_entry_close(cache, &entry);
+                evicted++;
+            }
+        }
+    }
+}
+
+/** Set the number of shards to suit the size of the cache and apply the budget.
+ *
+ * \private \memberof mlt_cache_s
+ * \param cache a cache
+ */
+
+static void cache_reshard(mlt_cache cache)
+{
+    int count = 1;
+    while (count < MAX_CACHE_SHARDS && cache->size / (count * 2) >= CACHE_SHARD_ITEMS)
+        count *= 2;
+
+    int i;
+    for (i = 0; i < MAX_CACHE_SHARDS; i++)
+        pthread_mutex_lock(&cache->shards[i].mutex);
+
+    int total = atomic_load(&cache->count);
+    cache_entry *entries = total ? malloc(total * sizeof(cache_entry)) : NULL;
+    int evicted_count = 0;
+
+    if (count != atomic_load(&cache->shard_count) && (!total || entries)) {
+        // Take all of the entries out and put them back into the new shards.
+        total = 0;
+        for (i = 0; i < MAX_CACHE_SHARDS; i++) {
+            cache_shard *shard = &cache->shards[i];
+            while (shard->count)
+                shard_remove(cache, shard, 0, &entries[total++]);
+        }
+        atomic_store(&cache->shard_count, count);
+        for (i = 0; i < total; i++) {
+            uintptr_t key = cache->is_frames ? (uintptr_t) entries[i].position
+                                             : (uintptr_t) entries[i].object;
+            cache_shard *shard = cache_shard_for(cache, cache_hash(key));
+            if (shard_add(cache, shard, &entries[i]) < 0)
+                entries[evicted_count++] = entries[i];
+        }
+    }
+    if (entries) {
+        // Evict in turn from each shard to stay within the budget.
+        count = atomic_load(&cache->shard_count);
+        int evicted;
+        do {
+            evicted = 0;
+            for (i = 0; i < count; i++)
+                evicted += shard_evict(cache,
+                                       &cache->shards[i],
+                                       -1,
+                                       1,
+                                       &entries[evicted_count + evicted]);
+            evicted_count += evicted;
+        } while (evicted);
+    }
+
+    for (i = MAX_CACHE_SHARDS - 1; i >= 0; i--)
+        pthread_mutex_unlock(&cache->shards[i].mutex);
+
+    for (i = 0; i < evicted_count; i++)
+        cache_entry_close(cache, &entries[i]);
+    free(entries);
+}
+
 /** Create a new cache.
  *
  * The default size is \p DEFAULT_CACHE_SIZE.
@@ -203,17 +527,20 @@ mlt_cache mlt_cache_init()
     mlt_cache result = calloc(1, sizeof(struct mlt_cache_s));
     if (result) {
         result->size = DEFAULT_CACHE_SIZE;
-        result->current = result->A;
+        atomic_init(&result->shard_count, 1);
+        for (int i = 0; i < MAX_CACHE_SHARDS; i++)
+            pthread_mutex_init(&result->shards[i].mutex, NULL);
         pthread_mutex_init(&result->mutex, NULL);
         result->active = mlt_properties_new();
         result->garbage = mlt_properties_new();
+        result->properties = mlt_properties_new();
     }
     return result;
 }
 
 /** Set the number of items to cache.
  *
- * This must be called before using the cache. The size can not be more
+ * This should be called before using the cache. The size can not be more
  * than \p MAX_CACHE_SIZE.
  * \public \memberof mlt_cache_s
  * \param cache the cache to adjust
@@ -222,8 +549,10 @@ mlt_cache mlt_cache_init()
 
 void mlt_cache_set_size(mlt_cache cache, int size)
 {
-    if (size <= MAX_CACHE_SIZE)
+    if (size <= MAX_CACHE_SIZE) {
         cache->size = size;
+        cache_reshard(cache);
+    }
 }
 
 /** Get the number of possible cache items.
@@ -238,6 +567,57 @@ int mlt_cache_get_size(mlt_cache cache)
     return cache->size;
 }
 
+/** Set the number of bytes to cache.
+ *
+ * The bytes of a frame are those of its image, alpha, and audio. The bytes
+ * of other data are the size given to mlt_cache_put(). The cache always
+ * keeps the most recent entry even if it is bigger than the budget.
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to adjust
+ * \param max_bytes the new budget in bytes or 0 to only limit the number of items
+ */
+
+void mlt_cache_set_max_bytes(mlt_cache cache, int64_t max_bytes)
+{
+    if (max_bytes >= 0) {
+        cache->max_bytes = max_bytes;
+        cache_reshard(cache);
+    }
+}
+
+/** Get the number of bytes to cache.
+ *
+ * \public \memberof mlt_cache_s
+ * \param cache the cache to check
+ * \return the budget in bytes or 0 if only the number of items is limited
+ */
+
+int64_t mlt_cache_get_max_bytes(mlt_cache cache)
+{
+    return cache->max_bytes;
+}
+
+/** Get the statistics of a cache.
+ *
+ * The properties are updated each time this is called.
+ * \public \memberof mlt_cache_s
+ * \param cache a cache
+ * \return the properties, which belong to the cache
+ */
+
+mlt_properties mlt_cache_properties(mlt_cache cache)
+{
+    mlt_properties properties = cache->properties;
+    mlt_properties_set_int64(properties, "hits", atomic_load(&cache->hits));
+    mlt_properties_set_int64(properties, "misses", atomic_load(&cache->misses));
+    mlt_properties_set_int64(properties, "evictions", atomic_load(&cache->evictions));
+    mlt_properties_set_int(properties, "count", atomic_load(&cache->count));
+    mlt_properties_set_int64(properties, "bytes", atomic_load(&cache->bytes));
+    mlt_properties_set_int(properties, "size", cache->size);
+    mlt_properties_set_int64(properties, "max_bytes", cache->max_bytes);
+    return properties;
+}
+
 /** Destroy a cache.
  *
  * \public \memberof mlt_cache_s
@@ -247,13 +627,19 @@ int mlt_cache_get_size(mlt_cache cache)
 void mlt_cache_close(mlt_cache cache)
 {
     if (cache) {
-        while (cache->count--) {
-            void *object = cache->current[cache->count];
-            mlt_log(NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, cache->count, object);
-            cache_object_close(cache, object, NULL);
+        for (int i = 0; i < MAX_CACHE_SHARDS; i++) {
+            cache_shard *shard = &cache->shards[i];
+            while (shard->count--) {
+                void *object = shard->entries[shard->count].object;
+                mlt_log(NULL, MLT_LOG_DEBUG, "%s: %d = %p\n", __FUNCTION__, shard->count, object);
+                cache_entry_close(cache, &shard->entries[shard->count]);
+            }
+            free(shard->entries);
+            pthread_mutex_destroy(&shard->mutex);
         }
         mlt_properties_close(cache->active);
         mlt_properties_close(cache->garbage);
+        mlt_properties_close(cache->properties);
         pthread_mutex_destroy(&cache->mutex);
         free(cache);
     }
@@ -268,71 +654,16 @@ void mlt_cache_close(mlt_cache cache)
 
 void mlt_cache_purge(mlt_cache cache, void *object)
 {
-    if (!cache)
+    if (!cache || !object || cache->is_frames)
         return;
-    pthread_mutex_lock(&cache->mutex);
-    if (cache && object) {
-        int i, j;
-        void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-        for (i = 0, j = 0; i < cache->count; i++) {
-            void *o = cache->current[i];
-
-            if (o == object) {
-                cache_object_close(cache, o, NULL);
-            } else {
-                alt[j++] = o;
-            }
-        }
-        cache->count = j;
-        cache->current = alt;
-    }
-    pthread_mutex_unlock(&cache->mutex);
-}
-
-/** Shuffle the cache entries between the two arrays and return the cache entry for an object.
- *
- * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param object the object that owns the cached data
- * \return a cache entry if there was a hit or NULL for a miss
- */
-
-static void **shuffle_get_hit(mlt_cache cache, void *object)
-{
-    int i = cache->count;
-    int j = cache->count - 1;
-    void **hit = NULL;
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
-
-    if (cache->count > 0 && cache->count < cache->size) {
-        // first determine if we have a hit
-        while (i-- && !hit) {
-            void **o = &cache->current[i];
-            if (*o == object)
-                hit = o;
-        }
-        // if there was no hit, we will not be shuffling out an entry
-        // and are still filling the cache
-        if (!hit)
-            ++j;
-        // reset these
-        i = cache->count;
-        hit = NULL;
-    }
-
-    // shuffle the existing entries to the alternate array
-    while (i--) {
-        void **o = &cache->current[i];
-
-        if (!hit && *o == object) {
-            hit = o;
-        } else if (j > 0) {
-            alt[--j] = *o;
-            // 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-        }
-    }
-    return hit;
+    cache_shard *shard = cache_lock_shard(cache, cache_hash((uintptr_t) object));
+    cache_entry entry;
+    int i = shard_find(cache, shard, object, 0);
+    if (i >= 0)
+        shard_remove(cache, shard, i, &entry);
+    pthread_mutex_unlock(&shard->mutex);
+    if (i >= 0)
+        cache_entry_close(cache, &entry);
 }
 
 /** Put a chunk of data in the cache.
@@ -352,34 +683,30 @@ static void **shuffle_get_hit(mlt_cache cache, void *object)
 
 void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_destructor destructor)
 {
-    pthread_mutex_lock(&cache->mutex);
-    void **hit = shuffle_get_hit(cache, object);
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
+    cache_shard *shard = cache_lock_shard(cache, cache_hash((uintptr_t) object));
+    cache_entry evicted[shard->count + 1];
+    int evicted_count = 0;
+    int i = shard_find(cache, shard, object, 0);
 
-    // add the object to the cache
-    if (hit) {
+    pthread_mutex_lock(&cache->mutex);
+    if (i >= 0) {
         // release the old data
-        cache_object_close(cache, *hit, NULL);
-        // the MRU end gets the updated data
-        hit = &alt[cache->count - 1];
-    } else if (cache->count < cache->size) {
-        // more room in cache, add it to MRU end
-        hit = &alt[cache->count++];
+        cache_object_close(cache, object, NULL);
+        atomic_fetch_add(&cache->bytes, (size > 0 ? size : 0) - (int64_t) shard->entries[i].bytes);
+        shard->entries[i].bytes = size > 0 ? size : 0;
+        shard->entries[i].referenced = 1;
     } else {
-        // release the entry at the LRU end
-        cache_object_close(cache, cache->current[0], NULL);
-
-        // The MRU end gets the new item
-        hit = &alt[cache->count - 1];
+        cache_entry entry = {object, 0, size > 0 ? size : 0, 0};
+        i = shard_add(cache, shard, &entry);
+    }
+    if (i < 0) {
+        pthread_mutex_unlock(&cache->mutex);
+        pthread_mutex_unlock(&shard->mutex);
+        if (destructor)
+            destructor(data);
+        return;
     }
-    *hit = object;
-    mlt_log(NULL,
-            MLT_LOG_DEBUG,
-            "%s: put %d = %p, %p\n",
-            __FUNCTION__,
-            cache->count - 1,
-            object,
-            data);
+    mlt_log(NULL, MLT_LOG_DEBUG, "%s: put %d = %p, %p\n", __FUNCTION__, i, object, data);
 
     // Fetch the cache item
     char key[19];
@@ -416,10 +743,14 @@ void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_dest
         item->destructor = destructor;
         item->refcount = 1;
     }
-
-    // swap the current array
-    cache->current = alt;
     pthread_mutex_unlock(&cache->mutex);
+
+    evicted_count = shard_evict(cache, shard, i, shard->count, evicted);
+    pthread_mutex_unlock(&shard->mutex);
+
+    for (i = 0; i < evicted_count; i++)
+        cache_entry_close(cache, &evicted[i]);
+    cache_trim(cache, shard);
 }
 
 /** Get a chunk of data from the cache.
@@ -433,17 +764,15 @@ void mlt_cache_put(mlt_cache cache, void *object, void *data, int size, mlt_dest
 mlt_cache_item mlt_cache_get(mlt_cache cache, void *object)
 {
     mlt_cache_item result = NULL;
-    pthread_mutex_lock(&cache->mutex);
-    void **hit = shuffle_get_hit(cache, object);
-    void **alt = cache->current == cache->A ? cache->B : cache->A;
+    cache_shard *shard = cache_lock_shard(cache, cache_hash((uintptr_t) object));
+    int i = shard_find(cache, shard, object, 0);
 
-    if (hit) {
-        // copy the hit to the MRU end
-        alt[cache->count - 1] = *hit;
-        hit = &alt[cache->count - 1];
+    if (i >= 0) {
+        shard->entries[i].referenced = 1;
 
         char key[19];
-        sprintf(key, "%p", *hit);
+        sprintf(key, "%p", object);
+        pthread_mutex_lock(&cache->mutex);
         result = mlt_properties_get_data(cache->active, key, NULL);
         if (result && result->data) {
             result->refcount++;
@@ -451,99 +780,79 @@ mlt_cache_item mlt_cache_get(mlt_cache cache, void *object)
                     MLT_LOG_DEBUG,
                     "%s: get %d = %p, %p\n",
                     __FUNCTION__,
-                    cache->count - 1,
-                    *hit,
+                    i,
+                    object,
                     result->data);
         }
-
-        // swap the current array
-        cache->current = alt;
+        pthread_mutex_unlock(&cache->mutex);
     }
-    pthread_mutex_unlock(&cache->mutex);
+    pthread_mutex_unlock(&shard->mutex);
+    atomic_fetch_add(result ? &cache->hits : &cache->misses, 1);
 
     return result;
 }
 
-/** Shuffle the cache entries between the two arrays and return the frame for a position.
+/** Get the number of bytes of a frame counted against the budget.
  *
  * \private \memberof mlt_cache_s
- * \param cache a cache object
- * \param position the position of the frame that you want
- * \return a frame if there was a hit or NULL for a miss
+ * \param frame a frame
+ * \return the number of bytes of its image, alpha, and audio
  */
 
-static mlt_frame *shuffle_get_frame(mlt_cache cache, mlt_position position)
+static size_t frame_bytes(mlt_frame frame)
 {
-    int i = cache->count;
-    int j = cache->count - 1;
-    mlt_frame *hit = NULL;
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
-
-    if (cache->count > 0 && cache->count < cache->size) {
-        // first determine if we have a hit
-        while (i-- && !hit) {
-            mlt_frame *o = (mlt_frame *) &cache->current[i];
-            if (mlt_frame_original_position(*o) == position)
-                hit = o;
-        }
-        // if there was no hit, we will not be shuffling out an entry
-        // and are still filling the cache
-        if (!hit)
-            ++j;
-        // reset these
-        i = cache->count;
-        hit = NULL;
-    }
-
-    // shuffle the existing entries to the alternate array
-    while (i--) {
-        mlt_frame *o = (mlt_frame *) &cache->current[i];
-
-        if (!hit && mlt_frame_original_position(*o) == position) {
-            hit = o;
-        } else if (j > 0) {
-            alt[--j] = *o;
-            // 			mlt_log( NULL, MLT_LOG_DEBUG, "%s: shuffle %d = %p\n", __FUNCTION__, j, alt[j] );
-        }
-    }
-    return hit;
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    int image = 0, alpha = 0, audio = 0;
+    if (mlt_properties_get_data(properties, "image", &image) && image <= 0)
+        image = mlt_image_format_size(mlt_properties_get_int(properties, "format"),
+                                      mlt_properties_get_int(properties, "width"),
+                                      mlt_properties_get_int(properties, "height"),
+                                      NULL);
+    mlt_properties_get_data(properties, "alpha", &alpha);
+    mlt_properties_get_data(properties, "audio", &audio);
+    return (size_t) (image > 0 ? image : 0) + (alpha > 0 ? alpha : 0) + (audio > 0 ? audio : 0);
 }
 
 static void cache_put_frame(mlt_cache cache, mlt_frame frame, int audio, int image)
 {
-    pthread_mutex_lock(&cache->mutex);
-    mlt_frame *hit = shuffle_get_frame(cache, mlt_frame_original_position(frame));
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
+    mlt_position position = mlt_frame_original_position(frame);
+    mlt_frame copy = NULL;
 
-    // add the frame to the cache
-    if (hit) {
-        // release the old data
-        mlt_frame_close(*hit);
-        // the MRU end gets the updated data
-        hit = &alt[cache->count - 1];
-    } else if (cache->count < cache->size) {
-        // more room in cache, add it to MRU end
-        hit = &alt[cache->count++];
-    } else {
-        // release the entry at the LRU end
-        mlt_frame_close(cache->current[0]);
-
-        // The MRU end gets the new item
-        hit = &alt[cache->count - 1];
-    }
+    // Copy the frame before locking since that is the slow part.
     if (audio && image) {
-        *hit = mlt_frame_clone(frame, 1);
+        copy = mlt_frame_clone(frame, 1);
     } else if (audio) {
-        *hit = mlt_frame_clone_audio(frame, 1);
+        copy = mlt_frame_clone_audio(frame, 1);
     } else if (image) {
-        *hit = mlt_frame_clone_image(frame, 1);
+        copy = mlt_frame_clone_image(frame, 1);
     }
-    mlt_log(NULL, MLT_LOG_DEBUG, "%s: put %d = %p\n", __FUNCTION__, cache->count - 1, frame);
-
-    // swap the current array
-    cache->current = (void **) alt;
+    if (!copy)
+        return;
+    size_t bytes = frame_bytes(copy);
     cache->is_frames = 1;
-    pthread_mutex_unlock(&cache->mutex);
+
+    cache_shard *shard = cache_lock_shard(cache, cache_hash((uintptr_t) position));
+    cache_entry evicted[shard->count + 2];
+    int evicted_count = 0;
+    cache_entry entry = {copy, position, bytes, 0};
+    int i = shard_find(cache, shard, NULL, position);
+
+    if (i >= 0) {
+        // release the old data
+        shard_remove(cache, shard, i, &evicted[evicted_count++]);
+        entry.referenced = 1;
+    }
+    i = shard_add(cache, shard, &entry);
+    if (i >= 0)
+        evicted_count += shard_evict(cache, shard, i, shard->count, &evicted[evicted_count]);
+    else
+        evicted[evicted_count++] = entry;
+    mlt_log(NULL, MLT_LOG_DEBUG, "%s: put %d = %p\n", __FUNCTION__, i, frame);
+    pthread_mutex_unlock(&shard->mutex);
+
+    for (i = 0; i < evicted_count; i++)
+        mlt_frame_close(evicted[i].object);
+    cache_trim(cache, shard);
 }
 
 /** Put a frame in the cache with audio and video.
@@ -602,6 +911,7 @@ void mlt_cache_put_frame_image(mlt_cache cache, mlt_frame frame)
 
 /** Get a frame from the cache.
  *
+ * The frame is a deep copy of the cached one.
  * You must call mlt_frame_close() on the frame you receive from this.
  *
  * \public \memberof mlt_cache_s
@@ -614,22 +924,25 @@ void mlt_cache_put_frame_image(mlt_cache cache, mlt_frame frame)
 mlt_frame mlt_cache_get_frame(mlt_cache cache, mlt_position position)
 {
     mlt_frame result = NULL;
-    pthread_mutex_lock(&cache->mutex);
-    mlt_frame *hit = shuffle_get_frame(cache, position);
-    mlt_frame *alt = (mlt_frame *) (cache->current == cache->A ? cache->B : cache->A);
+    mlt_frame hit = NULL;
 
+    if (cache->is_frames) {
+        cache_shard *shard = cache_lock_shard(cache, cache_hash((uintptr_t) position));
+        int i = shard_find(cache, shard, NULL, position);
+        if (i >= 0) {
+            shard->entries[i].referenced = 1;
+            hit = shard->entries[i].object;
+            // Hold a reference so the frame can be copied without the lock.
+            mlt_properties_inc_ref(MLT_FRAME_PROPERTIES(hit));
+            mlt_log(NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, i, hit);
+        }
+        pthread_mutex_unlock(&shard->mutex);
+    }
     if (hit) {
-        // copy the hit to the MRU end
-        alt[cache->count - 1] = *hit;
-        hit = &alt[cache->count - 1];
-
-        result = mlt_frame_clone(*hit, 1);
-        mlt_log(NULL, MLT_LOG_DEBUG, "%s: get %d = %p\n", __FUNCTION__, cache->count - 1, *hit);
-
-        // swap the current array
-        cache->current = (void **) alt;
+        result = mlt_frame_clone(hit, 1);
+        mlt_frame_close(hit);
     }
-    pthread_mutex_unlock(&cache->mutex);
+    atomic_fetch_add(result ? &cache->hits : &cache->misses, 1);
 
     return result;
 }
@@ -21,11 +21,16 @@
  */
 
 #include "mlt_consumer.h"
+#include "mlt_chain.h"
 #include "mlt_factory.h"
 #include "mlt_frame.h"
 #include "mlt_log.h"
+#include "mlt_multitrack.h"
+#include "mlt_playlist.h"
 #include "mlt_producer.h"
 #include "mlt_profile.h"
+#include "mlt_tractor.h"
+#include "mlt_transition.h"
 
 #include <stdatomic.h>
 #include <stdio.h>
@@ -54,6 +59,7 @@ typedef struct
     atomic_int ahead;
     int preroll;
     mlt_image_format image_format;
+    int image_format_negotiated; /**< mlt_image_format was set by negotiate_image_format() */
     mlt_audio_format audio_format;
     mlt_deque queue;
     void *ahead_thread;
@@ -451,6 +457,524 @@ static void set_image_format(mlt_consumer self)
     }
 }
 
+/** The image formats that negotiation chooses from; the GPU formats are excluded. */
+#define NEGOTIABLE_FORMATS \
+    ((1u << mlt_image_rgb) | (1u << mlt_image_rgba) | (1u << mlt_image_yuv422) \
+     | (1u << mlt_image_yuv420p) | (1u << mlt_image_yuv422p16) | (1u << mlt_image_yuv420p10) \
+     | (1u << mlt_image_yuv444p10))
+
+/** \brief the fewest image conversions needed to deliver each image format at a point in a graph */
+
+typedef struct
+{
+    int cost[mlt_image_invalid];
+} format_costs;
+
+/** \brief a growing list of service:format pairs describing a negotiated plan */
+
+typedef struct
+{
+    char *text;
+    size_t length;
+    size_t size;
+} format_plan;
+
+/** Get the image formats a service declares in its metadata.
+ *
+ * Services declare the formats their get_image works in with the
+ * image_formats list of their YAML metadata, in order of preference.
+ * \private \memberof mlt_consumer_s
+ * \param service a service
+ * \param[out] preferred the first declared format (optional)
+ * \return a bit mask of formats, or 0 if the service works in any format it receives
+ */
+
+static unsigned service_image_formats(mlt_service service, mlt_image_format *preferred)
+{
+    mlt_properties properties = MLT_SERVICE_PROPERTIES(service);
+    const char *id = mlt_properties_get(properties, "mlt_service");
+    mlt_repository repository = mlt_factory_repository();
+    unsigned formats = 0;
+
+    if (id && repository) {
+        mlt_properties metadata = mlt_repository_metadata(repository,
+                                                          mlt_service_identify(service),
+                                                          id);
+        mlt_properties list = metadata ? mlt_properties_get_data(metadata, "image_formats", NULL)
+                                       : NULL;
+        int i, count = list ? mlt_properties_count(list) : 0;
+        for (i = 0; i < count; i++) {
+            mlt_image_format format = mlt_image_format_id(mlt_properties_get_value(list, i));
+            if (format != mlt_image_invalid && (NEGOTIABLE_FORMATS & (1u << format))) {
+                if (!formats && preferred)
+                    *preferred = format;
+                formats |= 1u << format;
+            }
+        }
+    }
+    return formats;
+}
+
+/** Get the cheapest of a set of formats.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param costs the costs of all formats
+ * \param formats a bit mask of the formats to choose from
+ * \return the format with the lowest cost
+ */
+
+static mlt_image_format costs_best(const format_costs *costs, unsigned formats)
+{
+    mlt_image_format best = mlt_image_invalid;
+    int f;
+    for (f = mlt_image_rgb; f < mlt_image_invalid; f++)
+        if ((formats & (1u << f))
+            && (best == mlt_image_invalid || costs->cost[f] < costs->cost[best]))
+            best = f;
+    return best;
+}
+
+/** Account for a service that works in one of a set of formats.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param[in,out] costs the costs of the image the service receives
+ * \param formats the formats of the service or 0 if it works in any
+ */
+
+static void costs_apply(format_costs *costs, unsigned formats)
+{
+    if (formats) {
+        int best = costs->cost[costs_best(costs, formats)];
+        int f;
+        for (f = mlt_image_rgb; f < mlt_image_invalid; f++)
+            if (!(formats & (1u << f)) || costs->cost[f] > best + 1)
+                costs->cost[f] = best + 1;
+    }
+}
+
+/** Account for a transition that blends two images in one of a set of formats.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param[in,out] a the costs of the image of the a track
+ * \param b the costs of the image of the b track
+ * \param formats the formats of the transition or 0 if it does not process images
+ */
+
+static void costs_blend(format_costs *a, const format_costs *b, unsigned formats)
+{
+    if (formats) {
+        int f;
+        for (f = mlt_image_rgb; f < mlt_image_invalid; f++)
+            a->cost[f] += b->cost[f];
+        costs_apply(a, formats);
+    }
+}
+
+/** The most transitions and filters planted in a tractor that negotiation follows */
+#define MAX_PLANTED 1024
+
+/** Get the transitions and filters planted in a tractor.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param tractor a tractor
+ * \param multitrack the multitrack of the tractor
+ * \param[out] field the planted services from the tractor down to the multitrack
+ * \return the number of planted services
+ */
+
+static int tractor_field(mlt_service tractor, mlt_multitrack multitrack, mlt_service *field)
+{
+    mlt_service next = mlt_service_producer(tractor);
+    int planted = 0;
+    while (next && next != MLT_MULTITRACK_SERVICE(multitrack) && planted < MAX_PLANTED) {
+        field[planted++] = next;
+        next = mlt_service_producer(next);
+    }
+    return planted;
+}
+
+static void costs_producer(mlt_service service, format_costs *costs);
+
+/** Compute the costs of the frames of a producer before its attached filters.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param service a producer
+ * \param[out] costs the costs of the image it produces
+ */
+
+static void costs_source(mlt_service service, format_costs *costs)
+{
+    mlt_service_type type = mlt_service_identify(service);
+    format_costs other;
+    int f, i;
+
+    for (f = 0; f < mlt_image_invalid; f++)
+        costs->cost[f] = 0;
+
+    if (type == mlt_service_playlist_type) {
+        // A playlist costs as much as its most expensive clip
+        mlt_playlist playlist = MLT_PLAYLIST(service);
+        for (i = 0; i < mlt_playlist_count(playlist); i++) {
+            if (mlt_playlist_is_blank(playlist, i))
+                continue;
+            costs_producer(MLT_PRODUCER_SERVICE(mlt_playlist_get_clip(playlist, i)), &other);
+            for (f = 0; f < mlt_image_invalid; f++)
+                costs->cost[f] = MAX(costs->cost[f], other.cost[f]);
+        }
+    } else if (type == mlt_service_tractor_type) {
+        mlt_multitrack multitrack = mlt_tractor_multitrack(MLT_TRACTOR(service));
+        int count = multitrack ? mlt_multitrack_count(multitrack) : 0;
+        format_costs *tracks = calloc(MAX(count, 1), sizeof(*tracks));
+        mlt_service field[MAX_PLANTED];
+        int planted = tractor_field(service, multitrack, field);
+
+        for (i = 0; i < count; i++)
+            costs_producer(MLT_PRODUCER_SERVICE(mlt_multitrack_track(multitrack, i)), &tracks[i]);
+
+        // The planted transitions and filters lead from the tractor to the multitrack
+        while (planted--) {
+            mlt_service planted_service = field[planted];
+            unsigned formats = service_image_formats(planted_service, NULL);
+            if (mlt_service_identify(planted_service) == mlt_service_transition_type) {
+                int a = mlt_transition_get_a_track(MLT_TRANSITION(planted_service));
+                int b = mlt_transition_get_b_track(MLT_TRANSITION(planted_service));
+                if (a >= 0 && a < count && b >= 0 && b < count && a != b)
+                    costs_blend(&tracks[a], &tracks[b], formats);
+            } else {
+                int track = mlt_properties_get_int(MLT_SERVICE_PROPERTIES(planted_service),
+                                                   "track");
+                if (track >= 0 && track < count)
+                    costs_apply(&tracks[track], formats);
+            }
+        }
+        if (count > 0)
+            *costs = tracks[0];
+        free(tracks);
+    } else if (type == mlt_service_chain_type) {
+        mlt_chain chain = MLT_CHAIN(service);
+        mlt_producer source = mlt_chain_get_source(chain);
+        if (source)
+            costs_producer(MLT_PRODUCER_SERVICE(source), costs);
+        for (i = 0; i < mlt_chain_link_count(chain); i++) {
+            mlt_service link = MLT_LINK_SERVICE(mlt_chain_link(chain, i));
+            costs_apply(costs, service_image_formats(link, NULL));
+        }
+    } else if (type == mlt_service_producer_type && mlt_producer_is_cut(MLT_PRODUCER(service))) {
+        costs_producer(MLT_PRODUCER_SERVICE(mlt_producer_cut_parent(MLT_PRODUCER(service))), costs);
+    } else if (type == mlt_service_filter_type || type == mlt_service_transition_type) {
+        // A filter connected directly works on the frames of its producer
+        mlt_service input = mlt_service_producer(service);
+        if (input)
+            costs_producer(input, costs);
+        costs_apply(costs, service_image_formats(service, NULL));
+    } else {
+        // A producer that declares formats converts to the others
+        unsigned formats = service_image_formats(service, NULL);
+        if (formats)
+            for (f = mlt_image_rgb; f < mlt_image_invalid; f++)
+                costs->cost[f] = (formats & (1u << f)) ? 0 : 1;
+    }
+}
+
+/** Compute the costs of the frames of a producer including its attached filters.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param service a producer
+ * \param[out] costs the costs of the image it delivers
+ */
+
+static void costs_producer(mlt_service service, format_costs *costs)
+{
+    int i;
+    costs_source(service, costs);
+    for (i = 0; i < mlt_service_filter_count(service); i++) {
+        mlt_service filter = MLT_FILTER_SERVICE(mlt_service_filter(service, i));
+        costs_apply(costs, service_image_formats(filter, NULL));
+    }
+}
+
+/** Add a service to a plan.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param plan a plan
+ * \param service the service
+ * \param format the format the service works in
+ */
+
+static void plan_append(format_plan *plan, mlt_service service, mlt_image_format format)
+{
+    const char *id = mlt_properties_get(MLT_SERVICE_PROPERTIES(service), "mlt_service");
+    const char *name = mlt_image_format_name(format);
+    size_t needed = plan->length + strlen(id ? id : "?") + strlen(name) + 3;
+
+    if (needed > plan->size) {
+        char *text = realloc(plan->text, needed * 2);
+        if (!text)
+            return;
+        plan->text = text;
+        plan->size = needed * 2;
+    }
+    plan->length += sprintf(plan->text + plan->length,
+                            "%s%s:%s",
+                            plan->length ? " " : "",
+                            id ? id : "?",
+                            name);
+}
+
+/** Find the format a service works in to deliver a format at the lowest cost.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param costs the costs of the image the service receives
+ * \param formats the formats of the service, not 0
+ * \param format the format to deliver
+ * \return the format the service works in
+ */
+
+static mlt_image_format plan_choose(const format_costs *costs,
+                                    unsigned formats,
+                                    mlt_image_format format)
+{
+    mlt_image_format best = costs_best(costs, formats);
+    if ((formats & (1u << format)) && costs->cost[format] <= costs->cost[best] + 1)
+        return format;
+    return best;
+}
+
+static void plan_producer(mlt_service service, mlt_image_format format, format_plan *plan);
+
+/** Describe how a producer delivers a format before its attached filters.
+ *
+ * \private \memberof mlt_consumer_s
+ * \param service a producer
+ * \param format the format to deliver
+ * \param plan the plan to append to
+ */
+
+static void plan_source(mlt_service service, mlt_image_format format, format_plan *plan)
+{
+    mlt_service_type type = mlt_service_identify(service);
+    int i;
+
+    if (type == mlt_service_playlist_type) {
+        mlt_playlist playlist = MLT_PLAYLIST(service);
+        for (i = 0; i < mlt_playlist_count(playlist); i++) {
+            if (mlt_playlist_is_blank(playlist, i))
+                continue;
+            plan_producer(MLT_PRODUCER_SERVICE(mlt_playlist_get_clip(playlist, i)), format, plan);
+        }
+    } else if (type == mlt_service_tractor_type) {
+        mlt_multitrack multitrack = mlt_tractor_multitrack(MLT_TRACTOR(service));
+        int count = multitrack ? mlt_multitrack_count(multitrack) : 0;
+        mlt_image_format *wanted = malloc(MAX(count, 1) * sizeof(*wanted));
+        format_costs *tracks = calloc(MAX(count, 1), sizeof(*tracks));
+        format_costs *stages = NULL;
+        mlt_service field[MAX_PLANTED];
+        int planted = tractor_field(service, multitrack, field);
+
+        for (i = 0; i < count; i++)
+            costs_producer(MLT_PRODUCER_SERVICE(mlt_multitrack_track(multitrack, i)), &tracks[i]);
+
+        // Replay the field upwards keeping the costs each planted service receives
+        stages = calloc(MAX(planted, 1) * 2, sizeof(*stages));
+        for (i = planted - 1; i >= 0; i--) {
+            mlt_service planted_service = field[i];
+            unsigned formats = service_image_formats(planted_service, NULL);
+            if (mlt_service_identify(planted_service) == mlt_service_transition_type) {
+                int a = mlt_transition_get_a_track(MLT_TRANSITION(planted_service));
+                int b = mlt_transition_get_b_track(MLT_TRANSITION(planted_service));
+                if (a >= 0 && a < count && b >= 0 && b < count && a != b) {
+                    stages[2 * i] = tracks[a];
+                    stages[2 * i + 1] = tracks[b];
+                    costs_blend(&tracks[a], &tracks[b], formats);
+                }
+            } else {
+                int track = mlt_properties_get_int(MLT_SERVICE_PROPERTIES(planted_service),
+                                                   "track");
+                if (track >= 0 && track < count) {
+                    stages[2 * i] = tracks[track];
+                    costs_apply(&tracks[track], formats);
+                }
+            }
+        }
+
+        // Walk back down from the tractor deciding what each track delivers
+        for (i = 0; i < count; i++)
+            wanted[i] = i ? costs_best(&tracks[i], NEGOTIABLE_FORMATS) : format;
+        for (i = 0; i < planted; i++) {
+            mlt_service planted_service = field[i];
+            unsigned formats = service_image_formats(planted_service, NULL);
+            if (!formats)
+                continue;
+            if (mlt_service_identify(planted_service) == mlt_service_transition_type) {
+                int a = mlt_transition_get_a_track(MLT_TRANSITION(planted_service));
+                int b = mlt_transition_get_b_track(MLT_TRANSITION(planted_service));
+                if (a >= 0 && a < count && b >= 0 && b < count && a != b) {
+                    format_costs both = stages[2 * i];
+                    int f;
+                    for (f = 0; f < mlt_image_invalid; f++)
+                        both.cost[f] += stages[2 * i + 1].cost[f];
+                    wanted[a] = wanted[b] = plan_choose(&both, formats, wanted[a]);
+                    plan_append(plan, planted_service, wanted[a]);
+                }
+            } else {
+                int track = mlt_properties_get_int(MLT_SERVICE_PROPERTIES(planted_service),
+                                                   "track");
+                if (track >= 0 && track < count) {
+                    wanted[track] = plan_choose(&stages[2 * i], formats, wanted[track]);
+                    plan_append(plan, planted_service, wanted[track]);
+                }
+            }
+        }
+        for (i = 0; i < count; i++) {
+            mlt_producer track = mlt_multitrack_track(multitrack, i);
+            plan_producer(MLT_PRODUCER_SERVICE(track), wanted[i], plan);
+        }
+        free(stages);
+        free(tracks);
+        free(wanted);
+    } else if (type == mlt_service_chain_type) {
+        mlt_chain chain = MLT_CHAIN(service);
+        mlt_producer source = mlt_chain_get_source(chain);
+        int count = mlt_chain_link_count(chain);
+        format_costs *stages = calloc(count + 1, sizeof(*stages));
+        if (source)
+            costs_producer(MLT_PRODUCER_SERVICE(source), &stages[0]);
+        for (i = 0; i < count; i++) {
+            stages[i + 1] = stages[i];
+            costs_apply(&stages[i + 1],
+                        service_image_formats(MLT_LINK_SERVICE(mlt_chain_link(chain, i)), NULL));
+        }
+        for (i = count - 1; i >= 0; i--) {
+            mlt_service link = MLT_LINK_SERVICE(mlt_chain_link(chain, i));
+            unsigned formats = service_image_formats(link, NULL);
+            if (formats) {
+                format = plan_choose(&stages[i], formats, format);
+                plan_append(plan, link, format);
+            }
+        }
+        if (source)
+            plan_producer(MLT_PRODUCER_SERVICE(source), format, plan);
+        free(stages);
+    } else if (type == mlt_service_producer_type && mlt_producer_is_cut(MLT_PRODUCER(service))) {
+        plan_producer(MLT_PRODUCER_SERVICE(mlt_producer_cut_parent(MLT_PRODUCER(service))),
+                      format,
+                      plan);
+    } else if (type == mlt_service_filter_type || type == mlt_service_transition_type) {
+        mlt_service input = mlt_service_producer(service);
+        unsigned formats = service_image_formats(service, NULL);
+        format_costs costs;
+        if (formats) {
+            if (input)
+                costs_producer(input, &costs);
+            else
+                memset(&costs, 0, sizeof(costs));
+            format = plan_choose(&costs, formats, format);
+            plan_append(plan, service, format);
+        }
+        if (input)
+            plan_producer(input, format, plan);
+    } else {
+        mlt_image_format preferred = format;
+        unsigned formats = service_image_formats(service, &preferred);
+        if (formats)
+            plan_append(plan, service, (formats & (1u << format)) ? format : preferred);
+    }
+}
+
+/** Describe how a producer delivers a format including its attached filters.
+ *
+ * The plan lists the services downstream first.
+ * \private \memberof mlt_consumer_s
+ * \param service a producer
+ * \param format the format to deliver
+ * \param plan the plan to append to
+ */
+
+static void plan_producer(mlt_service service, mlt_image_format format, format_plan *plan)
+{
+    int count = mlt_service_filter_count(service);
+    format_costs *stages = calloc(count + 1, sizeof(*stages));
+    int i;
+
+    costs_source(service, &stages[0]);
+    for (i = 0; i < count; i++) {
+        mlt_service filter = MLT_FILTER_SERVICE(mlt_service_filter(service, i));
+        stages[i + 1] = stages[i];
+        costs_apply(&stages[i + 1], service_image_formats(filter, NULL));
+    }
+    for (i = count - 1; i >= 0; i--) {
+        mlt_service filter = MLT_FILTER_SERVICE(mlt_service_filter(service, i));
+        unsigned formats = service_image_formats(filter, NULL);
+        if (formats) {
+            format = plan_choose(&stages[i], formats, format);
+            plan_append(plan, filter, format);
+        }
+    }
+    plan_source(service, format, plan);
+    free(stages);
+}
+
+/** Choose the image format to request from the producer.
+ *
+ * This walks the graph connected to the consumer and counts the image
+ * conversions implied by the formats the services declare in their metadata.
+ * The consumer requests the format that needs the fewest conversions among
+ * those it declares, unless mlt_image_format was set explicitly.
+ * \private \memberof mlt_consumer_s
+ * \param self a consumer
+ */
+
+static void negotiate_image_format(mlt_consumer self)
+{
+    consumer_private *priv = self->local;
+    mlt_properties properties = MLT_CONSUMER_PROPERTIES(self);
+    mlt_service producer = mlt_service_producer(MLT_CONSUMER_SERVICE(self));
+    mlt_image_format format = mlt_image_yuv422;
+    format_costs costs;
+    format_plan plan = {NULL, 0, 0};
+
+    // Forget a format chosen by a previous negotiation
+    if (priv->image_format_negotiated) {
+        mlt_properties_clear(properties, "mlt_image_format");
+        priv->image_format_negotiated = 0;
+    }
+    if (!producer)
+        return;
+
+    const char *current = mlt_properties_get(properties, "mlt_image_format");
+    unsigned formats = 0;
+    if (current)
+        format = mlt_image_format_id(current);
+    else
+        formats = service_image_formats(MLT_CONSUMER_SERVICE(self), NULL);
+    if (format == mlt_image_invalid || !(NEGOTIABLE_FORMATS & (1u << format)))
+        return;
+
+    // Prefer the format the consumer would use anyway on a tie
+    costs_producer(producer, &costs);
+    mlt_image_format best = format;
+    int f;
+    for (f = mlt_image_rgb; f < mlt_image_invalid; f++)
+        if ((formats & (1u << f)) && costs.cost[f] < costs.cost[best])
+            best = f;
+
+    plan_append(&plan, MLT_CONSUMER_SERVICE(self), best);
+    plan_producer(producer, best, &plan);
+    mlt_properties_set(properties, "image_format_plan", plan.text);
+    mlt_properties_set_int(properties, "image_conversions", costs.cost[best]);
+    mlt_log_debug(MLT_CONSUMER_SERVICE(self),
+                  "image format %s with %d conversions: %s\n",
+                  mlt_image_format_name(best),
+                  costs.cost[best],
+                  plan.text ? plan.text : "");
+    free(plan.text);
+
+    if (best != format) {
+        mlt_properties_set(properties, "mlt_image_format", mlt_image_format_name(best));
+        priv->image_format_negotiated = 1;
+    }
+}
+
 /** Start the consumer.
  *
  * \public \memberof mlt_consumer_s
@@ -557,6 +1081,9 @@ int mlt_consumer_start(mlt_consumer self)
         consumer_read_ahead_start(self);
 #endif
 
+    if (mlt_properties_get_int(properties, "negotiate_image_format"))
+        negotiate_image_format(self);
+
     // Start the service
     if (self->start != NULL)
         error = self->start(self);
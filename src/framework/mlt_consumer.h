@@ -81,6 +81,11 @@
  * \properties \em top_field_first when not progressive, whether interlace field order is top-field-first, defaults to 0.
  *   Set this to -1 if the consumer does not care about the field order.
  * \properties \em mlt_image_format the image format to request in rendering threads, defaults to yuv422
+ * \properties \em negotiate_image_format set non-zero to choose mlt_image_format when starting from the
+ *   image_formats declared in the metadata of the consumer and the services connected to it, unless it is set
+ * \properties \em image_format_plan the format each service works in as chosen by negotiate_image_format,
+ *   downstream first (read only)
+ * \properties \em image_conversions the number of image conversions per frame expected by negotiate_image_format (read only)
  * \properties \em mlt_audio_format the audio format to request in rendering threads, defaults to S16
  * \properties \em audio_off set non-zero to disable audio processing
  * \properties \em video_off set non-zero to disable video processing
@@ -23,6 +23,7 @@
 #include <limits.h>
 #include <pthread.h>
 #include <stdatomic.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -38,22 +39,69 @@ static int events_created = 0;
 static int events_destroyed = 0;
 #endif
 
+/** \brief the listeners of one event registered on an events object
+ *
+ * \p id is the process-wide number for the event name (see mlt_events_id()).
+ */
+
+typedef struct
+{
+    int id;
+    const char *name;
+    int count;
+    mlt_event *listeners;
+} event_list;
+
+/** \brief an immutable snapshot of all the listeners of an events object
+ *
+ * A change makes a new table and retires the old one, which stays allocated
+ * until no mlt_events_fire() that might be reading it is in progress. The
+ * listener arrays follow \p lists in the same allocation.
+ */
+
+typedef struct event_table_s
+{
+    struct event_table_s *retired;
+    int count;
+    event_list lists[];
+} event_table;
+
 /** \brief Events class
  *
  * Events provide messages and notifications between services and the application.
  * A service can register an event and fire/send it upon certain conditions or times.
  * Likewise, a service or an application can listen/receive specific events on specific
  * services.
+ *
+ * Firing an event takes no lock: it counts itself in \p readers and reads the
+ * current table. Changes are serialized by \p mutex. Events removed from the
+ * table are closed together with the retired tables. \p listening has a bit
+ * set for each event ID below 64 that has listeners, so firing an event without
+ * any does not need to read the table.
  */
 
 struct mlt_events_struct
 {
     mlt_properties owner;
-    mlt_properties listeners;
+    _Atomic(event_table *) table;
+    atomic_uint_fast64_t listening;
+    atomic_int readers;
+    atomic_int retiring;
+    pthread_mutex_t mutex;
+    event_table *retired;
+    mlt_event *dropped;
+    int dropped_count;
+    int dropped_size;
 };
 
 typedef struct mlt_events_struct *mlt_events;
 
+/** The process-wide names of events, indexed by event ID */
+
+static pthread_mutex_t event_names_mutex = PTHREAD_MUTEX_INITIALIZER;
+static char **event_names = NULL;
+static int event_names_count = 0;
+
 /** \brief Event class
  *
  */
@@ -133,6 +181,201 @@ void mlt_event_close(mlt_event self)
 static mlt_events mlt_events_fetch(mlt_properties);
 static void mlt_events_close(mlt_events);
 
+/** Get the number that identifies an event name.
+ *
+ * The number is the same for every events object in the process and can be
+ * given to mlt_events_fire_id() to fire an event without looking up its name.
+ * \public \memberof mlt_events_struct
+ * \param id the name of an event
+ * \return the event ID or -1 if there was an error
+ */
+
+int mlt_events_id(const char *id)
+{
+    int result = -1;
+    if (id != NULL) {
+        pthread_mutex_lock(&event_names_mutex);
+        for (int i = 0; result < 0 && i < event_names_count; i++)
+            if (!strcmp(event_names[i], id))
+                result = i;
+        if (result < 0) {
+            char **names = realloc(event_names, (event_names_count + 1) * sizeof(char *));
+            if (names != NULL) {
+                event_names = names;
+                event_names[event_names_count] = strdup(id);
+                if (event_names[event_names_count] != NULL)
+                    result = event_names_count++;
+            }
+        }
+        pthread_mutex_unlock(&event_names_mutex);
+    }
+    return result;
+}
+
+/** Make a table from a list of event lists.
+ *
+ * \private \memberof mlt_events_struct
+ * \param lists the event lists to copy
+ * \param count the number of event lists
+ * \return a new table or NULL if there was an error
+ */
+
+static event_table *event_table_new(const event_list *lists, int count)
+{
+    int listeners = 0;
+    for (int i = 0; i < count; i++)
+        listeners += lists[i].count;
+    event_table *table = malloc(sizeof(event_table) + count * sizeof(event_list)
+                                + listeners * sizeof(mlt_event));
+    if (table != NULL) {
+        mlt_event *slot = (mlt_event *) &table->lists[count];
+        table->retired = NULL;
+        table->count = count;
+        for (int i = 0; i < count; i++) {
+            table->lists[i] = lists[i];
+            table->lists[i].listeners = slot;
+            if (lists[i].count > 0)
+                memcpy(slot, lists[i].listeners, lists[i].count * sizeof(mlt_event));
+            slot += lists[i].count;
+        }
+    }
+    return table;
+}
+
+/** Find an event list in a table by name.
+ *
+ * \private \memberof mlt_events_struct
+ * \param table a table
+ * \param id the name of an event
+ * \return the index of the event list or -1 if not found
+ */
+
+static int event_table_find(event_table *table, const char *id)
+{
+    for (int i = 0; i < table->count; i++)
+        if (!strcmp(table->lists[i].name, id))
+            return i;
+    return -1;
+}
+
+/** Free the retired tables and close the dropped events if no fire is in progress.
+ *
+ * This must be called with the mutex locked.
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ */
+
+static void mlt_events_reclaim(mlt_events events)
+{
+    if (atomic_load(&events->readers) == 0) {
+        while (events->retired != NULL) {
+            event_table *table = events->retired;
+            events->retired = table->retired;
+            free(table);
+        }
+        for (int i = 0; i < events->dropped_count; i++)
+            mlt_event_close(events->dropped[i]);
+        events->dropped_count = 0;
+        atomic_store(&events->retiring, 0);
+    }
+}
+
+/** Make a table current and retire the previous one.
+ *
+ * This must be called with the mutex locked.
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param table the new table
+ */
+
+static void mlt_events_publish(mlt_events events, event_table *table)
+{
+    uint_fast64_t listening = 0;
+    for (int i = 0; i < table->count; i++)
+        if (table->lists[i].count > 0 && table->lists[i].id < 64)
+            listening |= (uint_fast64_t) 1 << table->lists[i].id;
+    event_table *previous = atomic_exchange(&events->table, table);
+    atomic_store(&events->listening, listening);
+    previous->retired = events->retired;
+    events->retired = previous;
+    atomic_store(&events->retiring, 1);
+    mlt_events_reclaim(events);
+}
+
+/** Remember an event removed from the table to close it when it is no longer in use.
+ *
+ * This must be called with the mutex locked.
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param event the event removed from the table
+ */
+
+static void mlt_events_drop(mlt_events events, mlt_event event)
+{
+    if (events->dropped_count == events->dropped_size) {
+        int size = events->dropped_size ? 2 * events->dropped_size : 8;
+        mlt_event *dropped = realloc(events->dropped, size * sizeof(mlt_event));
+        if (dropped == NULL) {
+            // Leaking the event is safer than freeing it while it may be in use.
+            return;
+        }
+        events->dropped = dropped;
+        events->dropped_size = size;
+    }
+    events->dropped[events->dropped_count++] = event;
+}
+
+/** Start reading the current table.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \return the current table
+ */
+
+static event_table *mlt_events_acquire(mlt_events events)
+{
+    atomic_fetch_add(&events->readers, 1);
+    return atomic_load(&events->table);
+}
+
+/** Stop reading a table.
+ *
+ * The last reader to finish frees the tables retired in the meantime.
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ */
+
+static void mlt_events_release(mlt_events events)
+{
+    if (atomic_fetch_sub(&events->readers, 1) == 1 && atomic_load(&events->retiring)
+        && pthread_mutex_trylock(&events->mutex) == 0) {
+        mlt_events_reclaim(events);
+        pthread_mutex_unlock(&events->mutex);
+    }
+}
+
+/** Call the listeners of an event list.
+ *
+ * \private \memberof mlt_events_struct
+ * \param events an events object
+ * \param list an event list
+ * \param event_data an event data object
+ * \return the number of listeners
+ */
+
+static int event_list_fire(mlt_events events, event_list *list, mlt_event_data event_data)
+{
+    int result = 0;
+    for (int i = 0; i < list->count; i++) {
+        mlt_event event = list->listeners[i];
+        if (event->parent != NULL && event->block_count == 0) {
+            event->listener(events->owner, event->listener_data, event_data);
+            ++result;
+        }
+    }
+    return result;
+}
+
 /** Initialise the events structure.
  *
  * \public \memberof mlt_events_struct
@@ -145,7 +388,13 @@ void mlt_events_init(mlt_properties self)
     if (!events && self) {
         events = calloc(1, sizeof(struct mlt_events_struct));
         if (events) {
-            events->listeners = mlt_properties_new();
+            event_table *table = event_table_new(NULL, 0);
+            if (table == NULL) {
+                free(events);
+                return;
+            }
+            atomic_init(&events->table, table);
+            pthread_mutex_init(&events->mutex, NULL);
             events->owner = self;
             mlt_properties_set_data(self,
                                     "_events",
@@ -169,17 +418,30 @@ int mlt_events_register(mlt_properties self, const char *id)
 {
     int error = 1;
     mlt_events events = mlt_events_fetch(self);
-    if (events != NULL) {
-        mlt_properties list = events->listeners;
-        char temp[128];
-        sprintf(temp, "list:%s", id);
-        if (mlt_properties_get_data(list, temp, NULL) == NULL)
-            mlt_properties_set_data(list,
-                                    temp,
-                                    mlt_properties_new(),
-                                    0,
-                                    (mlt_destructor) mlt_properties_close,
-                                    NULL);
+    int event_id = mlt_events_id(id);
+    if (events != NULL && event_id >= 0) {
+        pthread_mutex_lock(&events->mutex);
+        event_table *table = atomic_load(&events->table);
+        error = 0;
+        if (event_table_find(table, id) < 0) {
+            event_list *lists = malloc((table->count + 1) * sizeof(event_list));
+            error = lists == NULL;
+            if (!error) {
+                memcpy(lists, table->lists, table->count * sizeof(event_list));
+                lists[table->count].id = event_id;
+                pthread_mutex_lock(&event_names_mutex);
+                lists[table->count].name = event_names[event_id];
+                pthread_mutex_unlock(&event_names_mutex);
+                lists[table->count].count = 0;
+                lists[table->count].listeners = NULL;
+                event_table *copy = event_table_new(lists, table->count + 1);
+                error = copy == NULL;
+                if (!error)
+                    mlt_events_publish(events, copy);
+                free(lists);
+            }
+        }
+        pthread_mutex_unlock(&events->mutex);
     }
     return error;
 }
@@ -197,22 +459,40 @@ int mlt_events_fire(mlt_properties self, const char *id, mlt_event_data event_da
 {
     int result = 0;
     mlt_events events = mlt_events_fetch(self);
-    if (events != NULL) {
-        mlt_properties list = events->listeners;
-        mlt_properties listeners = NULL;
-        char temp[128];
-        sprintf(temp, "list:%s", id);
-        listeners = mlt_properties_get_data(list, temp, NULL);
-
-        if (listeners != NULL) {
-            for (int i = 0; i < mlt_properties_count(listeners); i++) {
-                mlt_event event = mlt_properties_get_data_at(listeners, i, NULL);
-                if (event != NULL && event->parent != NULL && event->block_count == 0) {
-                    event->listener(event->parent->owner, event->listener_data, event_data);
-                    ++result;
-                }
+    if (events != NULL && id != NULL) {
+        event_table *table = mlt_events_acquire(events);
+        int i = event_table_find(table, id);
+        if (i >= 0)
+            result = event_list_fire(events, &table->lists[i], event_data);
+        mlt_events_release(events);
+    }
+    return result;
+}
+
+/** Fire an event by its ID.
+ *
+ * This is the same as mlt_events_fire() without looking up the name.
+ * \public \memberof mlt_events_struct
+ * \param self a properties list
+ * \param id an event ID from mlt_events_id()
+ * \param event_data an event data object
+ * \return the number of listeners
+ */
+
+int mlt_events_fire_id(mlt_properties self, int id, mlt_event_data event_data)
+{
+    int result = 0;
+    mlt_events events = mlt_events_fetch(self);
+    if (events != NULL && id >= 0
+        && (id >= 64 || (atomic_load_explicit(&events->listening, memory_order_relaxed) >> id) & 1)) {
+        event_table *table = mlt_events_acquire(events);
+        for (int i = 0; i < table->count; i++) {
+            if (table->lists[i].id == id) {
+                result = event_list_fire(events, &table->lists[i], event_data);
+                break;
             }
         }
+        mlt_events_release(events);
     }
     return result;
 }
@@ -234,49 +514,67 @@ mlt_event mlt_events_listen(mlt_properties self,
 {
     mlt_event event = NULL;
     mlt_events events = mlt_events_fetch(self);
-    if (events != NULL) {
-        mlt_properties list = events->listeners;
-        mlt_properties listeners = NULL;
-        char temp[128];
-        sprintf(temp, "list:%s", id);
-        listeners = mlt_properties_get_data(list, temp, NULL);
-        if (listeners != NULL) {
+    if (events != NULL && id != NULL) {
+        pthread_mutex_lock(&events->mutex);
+        event_table *table = atomic_load(&events->table);
+        int index = event_table_find(table, id);
+        if (index >= 0) {
+            event_list *list = &table->lists[index];
             int first_null = -1;
             int i = 0;
-            for (i = 0; event == NULL && i < mlt_properties_count(listeners); i++) {
-                mlt_event entry = mlt_properties_get_data_at(listeners, i, NULL);
-                if (entry != NULL && entry->parent != NULL) {
+            for (i = 0; event == NULL && i < list->count; i++) {
+                mlt_event entry = list->listeners[i];
+                if (entry->parent != NULL) {
                     if (entry->listener_data == listener_data && entry->listener == listener)
                         event = entry;
-                } else if ((entry == NULL || entry->parent == NULL) && first_null == -1) {
+                } else if (first_null == -1) {
                     first_null = i;
                 }
             }
 
             if (event == NULL) {
+                event_list *lists = malloc(table->count * sizeof(event_list));
+                mlt_event *listeners = malloc((list->count + 1) * sizeof(mlt_event));
                 event = malloc(sizeof(struct mlt_event_struct));
-                if (event != NULL) {
+                if (lists != NULL && listeners != NULL && event != NULL) {
 #ifdef _MLT_EVENT_CHECKS_
                     events_created++;
 #endif
-                    sprintf(temp,
-                            "%d",
-                            first_null == -1 ? mlt_properties_count(listeners) : first_null);
                     event->parent = events;
                     event->ref_count = 0;
                     event->block_count = 0;
                     event->listener = listener;
                     event->listener_data = listener_data;
-                    mlt_properties_set_data(listeners,
-                                            temp,
-                                            event,
-                                            0,
-                                            (mlt_destructor) mlt_event_close,
-                                            NULL);
                     mlt_event_inc_ref(event);
+
+                    // Reuse the place of a closed listener or add one
+                    memcpy(lists, table->lists, table->count * sizeof(event_list));
+                    memcpy(listeners, list->listeners, list->count * sizeof(mlt_event));
+                    lists[index].listeners = listeners;
+                    if (first_null == -1) {
+                        listeners[lists[index].count++] = event;
+                    } else {
+                        mlt_events_drop(events, listeners[first_null]);
+                        listeners[first_null] = event;
+                    }
+                    event_table *copy = event_table_new(lists, table->count);
+                    if (copy != NULL) {
+                        mlt_events_publish(events, copy);
+                    } else {
+                        if (first_null != -1)
+                            events->dropped_count--;
+                        free(event);
+                        event = NULL;
+                    }
+                } else {
+                    free(event);
+                    event = NULL;
                 }
+                free(lists);
+                free(listeners);
             }
         }
+        pthread_mutex_unlock(&events->mutex);
     }
     return event;
 }
@@ -292,19 +590,15 @@ void mlt_events_block(mlt_properties self, void *listener_data)
 {
     mlt_events events = mlt_events_fetch(self);
     if (events != NULL) {
-        int i = 0, j = 0;
-        mlt_properties list = events->listeners;
-        for (j = 0; j < mlt_properties_count(list); j++) {
-            char *temp = mlt_properties_get_name(list, j);
-            if (!strncmp(temp, "list:", 5)) {
-                mlt_properties listeners = mlt_properties_get_data(list, temp, NULL);
-                for (i = 0; i < mlt_properties_count(listeners); i++) {
-                    mlt_event entry = mlt_properties_get_data_at(listeners, i, NULL);
-                    if (entry != NULL && entry->listener_data == listener_data)
-                        mlt_event_block(entry);
-                }
-            }
+        pthread_mutex_lock(&events->mutex);
+        event_table *table = atomic_load(&events->table);
+        for (int j = 0; j < table->count; j++) {
+            event_list *list = &table->lists[j];
+            for (int i = 0; i < list->count; i++)
+                if (list->listeners[i]->listener_data == listener_data)
+                    mlt_event_block(list->listeners[i]);
         }
+        pthread_mutex_unlock(&events->mutex);
     }
 }
 
@@ -319,19 +613,15 @@ void mlt_events_unblock(mlt_properties self, void *listener_data)
 {
     mlt_events events = mlt_events_fetch(self);
     if (events != NULL) {
-        int i = 0, j = 0;
-        mlt_properties list = events->listeners;
-        for (j = 0; j < mlt_properties_count(list); j++) {
-            char *temp = mlt_properties_get_name(list, j);
-            if (!strncmp(temp, "list:", 5)) {
-                mlt_properties listeners = mlt_properties_get_data(list, temp, NULL);
-                for (i = 0; i < mlt_properties_count(listeners); i++) {
-                    mlt_event entry = mlt_properties_get_data_at(listeners, i, NULL);
-                    if (entry != NULL && entry->listener_data == listener_data)
-                        mlt_event_unblock(entry);
-                }
-            }
+        pthread_mutex_lock(&events->mutex);
+        event_table *table = atomic_load(&events->table);
+        for (int j = 0; j < table->count; j++) {
+            event_list *list = &table->lists[j];
+            for (int i = 0; i < list->count; i++)
+                if (list->listeners[i]->listener_data == listener_data)
+                    mlt_event_unblock(list->listeners[i]);
         }
+        pthread_mutex_unlock(&events->mutex);
     }
 }
 
@@ -346,20 +636,48 @@ void mlt_events_disconnect(mlt_properties self, void *listener_data)
 {
     mlt_events events = mlt_events_fetch(self);
     if (events != NULL) {
-        int i = 0, j = 0;
-        mlt_properties list = events->listeners;
-        for (j = 0; j < mlt_properties_count(list); j++) {
-            char *temp = mlt_properties_get_name(list, j);
-            if (!strncmp(temp, "list:", 5)) {
-                mlt_properties listeners = mlt_properties_get_data(list, temp, NULL);
-                for (i = 0; i < mlt_properties_count(listeners); i++) {
-                    mlt_event entry = mlt_properties_get_data_at(listeners, i, NULL);
-                    char *name = mlt_properties_get_name(listeners, i);
-                    if (entry != NULL && entry->listener_data == listener_data)
-                        mlt_properties_set_data(listeners, name, NULL, 0, NULL, NULL);
+        pthread_mutex_lock(&events->mutex);
+        event_table *table = atomic_load(&events->table);
+        int total = 0;
+        int found = 0;
+        for (int j = 0; j < table->count; j++) {
+            event_list *list = &table->lists[j];
+            total += list->count;
+            for (int i = 0; i < list->count; i++)
+                found += list->listeners[i]->listener_data == listener_data;
+        }
+        if (found > 0) {
+            event_list *lists = malloc(table->count * sizeof(event_list));
+            mlt_event *listeners = malloc(total * sizeof(mlt_event));
+            if (lists != NULL && listeners != NULL) {
+                // Keep the other listeners in order
+                mlt_event *slot = listeners;
+                for (int j = 0; j < table->count; j++) {
+                    event_list *list = &table->lists[j];
+                    lists[j] = *list;
+                    lists[j].listeners = slot;
+                    lists[j].count = 0;
+                    for (int i = 0; i < list->count; i++) {
+                        if (list->listeners[i]->listener_data != listener_data)
+                            slot[lists[j].count++] = list->listeners[i];
+                    }
+                    slot += lists[j].count;
+                }
+                event_table *copy = event_table_new(lists, table->count);
+                if (copy != NULL) {
+                    for (int j = 0; j < table->count; j++) {
+                        event_list *list = &table->lists[j];
+                        for (int i = 0; i < list->count; i++)
+                            if (list->listeners[i]->listener_data == listener_data)
+                                mlt_events_drop(events, list->listeners[i]);
+                    }
+                    mlt_events_publish(events, copy);
                 }
             }
+            free(lists);
+            free(listeners);
         }
+        pthread_mutex_unlock(&events->mutex);
     }
 }
 
@@ -460,7 +778,22 @@ static mlt_events mlt_events_fetch(mlt_properties self)
 static void mlt_events_close(mlt_events events)
 {
     if (events != NULL) {
-        mlt_properties_close(events->listeners);
+        event_table *table = atomic_load(&events->table);
+        for (int j = 0; j < table->count; j++)
+            for (int i = 0; i < table->lists[j].count; i++)
+                mlt_event_close(table->lists[j].listeners[i]);
+        free(table);
+
+        // Nothing can fire an event of a closed owner, so ignore the reader count.
+        while (events->retired != NULL) {
+            event_table *retired = events->retired;
+            events->retired = retired->retired;
+            free(retired);
+        }
+        for (int i = 0; i < events->dropped_count; i++)
+            mlt_event_close(events->dropped[i]);
+        free(events->dropped);
+        pthread_mutex_destroy(&events->mutex);
         free(events);
     }
 }
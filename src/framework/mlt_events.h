@@ -53,6 +53,8 @@ typedef void (*mlt_listener)(mlt_properties, void *, mlt_event_data);
 extern void mlt_events_init(mlt_properties self);
 extern int mlt_events_register(mlt_properties self, const char *id);
 extern int mlt_events_fire(mlt_properties self, const char *id, mlt_event_data);
+extern int mlt_events_id(const char *id);
+extern int mlt_events_fire_id(mlt_properties self, int id, mlt_event_data);
 extern mlt_event mlt_events_listen(mlt_properties self,
                                    void *listener_data,
                                    const char *id,
@@ -127,6 +127,11 @@ mlt_repository mlt_factory_init(const char *directory)
                                       getenv("MLT_CONSUMER"),
                                       "sdl2");
         mlt_properties_set(global_properties, "MLT_TEST_CARD", getenv("MLT_TEST_CARD"));
+        mlt_properties_set(global_properties, "MLT_FRAME_RECYCLE", getenv("MLT_FRAME_RECYCLE"));
+        mlt_properties_set(global_properties, "MLT_POOL_HUGE_PAGES", getenv("MLT_POOL_HUGE_PAGES"));
+        mlt_properties_set(global_properties,
+                           "MLT_POOL_HUGE_PAGES_THRESHOLD",
+                           getenv("MLT_POOL_HUGE_PAGES_THRESHOLD"));
         mlt_properties_set_or_default(global_properties,
                                       "MLT_PROFILE",
                                       getenv("MLT_PROFILE"),
@@ -523,6 +528,7 @@ void mlt_factory_close()
         }
         free(mlt_directory);
         mlt_directory = NULL;
+        mlt_frame_recycle_close();
         mlt_pool_close();
     }
 }
@@ -30,6 +30,9 @@
  * \envvar \em MLT_PRODUCER the name of a default producer often used by other services, defaults to "loader"
  * \envvar \em MLT_CONSUMER the name of a default consumer, defaults to "sdl2" followed by "sdl"
  * \envvar \em MLT_TEST_CARD the name of a producer or file to be played when nothing is available (all tracks blank)
+ * \envvar \em MLT_FRAME_RECYCLE the number of closed frames to keep for reuse by mlt_frame_init(), defaults to 0 (disabled)
+ * \envvar \em MLT_POOL_HUGE_PAGES "transparent" or "explicit" to back large mlt_pool blocks with huge pages kept per NUMA node, defaults to unset (disabled)
+ * \envvar \em MLT_POOL_HUGE_PAGES_THRESHOLD the size in bytes from which MLT_POOL_HUGE_PAGES applies, defaults to 2097152
  * \envvar \em MLT_DATA overrides the default full path to the MLT and module supplemental data files, defaults to \p PREFIX_DATA
  * \envvar \em MLT_PROFILE selects the default mlt_profile_s, defaults to "dv_pal"
  * \envvar \em MLT_REPOSITORY overrides the default location of the plugin modules, defaults to \p PREFIX_LIB.
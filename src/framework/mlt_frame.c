@@ -27,10 +27,119 @@
 #include "mlt_producer.h"
 #include "mlt_profile.h"
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+/** The size of each chunk of a frame's property arena */
+#define FRAME_ARENA_SIZE 4096
+
+/** \brief closed frames kept for reuse by mlt_frame_init()
+ *
+ * Recycling is enabled by setting the MLT_FRAME_RECYCLE environment variable or
+ * global property to the number of frames to keep. It is read once, on the
+ * first frame after mlt_factory_init(). A recycled frame keeps its
+ * properties, their arena and its stacks, so a steady stream of frames, such
+ * as a consumer's read-ahead, does not allocate once warmed up.
+ */
+
+static struct
+{
+    pthread_mutex_t mutex;
+    mlt_frame *frames;
+    atomic_int count;
+    int size;
+    atomic_int limit;
+} recycled = {PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, -1};
+
+/** Get the maximum number of closed frames to keep for reuse.
+ *
+ * \private \memberof mlt_frame_s
+ * \return the limit, zero if frames are not recycled
+ */
+
+static inline int recycle_limit()
+{
+    int limit = atomic_load_explicit(&recycled.limit, memory_order_relaxed);
+    if (limit < 0) {
+        mlt_properties global = mlt_global_properties();
+        if (!global)
+            return 0;
+        limit = MAX(0, mlt_properties_get_int(global, "MLT_FRAME_RECYCLE"));
+        atomic_store_explicit(&recycled.limit, limit, memory_order_relaxed);
+    }
+    return limit;
+}
+
+/** Take a frame from the recycled frames.
+ *
+ * \private \memberof mlt_frame_s
+ * \return a frame or NULL if there are none
+ */
+
+static mlt_frame recycle_pop()
+{
+    mlt_frame self = NULL;
+    if (recycled.count) {
+        pthread_mutex_lock(&recycled.mutex);
+        if (recycled.count)
+            self = recycled.frames[--recycled.count];
+        pthread_mutex_unlock(&recycled.mutex);
+    }
+    return self;
+}
+
+/** Reset a closed frame and add it to the recycled frames.
+ *
+ * \private \memberof mlt_frame_s
+ * \param self a frame whose reference count has reached zero
+ * \return true if the frame was recycled, false if it must be freed
+ */
+
+static int recycle_push(mlt_frame self)
+{
+    int limit = recycle_limit();
+    int pushed = 0;
+
+    if (limit <= 0 || self->parent.close != NULL || recycled.count >= limit)
+        return 0;
+
+    // Reset outside of the lock since destructors may run
+    while (mlt_deque_count(self->stack_image))
+        mlt_deque_pop_back(self->stack_image);
+    while (mlt_deque_count(self->stack_audio))
+        mlt_deque_pop_back(self->stack_audio);
+    while (mlt_deque_peek_back(self->stack_service))
+        mlt_service_close(mlt_deque_pop_back(self->stack_service));
+    while (mlt_deque_count(self->stack_service))
+        mlt_deque_pop_back(self->stack_service);
+    mlt_properties_reset(&self->parent);
+    self->convert_image = NULL;
+    self->convert_audio = NULL;
+    self->is_processing = 0;
+
+    pthread_mutex_lock(&recycled.mutex);
+    if (recycled.count < limit) {
+        if (recycled.count == recycled.size) {
+            int size = recycled.size ? recycled.size * 2 : 8;
+            mlt_frame *frames = realloc(recycled.frames, size * sizeof(mlt_frame));
+            if (frames) {
+                recycled.frames = frames;
+                recycled.size = size;
+            }
+        }
+        if (recycled.count < recycled.size) {
+            recycled.frames[recycled.count++] = self;
+            pushed = 1;
+        }
+    }
+    pthread_mutex_unlock(&recycled.mutex);
+
+    return pushed;
+}
+
 /** Construct a frame object.
  *
  * \public \memberof mlt_frame_s
@@ -40,15 +149,30 @@
 
 mlt_frame mlt_frame_init(mlt_service service)
 {
-    // Allocate a frame
-    mlt_frame self = calloc(1, sizeof(struct mlt_frame_s));
+    // Reuse a closed frame or allocate one
+    mlt_frame self = recycle_pop();
 
     if (self != NULL) {
-        mlt_profile profile = mlt_service_profile(service);
+        mlt_properties_inc_ref(&self->parent);
+    } else {
+        self = calloc(1, sizeof(struct mlt_frame_s));
+        if (self != NULL) {
+            // Initialise the properties
+            mlt_properties_init(&self->parent, self);
+
+            // Construct stacks for frames and methods
+            self->stack_image = mlt_deque_init();
+            self->stack_audio = mlt_deque_init();
+            self->stack_service = mlt_deque_init();
+        }
+    }
 
-        // Initialise the properties
+    if (self != NULL) {
+        mlt_profile profile = mlt_service_profile(service);
         mlt_properties properties = &self->parent;
-        mlt_properties_init(properties, self);
+
+        // Frames that will be recycled keep their strings in an arena
+        mlt_properties_set_arena(properties, recycle_limit() > 0 ? FRAME_ARENA_SIZE : 0);
 
         // Set default properties on the frame
         mlt_properties_set_position(properties, "_position", 0.0);
@@ -58,11 +182,6 @@ mlt_frame mlt_frame_init(mlt_service service)
         mlt_properties_set_double(properties, "aspect_ratio", mlt_profile_sar(NULL));
         mlt_properties_set_data(properties, "audio", NULL, 0, NULL, NULL);
         mlt_properties_set_data(properties, "alpha", NULL, 0, NULL, NULL);
-
-        // Construct stacks for frames and methods
-        self->stack_image = mlt_deque_init();
-        self->stack_audio = mlt_deque_init();
-        self->stack_service = mlt_deque_init();
     }
 
     return self;
@@ -819,6 +938,8 @@ mlt_producer mlt_frame_get_original_producer(mlt_frame self)
 void mlt_frame_close(mlt_frame self)
 {
     if (self != NULL && mlt_properties_dec_ref(MLT_FRAME_PROPERTIES(self)) <= 0) {
+        if (recycle_push(self))
+            return;
         mlt_deque_close(self->stack_image);
         mlt_deque_close(self->stack_audio);
         while (mlt_deque_peek_back(self->stack_service))
@@ -829,6 +950,31 @@ void mlt_frame_close(mlt_frame self)
     }
 }
 
+/** Free the frames kept for reuse.
+ *
+ * This is called by mlt_factory_close().
+ * \public \memberof mlt_frame_s
+ */
+
+void mlt_frame_recycle_close()
+{
+    mlt_frame self;
+    while ((self = recycle_pop())) {
+        mlt_deque_close(self->stack_image);
+        mlt_deque_close(self->stack_audio);
+        mlt_deque_close(self->stack_service);
+        mlt_properties_close(&self->parent);
+        free(self);
+    }
+    pthread_mutex_lock(&recycled.mutex);
+    free(recycled.frames);
+    recycled.frames = NULL;
+    recycled.size = 0;
+    // Read the limit again after the next mlt_factory_init()
+    atomic_store_explicit(&recycled.limit, -1, memory_order_relaxed);
+    pthread_mutex_unlock(&recycled.mutex);
+}
+
 /***** convenience functions *****/
 
 void mlt_frame_write_ppm(mlt_frame frame)
@@ -69,6 +69,7 @@ typedef int (*mlt_get_audio)(mlt_frame self,
  * \properties \em next \em frame a reference to the unfiltered following frame
  * (no speed factor applied, only available when \em _need_previous_next is set on the producer)
  * \properties \em colorspace the standard for the YUV coefficients
+ * \properties \em image_conversions the number of times the image was converted to another format
  * \properties \em force_full_luma luma range handling: 1 for full range, 0 for scaling (DEPRECATED)
  * \properties \em color_trc the color transfer characteristic (gamma)
  * \properties \em audio_frequency the sample rate of the audio
@@ -168,6 +169,7 @@ extern void *mlt_frame_pop_audio(mlt_frame self);
 extern mlt_deque mlt_frame_service_stack(mlt_frame self);
 extern mlt_producer mlt_frame_get_original_producer(mlt_frame self);
 extern void mlt_frame_close(mlt_frame self);
+extern void mlt_frame_recycle_close();
 extern mlt_properties mlt_frame_unique_properties(mlt_frame self, mlt_service service);
 extern mlt_properties mlt_frame_get_unique_properties(mlt_frame self, mlt_service service);
 extern mlt_frame mlt_frame_clone(mlt_frame self, int is_deep);
@@ -79,6 +79,7 @@ void mlt_image_set_values(mlt_image self, void *data, mlt_image_format format, i
     self->width = width;
     self->height = height;
     self->colorspace = mlt_colorspace_unspecified;
+    self->alpha = NULL;
     self->release_data = NULL;
     self->release_alpha = NULL;
     self->close = NULL;
@@ -204,6 +205,71 @@ int mlt_image_calculate_size(mlt_image self)
     return 0;
 }
 
+/** Get the dimensions of one plane of the Image.
+ *
+ * Packed formats have a single plane whose samples are whole pixels. Plane 3
+ * is the alpha channel when one is allocated.
+ *
+ * \public \memberof mlt_image_s
+ * \param self the Image object
+ * \param plane the index of the plane
+ * \param[out] width the number of samples in a row of the plane (optional)
+ * \param[out] height the number of rows in the plane (optional)
+ * \return the number of bytes per sample or 0 if the image does not have the plane
+ */
+
+int mlt_image_plane_dimensions(mlt_image self, int plane, int *width, int *height)
+{
+    int w = self->width;
+    int h = self->height;
+    int bytes = 0;
+
+    if (plane == 3) {
+        bytes = self->alpha ? 1 : 0;
+    } else if (plane == 0) {
+        switch (self->format) {
+        case mlt_image_yuv420p:
+            bytes = 1;
+            break;
+        case mlt_image_yuv422p16:
+        case mlt_image_yuv420p10:
+        case mlt_image_yuv444p10:
+            bytes = 2;
+            break;
+        default:
+            mlt_image_format_size(self->format, 1, 1, &bytes);
+            break;
+        }
+    } else if (plane < 3) {
+        switch (self->format) {
+        case mlt_image_yuv420p:
+            w >>= 1;
+            h >>= 1;
+            bytes = 1;
+            break;
+        case mlt_image_yuv422p16:
+            w >>= 1;
+            bytes = 2;
+            break;
+        case mlt_image_yuv420p10:
+            w >>= 1;
+            h >>= 1;
+            bytes = 2;
+            break;
+        case mlt_image_yuv444p10:
+            bytes = 2;
+            break;
+        default:
+            break;
+        }
+    }
+    if (width)
+        *width = bytes ? w : 0;
+    if (height)
+        *height = bytes ? h : 0;
+    return bytes;
+}
+
 /** Get the short name for an image format.
  *
  * \public \memberof mlt_image_s
@@ -55,6 +55,7 @@ extern void mlt_image_get_values(
 extern void mlt_image_alloc_data(mlt_image self);
 extern void mlt_image_alloc_alpha(mlt_image self);
 extern int mlt_image_calculate_size(mlt_image self);
+extern int mlt_image_plane_dimensions(mlt_image self, int plane, int *width, int *height);
 extern void mlt_image_fill_black(mlt_image self);
 extern void mlt_image_fill_checkerboard(mlt_image self, double sample_aspect_ratio);
 extern void mlt_image_fill_white(mlt_image self, int full_range);
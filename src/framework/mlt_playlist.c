@@ -88,6 +88,7 @@ mlt_playlist mlt_playlist_alloc()
         self->list = calloc(self->size, sizeof(playlist_entry *));
         if (self->list == NULL)
             goto error2;
+        self->starts_count = -1;
 
         mlt_events_register(MLT_PLAYLIST_PROPERTIES(self), "playlist-next");
     }
@@ -170,52 +171,92 @@ mlt_properties mlt_playlist_properties(mlt_playlist self)
     return MLT_PRODUCER_PROPERTIES(&self->parent);
 }
 
-/** Refresh the playlist after a clip has been changed.
+/** Update a playlist entry from its producer.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \param i the index of the playlist entry
+ */
+
+static void mlt_playlist_refresh_entry(mlt_playlist self, int i)
+{
+    // Get the producer
+    mlt_producer producer = self->list[i]->producer;
+    if (producer) {
+        int current_length = mlt_producer_get_playtime(producer);
+
+        // Check if the length of the producer has changed
+        if (self->list[i]->frame_in != mlt_producer_get_in(producer)
+            || self->list[i]->frame_out != mlt_producer_get_out(producer)) {
+            // This clip should be removed...
+            if (current_length < 1) {
+                self->list[i]->frame_in = 0;
+                self->list[i]->frame_out = -1;
+                self->list[i]->frame_count = 0;
+            } else {
+                self->list[i]->frame_in = mlt_producer_get_in(producer);
+                self->list[i]->frame_out = mlt_producer_get_out(producer);
+                self->list[i]->frame_count = current_length;
+            }
+
+            // Update the producer_length
+            self->list[i]->producer_length = current_length;
+        }
+    }
+
+    // Calculate the frame_count
+    self->list[i]->frame_count = (self->list[i]->frame_out - self->list[i]->frame_in + 1)
+                                 * self->list[i]->repeat;
+}
+
+/** Refresh the playlist entries from the specified one onwards.
  *
+ * This also rebuilds the index of entry start times used to locate a position.
+ * Entries before \p first are only skipped when they are already indexed.
  * \private \memberof mlt_playlist_s
  * \param self a playlist
+ * \param first the index of the first playlist entry that changed
  * \return false
  */
 
-static int mlt_playlist_virtual_refresh(mlt_playlist self)
+static int mlt_playlist_refresh_from(mlt_playlist self, int first)
 {
     // Obtain the properties
     mlt_properties properties = MLT_PLAYLIST_PROPERTIES(self);
     int i = 0;
     mlt_position frame_count = 0;
 
-    for (i = 0; i < self->count; i++) {
-        // Get the producer
-        mlt_producer producer = self->list[i]->producer;
-        if (producer) {
-            int current_length = mlt_producer_get_playtime(producer);
-
-            // Check if the length of the producer has changed
-            if (self->list[i]->frame_in != mlt_producer_get_in(producer)
-                || self->list[i]->frame_out != mlt_producer_get_out(producer)) {
-                // This clip should be removed...
-                if (current_length < 1) {
-                    self->list[i]->frame_in = 0;
-                    self->list[i]->frame_out = -1;
-                    self->list[i]->frame_count = 0;
-                } else {
-                    self->list[i]->frame_in = mlt_producer_get_in(producer);
-                    self->list[i]->frame_out = mlt_producer_get_out(producer);
-                    self->list[i]->frame_count = current_length;
-                }
-
-                // Update the producer_length
-                self->list[i]->producer_length = current_length;
-            }
+    // Make sure there is room to index every entry
+    if (self->count + 1 > self->starts_size) {
+        int size = self->size + 1;
+        mlt_position *starts = realloc(self->starts, size * sizeof(mlt_position));
+        if (starts) {
+            self->starts = starts;
+            self->starts_size = size;
         }
+    }
+    int indexed = self->count + 1 <= self->starts_size;
 
-        // Calculate the frame_count
-        self->list[i]->frame_count = (self->list[i]->frame_out - self->list[i]->frame_in + 1)
-                                     * self->list[i]->repeat;
+    if (!indexed || first < 0 || first > self->starts_count)
+        first = 0;
+    if (first > 0)
+        frame_count = self->starts[first];
+
+    for (i = first; i < self->count; i++) {
+        mlt_playlist_refresh_entry(self, i);
+
+        // Index the start of this clip, which requires the lengths to be positive
+        if (indexed) {
+            self->starts[i] = frame_count;
+            indexed = self->list[i]->frame_count >= 0;
+        }
 
         // Update the frame_count for self clip
         frame_count += self->list[i]->frame_count;
     }
+    if (indexed)
+        self->starts[self->count] = frame_count;
+    self->starts_count = indexed ? self->count : -1;
 
     // Refresh all properties
     mlt_events_block(properties, properties);
@@ -226,6 +267,18 @@ static int mlt_playlist_virtual_refresh(mlt_playlist self)
     return 0;
 }
 
+/** Refresh the playlist after a clip has been changed.
+ *
+ * \private \memberof mlt_playlist_s
+ * \param self a playlist
+ * \return false
+ */
+
+static int mlt_playlist_virtual_refresh(mlt_playlist self)
+{
+    return mlt_playlist_refresh_from(self, 0);
+}
+
 /** Listener for producers on the playlist.
  *
  * Refreshes the playlist whenever an entry receives producer-changed.
@@ -345,7 +398,8 @@ static int mlt_playlist_virtual_append(mlt_playlist self,
         self->count++;
     }
 
-    return mlt_playlist_virtual_refresh(self);
+    // Appending leaves the preceding entries unchanged
+    return mlt_playlist_refresh_from(self, self->count - 1);
 }
 
 /** Locate a producer by index.
@@ -366,6 +420,29 @@ static mlt_producer mlt_playlist_locate(mlt_playlist self,
     // Default producer to NULL
     mlt_producer producer = NULL;
 
+    if (self->starts_count == self->count) {
+        // Search for the first entry that ends after the position.
+        // Note that 0 length clips get skipped automatically
+        int low = 0;
+        int high = self->count;
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            if (*position < self->starts[middle + 1])
+                high = middle;
+            else
+                low = middle + 1;
+        }
+        *clip = low;
+        if (low < self->count) {
+            *total += self->starts[low + 1];
+            producer = self->list[low]->producer;
+        } else {
+            *total += self->starts[low];
+        }
+        *position -= self->starts[low];
+        return producer;
+    }
+
     // Loop for each producer until found
     for (*clip = 0; *clip < self->count; *clip += 1) {
         // Increment the total
@@ -496,19 +573,10 @@ static mlt_producer mlt_playlist_virtual_set_out(mlt_playlist self)
     // Map playlist position to real producer in virtual playlist
     mlt_position position = mlt_producer_frame(&self->parent);
 
-    // Loop through the virtual playlist
+    // Locate the entry in the virtual playlist
     int i = 0;
-
-    for (i = 0; i < self->count; i++) {
-        if (position < self->list[i]->frame_count) {
-            // Found it, now break
-            producer = self->list[i]->producer;
-            break;
-        } else {
-            // Decrement position by length of this entry
-            position -= self->list[i]->frame_count;
-        }
-    }
+    int total = 0;
+    producer = mlt_playlist_locate(self, &position, &i, &total);
 
     if (!producer) {
         producer = blank_producer(self);
@@ -519,6 +587,7 @@ static mlt_producer mlt_playlist_virtual_set_out(mlt_playlist self)
         // Update the frame_count for the changed clip (hmmm)
         self->list[i]->frame_out = position;
         self->list[i]->frame_count = self->list[i]->frame_out - self->list[i]->frame_in + 1;
+        self->starts_count = -1;
 
         // Refresh the playlist
         mlt_playlist_virtual_refresh(self);
@@ -539,18 +608,10 @@ int mlt_playlist_current_clip(mlt_playlist self)
     // Map playlist position to real producer in virtual playlist
     mlt_position position = mlt_producer_frame(&self->parent);
 
-    // Loop through the virtual playlist
+    // Locate the entry in the virtual playlist
     int i = 0;
-
-    for (i = 0; i < self->count; i++) {
-        if (position < self->list[i]->frame_count) {
-            // Found it, now break
-            break;
-        } else {
-            // Decrement position by length of this entry
-            position -= self->list[i]->frame_count;
-        }
-    }
+    int total = 0;
+    mlt_playlist_locate(self, &position, &i, &total);
 
     return i;
 }
@@ -609,8 +670,11 @@ mlt_position mlt_playlist_clip(mlt_playlist self, mlt_whence whence, int index)
         absolute_clip = self->count;
 
     // Now determine the position
-    for (i = 0; i < absolute_clip; i++)
-        position += self->list[i]->frame_count;
+    if (self->starts_count == self->count)
+        position = self->starts[absolute_clip];
+    else
+        for (i = 0; i < absolute_clip; i++)
+            position += self->list[i]->frame_count;
 
     return position;
 }
@@ -674,6 +738,7 @@ int mlt_playlist_clear(mlt_playlist self)
         mlt_producer_close(self->list[i]->producer);
     }
     self->count = 0;
+    self->starts_count = -1;
     return mlt_playlist_virtual_refresh(self);
 }
 
@@ -805,6 +870,7 @@ int mlt_playlist_remove(mlt_playlist self, int where)
         for (i = where + 1; i < self->count; i++)
             self->list[i - 1] = self->list[i];
         self->count--;
+        self->starts_count = -1;
 
         if (entry->preservation_hack == 0) {
             // Decouple from mix_in/out if necessary
@@ -896,6 +962,7 @@ int mlt_playlist_move(mlt_playlist self, int src, int dest)
                 self->list[i] = self->list[i + 1];
         }
         self->list[dest] = src_entry;
+        self->starts_count = -1;
 
         mlt_playlist_get_clip_info(self, &current_info, current);
         mlt_producer_seek(MLT_PLAYLIST_PRODUCER(self), current_info.start + position);
@@ -942,6 +1009,7 @@ int mlt_playlist_reorder(mlt_playlist self, const int *indices)
     // Delete the old list and save the new list
     free(self->list);
     self->list = new_list;
+    self->starts_count = -1;
     mlt_playlist_virtual_refresh(self);
 
     return 0;
@@ -2105,6 +2173,7 @@ void mlt_playlist_close(mlt_playlist self)
         }
         mlt_producer_close(&self->parent);
         free(self->list);
+        free(self->starts);
         free(self);
     }
 }
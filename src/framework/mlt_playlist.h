@@ -76,6 +76,9 @@ struct mlt_playlist_s
     int size;
     int count;
     playlist_entry **list;
+    mlt_position *starts; /// the start of each entry followed by the total length
+    int starts_size;      /// the allocated size of starts
+    int starts_count;     /// the number of entries indexed by starts or -1 if it is out of date
 };
 
 #define MLT_PLAYLIST_PRODUCER(playlist) (&(playlist)->parent)
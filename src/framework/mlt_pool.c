@@ -21,10 +21,13 @@
  */
 
 #include "mlt_deque.h"
+#include "mlt_factory.h"
 #include "mlt_log.h"
 #include "mlt_properties.h"
 
+#include <inttypes.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -33,6 +36,12 @@
 #include <malloc.h>
 #endif
 
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 // Macros to re-assign system functions.
 #ifdef _WIN32
 #define mlt_free _aligned_free
@@ -74,19 +83,64 @@ void mlt_pool_stat() {}
 
 #else
 
-/** global singleton for tracking pools */
+/** The smallest block size as a power of two */
+#define POOL_MIN_SHIFT 8
+
+/** Blocks up to this size as a power of two come in powers of two */
+#define POOL_FINE_SHIFT 16
+
+/** The largest block size as a power of two */
+#define POOL_MAX_SHIFT 30
+
+/** Each power of two above 2^POOL_FINE_SHIFT is split into this many classes */
+#define POOL_STEPS 8
+
+/** The number of size classes */
+#define POOL_CLASSES \
+    (POOL_FINE_SHIFT - POOL_MIN_SHIFT + 1 + (POOL_MAX_SHIFT - POOL_FINE_SHIFT) * POOL_STEPS)
+
+/** The most blocks of a class a thread keeps for itself */
+#define MAGAZINE_MAX 32
+
+/** The most bytes of a class a thread keeps for itself */
+#define MAGAZINE_BYTES (4 << 20)
+
+/** The most NUMA nodes that large blocks are kept apart for */
+#define POOL_NODES 8
+
+/** The size of a huge page and the default size from which blocks use them */
+#define HUGE_PAGE_SIZE (2 << 20)
+
+/** Blocks smaller than this never look at the large block mode */
+#define LARGE_MIN_SIZE (64 << 10)
 
-static mlt_properties pools = NULL;
+/** \brief how blocks above the threshold are allocated, see pool_large_mode() */
+
+typedef enum {
+    large_heap = 0,     ///< like any other block
+    large_transparent,  ///< mapped and advised to use transparent huge pages
+    large_explicit      ///< mapped from the reserved huge pages if possible
+} pool_large_mode_e;
 
 /** \brief Pool (memory) class
+ *
+ * A pool holds the free blocks of one size class that are not cached by a
+ * thread (see ::pool_cache). The counters are atomic so that the fast path,
+ * which only touches the calling thread's cache, does not take the lock.
  */
 
 typedef struct mlt_pool_s
 {
-    pthread_mutex_t lock; ///< lock to prevent race conditions
-    mlt_deque stack;      ///< a stack of addresses to memory blocks
-    int size;             ///< the size of the memory block as a power of 2
-    int count;            ///< the number of blocks in the pool
+    pthread_mutex_t lock;    ///< lock to prevent race conditions
+    mlt_deque stack;         ///< a stack of addresses to memory blocks
+    mlt_deque nodes[POOL_NODES]; ///< stacks of mapped blocks by NUMA node
+    int size;                ///< the size of the memory block including its header
+    int magazine;            ///< the number of blocks a thread may cache
+    atomic_int count;        ///< the number of blocks in the pool
+    atomic_int used;         ///< the number of blocks handed out
+    atomic_int high_water;   ///< the most blocks handed out since the last trim
+    atomic_uint_fast64_t hits;   ///< the number of fetches served from a cache
+    atomic_uint_fast64_t misses; ///< the number of fetches that allocated
 } * mlt_pool;
 
 /** \brief private to mlt_pool_s, for tracking items to release
@@ -99,34 +153,282 @@ typedef struct __attribute__((aligned(16))) mlt_release_s
 {
     mlt_pool pool;
     int references;
+    int node; ///< the NUMA node of a mapped block or -1 if from the heap
 } * mlt_release;
 
-/** Create a pool.
+/** \brief the free blocks of one size class owned by a thread */
+
+typedef struct
+{
+    void **items;
+    int count;
+} pool_magazine;
+
+/** \brief the free blocks cached by a thread, returned to the pools when it exits */
+
+typedef struct
+{
+    pool_magazine magazines[POOL_CLASSES];
+} pool_cache;
+
+/** global singleton for all pools */
+
+static struct mlt_pool_s pools[POOL_CLASSES];
+static pthread_once_t pools_once = PTHREAD_ONCE_INIT;
+static pthread_key_t cache_key;
+static _Thread_local pool_cache *thread_cache = NULL;
+
+/** Get the index of the size class for a block.
+ *
+ * \private \memberof mlt_pool_s
+ * \param size the number of bytes including the header
+ * \return the index of the smallest class that fits or -1 if too big
+ */
+
+static inline int pool_index(size_t size)
+{
+    int shift = POOL_MIN_SHIFT;
+
+    if (size <= (1 << POOL_MIN_SHIFT))
+        return 0;
+    if (size > ((size_t) 1 << POOL_MAX_SHIFT))
+        return -1;
+
+    // Find the power of two that fits
+    while (((size_t) 1 << shift) < size)
+        shift++;
+    if (shift <= POOL_FINE_SHIFT)
+        return shift - POOL_MIN_SHIFT;
+
+    // Find the step within the previous power of two
+    size_t step = (size_t) 1 << (shift - 1) >> 3;
+    int n = (size + step - 1) / step - POOL_STEPS;
+    return POOL_FINE_SHIFT - POOL_MIN_SHIFT + (shift - 1 - POOL_FINE_SHIFT) * POOL_STEPS + n;
+}
+
+/** The configured mode for large blocks, see pool_large_config() */
+static atomic_int large_mode = large_heap;
+
+/** The smallest size of a block that uses ::large_mode */
+static atomic_long large_threshold = HUGE_PAGE_SIZE;
+
+/** Read the configuration of large blocks.
+ *
+ * Large blocks are configured by the MLT_POOL_HUGE_PAGES environment variable
+ * or global property: "transparent" (or "1") maps them and asks for
+ * transparent huge pages, "explicit" maps them from the reserved huge pages
+ * falling back to transparent ones, and anything else uses the heap. The
+ * MLT_POOL_HUGE_PAGES_THRESHOLD variable or property sets the smallest size
+ * in bytes, 2 MiB by default. Mapped blocks are kept per NUMA node and only
+ * reused on the node of the thread that first allocated them.
  *
+ * This is read when the pool is first used and again by mlt_pool_init(),
+ * which mlt_factory_init() calls after setting the global properties.
  * \private \memberof mlt_pool_s
- * \param size the size of the memory blocks to hold as some power of two
- * \return a new pool object
  */
 
-static mlt_pool pool_init(int size)
+static void pool_large_config()
 {
-    // Create the pool
-    mlt_pool self = calloc(1, sizeof(struct mlt_pool_s));
+#ifdef __linux__
+    mlt_properties properties = mlt_global_properties();
+    const char *mode = properties ? mlt_properties_get(properties, "MLT_POOL_HUGE_PAGES")
+                                  : getenv("MLT_POOL_HUGE_PAGES");
+    const char *threshold = properties
+                                ? mlt_properties_get(properties, "MLT_POOL_HUGE_PAGES_THRESHOLD")
+                                : getenv("MLT_POOL_HUGE_PAGES_THRESHOLD");
+    pool_large_mode_e result = large_heap;
+    if (mode && (!strcmp(mode, "transparent") || !strcmp(mode, "1")))
+        result = large_transparent;
+    else if (mode && !strcmp(mode, "explicit"))
+        result = large_explicit;
+    atomic_store_explicit(&large_threshold,
+                          threshold ? strtol(threshold, NULL, 10) : HUGE_PAGE_SIZE,
+                          memory_order_relaxed);
+    atomic_store_explicit(&large_mode, result, memory_order_relaxed);
+#endif
+}
 
-    // Initialise it
-    if (self != NULL) {
-        // Initialise the mutex
-        pthread_mutex_init(&self->lock, NULL);
+/** Get the mode for allocating blocks of a size.
+ *
+ * \private \memberof mlt_pool_s
+ * \param size the size of the block including its header
+ * \return the mode
+ */
 
-        // Create the stack
-        self->stack = mlt_deque_init();
+static inline pool_large_mode_e pool_large_mode(int size)
+{
+    if (size >= LARGE_MIN_SIZE
+        && size >= atomic_load_explicit(&large_threshold, memory_order_relaxed))
+        return atomic_load_explicit(&large_mode, memory_order_relaxed);
+    return large_heap;
+}
+
+/** Get the NUMA node of the calling thread.
+ *
+ * \private \memberof mlt_pool_s
+ * \return the node, folded into the range of ::POOL_NODES
+ */
+
+static int pool_node()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu = 0, node = 0;
+    if (!syscall(SYS_getcpu, &cpu, &node, NULL))
+        return node % POOL_NODES;
+#endif
+    return 0;
+}
+
+/** Get the length of the mapping of a block.
+ *
+ * \private \memberof mlt_pool_s
+ * \param size the size of the block including its header
+ * \return the size rounded up to whole huge pages
+ */
+
+static inline size_t pool_map_size(int size)
+{
+    return ((size_t) size + HUGE_PAGE_SIZE - 1) & ~((size_t) HUGE_PAGE_SIZE - 1);
+}
+
+/** Map a large block backed by huge pages.
+ *
+ * The pages are placed by the kernel on the node of the thread that first
+ * touches them, normally the one that allocated the block to fill it.
+ * \private \memberof mlt_pool_s
+ * \param size the size of the block including its header
+ * \param mode how to map the block
+ * \return the block or NULL if it could not be mapped
+ */
+
+static mlt_release pool_map(int size, pool_large_mode_e mode)
+{
+#ifdef __linux__
+    size_t length = pool_map_size(size);
+    char *block;
+
+#ifdef MAP_HUGETLB
+    if (mode == large_explicit) {
+        block = mmap(NULL,
+                     length,
+                     PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                     -1,
+                     0);
+        if (block != MAP_FAILED)
+            return (mlt_release) block;
+    }
+#endif
+
+    // Align to a huge page so that the whole block can use them
+    block = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        return NULL;
+    size_t head = (HUGE_PAGE_SIZE - ((uintptr_t) block & (HUGE_PAGE_SIZE - 1))) & (HUGE_PAGE_SIZE - 1);
+    if (head)
+        munmap(block, head);
+    munmap(block + head + length, HUGE_PAGE_SIZE - head);
+    block += head;
+#ifdef MADV_HUGEPAGE
+    madvise(block, length, MADV_HUGEPAGE);
+#endif
+    return (mlt_release) block;
+#else
+    return NULL;
+#endif
+}
+
+/** Free a block that is not in use.
+ *
+ * \private \memberof mlt_pool_s
+ * \param self the pool of the block
+ * \param ptr an opaque pointer
+ */
+
+static void pool_free(mlt_pool self, void *ptr)
+{
+    mlt_release release = (mlt_release) ((char *) ptr - sizeof(struct mlt_release_s));
+#ifdef __linux__
+    if (release->node >= 0)
+        munmap(release, pool_map_size(self->size));
+    else
+#endif
+        mlt_free(release);
+    atomic_fetch_sub_explicit(&self->count, 1, memory_order_relaxed);
+}
+
+/** Return the blocks cached by a thread to their pools.
+ *
+ * This is the destructor of the thread-specific cache.
+ * \private \memberof mlt_pool_s
+ * \param cache the thread's cache
+ */
+
+static void pool_cache_close(void *cache)
+{
+    pool_cache *self = cache;
+    int i, j;
+
+    for (i = 0; i < POOL_CLASSES; i++) {
+        pool_magazine *magazine = &self->magazines[i];
+        if (magazine->count) {
+            pthread_mutex_lock(&pools[i].lock);
+            for (j = 0; j < magazine->count; j++)
+                mlt_deque_push_back(pools[i].stack, magazine->items[j]);
+            pthread_mutex_unlock(&pools[i].lock);
+        }
+        free(magazine->items);
+    }
+    if (self == thread_cache)
+        thread_cache = NULL;
+    free(self);
+}
+
+/** Initialise the pools once per process.
+ *
+ * \private \memberof mlt_pool_s
+ */
+
+static void pools_init()
+{
+    int i, j;
+
+    pthread_key_create(&cache_key, pool_cache_close);
 
-        // Assign the size
-        self->size = size;
+    // Powers of two up to POOL_FINE_SHIFT, then POOL_STEPS per power of two
+    for (i = 0; i <= POOL_FINE_SHIFT - POOL_MIN_SHIFT; i++)
+        pools[i].size = 1 << (POOL_MIN_SHIFT + i);
+    for (j = 0; i < POOL_CLASSES; i++, j++) {
+        int step = 1 << (POOL_FINE_SHIFT + j / POOL_STEPS) >> 3;
+        pools[i].size = (1 << (POOL_FINE_SHIFT + j / POOL_STEPS)) + (j % POOL_STEPS + 1) * step;
     }
 
-    // Return it
-    return self;
+    for (i = 0; i < POOL_CLASSES; i++) {
+        mlt_pool self = &pools[i];
+        pthread_mutex_init(&self->lock, NULL);
+        self->stack = mlt_deque_init();
+        self->magazine = MAGAZINE_BYTES / self->size;
+        if (self->magazine > MAGAZINE_MAX)
+            self->magazine = MAGAZINE_MAX;
+    }
+
+    pool_large_config();
+}
+
+/** Get the calling thread's cache of free blocks.
+ *
+ * \private \memberof mlt_pool_s
+ * \return the cache or NULL if out of memory
+ */
+
+static inline pool_cache *pool_cache_get()
+{
+    if (!thread_cache) {
+        pthread_once(&pools_once, pools_init);
+        thread_cache = calloc(1, sizeof(pool_cache));
+        pthread_setspecific(cache_key, thread_cache);
+    }
+    return thread_cache;
 }
 
 /** Get an item from the pool.
@@ -138,53 +440,81 @@ static mlt_pool pool_init(int size)
 
 static void *pool_fetch(mlt_pool self)
 {
-    // We will generate a release object
+    pool_large_mode_e mode = pool_large_mode(self->size);
+    pool_cache *cache = mode == large_heap ? pool_cache_get() : NULL;
+    pool_magazine *magazine = cache ? &cache->magazines[self - pools] : NULL;
+    int node = mode == large_heap ? -1 : pool_node();
     void *ptr = NULL;
 
-    // Sanity check
-    if (self != NULL) {
-        // Lock the pool
+    if (node >= 0) {
+        // Mapped blocks bypass the thread caches to stay on their node
         pthread_mutex_lock(&self->lock);
-
-        // Check if the stack is empty
-        if (mlt_deque_count(self->stack) != 0) {
-            // Pop the top of the stack
+        if (self->nodes[node])
+            ptr = mlt_deque_pop_back(self->nodes[node]);
+        pthread_mutex_unlock(&self->lock);
+    } else if (!magazine || !magazine->count) {
+        // Refill the thread's magazine from the pool, or take one block
+        pthread_mutex_lock(&self->lock);
+        if (magazine && self->magazine > 1 && mlt_deque_count(self->stack) > 1) {
+            if (!magazine->items)
+                magazine->items = malloc(self->magazine * sizeof(void *));
+            while (magazine->items && magazine->count < self->magazine / 2
+                   && mlt_deque_count(self->stack))
+                magazine->items[magazine->count++] = mlt_deque_pop_back(self->stack);
+        }
+        if (!magazine || !magazine->count)
             ptr = mlt_deque_pop_back(self->stack);
+        pthread_mutex_unlock(&self->lock);
+    }
+    if (!ptr && magazine && magazine->count)
+        ptr = magazine->items[--magazine->count];
 
-            // Assign the reference
-            ((mlt_release) ptr)->references = 1;
-        } else {
-            // We need to generate a release item
-            mlt_release release = mlt_alloc(self->size);
-
-            // If out of memory, log it, reclaim memory, and try again.
-            if (!release && self->size > 0) {
-                mlt_log_fatal(NULL, "[mlt_pool] out of memory\n");
-                mlt_pool_purge();
-                release = mlt_alloc(self->size);
-            }
-
-            // Initialise it
-            if (release != NULL) {
-                // Increment the number of items allocated to this pool
-                self->count++;
+    if (ptr != NULL) {
+        atomic_fetch_add_explicit(&self->hits, 1, memory_order_relaxed);
+    } else {
+        // We need to generate a release item
+        mlt_release release = node >= 0 ? pool_map(self->size, mode) : NULL;
+        if (release == NULL) {
+            node = -1;
+            release = mlt_alloc(self->size);
+        }
 
-                // Assign the pool
-                release->pool = self;
+        // If out of memory, log it, reclaim memory, and try again.
+        if (!release && self->size > 0) {
+            mlt_log_fatal(NULL, "[mlt_pool] out of memory\n");
+            mlt_pool_purge();
+            mlt_pool_purge();
+            release = mlt_alloc(self->size);
+        }
+        if (release == NULL)
+            return NULL;
 
-                // Assign the reference
-                release->references = 1;
+        // Increment the number of items allocated to this pool
+        atomic_fetch_add_explicit(&self->count, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&self->misses, 1, memory_order_relaxed);
 
-                // Determine the ptr
-                ptr = (char *) release + sizeof(struct mlt_release_s);
-            }
-        }
+        // Assign the pool
+        release->pool = self;
+        release->node = node;
 
-        // Unlock the pool
-        pthread_mutex_unlock(&self->lock);
+        // Determine the ptr
+        ptr = (char *) release + sizeof(struct mlt_release_s);
     }
 
-    // Return the generated release object
+    // Assign the reference
+    ((mlt_release) ((char *) ptr - sizeof(struct mlt_release_s)))->references = 1;
+
+    // Track the most blocks in use for trimming
+    int used = atomic_fetch_add_explicit(&self->used, 1, memory_order_relaxed) + 1;
+    int high_water = atomic_load_explicit(&self->high_water, memory_order_relaxed);
+    while (used > high_water
+           && !atomic_compare_exchange_weak_explicit(&self->high_water,
+                                                     &high_water,
+                                                     used,
+                                                     memory_order_relaxed,
+                                                     memory_order_relaxed))
+        ;
+
     return ptr;
 }
 
@@ -205,13 +535,40 @@ static void pool_return(void *ptr)
         mlt_pool self = that->pool;
 
         if (self != NULL) {
-            // Lock the pool
-            pthread_mutex_lock(&self->lock);
+            atomic_fetch_sub_explicit(&self->used, 1, memory_order_relaxed);
+
+            // Mapped blocks go back to the node on which they were allocated
+            if (that->node >= 0) {
+                pthread_mutex_lock(&self->lock);
+                if (!self->nodes[that->node])
+                    self->nodes[that->node] = mlt_deque_init();
+                mlt_deque_push_back(self->nodes[that->node], ptr);
+                pthread_mutex_unlock(&self->lock);
+                return;
+            }
+
+            pool_cache *cache = pool_cache_get();
+            pool_magazine *magazine = cache ? &cache->magazines[self - pools] : NULL;
+
+            if (magazine && self->magazine > 0) {
+                if (!magazine->items)
+                    magazine->items = malloc(self->magazine * sizeof(void *));
+                if (magazine->items) {
+                    // Move half of a full magazine to the pool
+                    if (magazine->count == self->magazine) {
+                        pthread_mutex_lock(&self->lock);
+                        while (magazine->count > self->magazine / 2)
+                            mlt_deque_push_back(self->stack, magazine->items[--magazine->count]);
+                        pthread_mutex_unlock(&self->lock);
+                    }
+                    magazine->items[magazine->count++] = ptr;
+                    return;
+                }
+            }
 
             // Push the that back back on to the stack
+            pthread_mutex_lock(&self->lock);
             mlt_deque_push_back(self->stack, ptr);
-
-            // Unlock the pool
             pthread_mutex_unlock(&self->lock);
 
             return;
@@ -222,62 +579,17 @@ static void pool_return(void *ptr)
     }
 }
 
-/** Destroy a pool.
- *
- * \private \memberof mlt_pool_s
- * \param self a pool
- */
-
-static void pool_close(mlt_pool self)
-{
-    if (self != NULL) {
-        // We need to free up all items in the pool
-        void *release = NULL;
-
-        // Iterate through the stack until depleted
-        while ((release = mlt_deque_pop_back(self->stack)) != NULL) {
-            // We'll free this item now
-            mlt_free((char *) release - sizeof(struct mlt_release_s));
-        }
-
-        // We can now close the stack
-        mlt_deque_close(self->stack);
-
-        // Destroy the mutex
-        pthread_mutex_destroy(&self->lock);
-
-        // Close the pool
-        free(self);
-    }
-}
-
 /** Initialise the global pool.
  *
+ * This also reads MLT_POOL_HUGE_PAGES and MLT_POOL_HUGE_PAGES_THRESHOLD from
+ * the global properties, so call it again after changing them.
  * \public \memberof mlt_pool_s
  */
 
 void mlt_pool_init()
 {
-    // Loop variable used to create the pools
-    int i = 0;
-
-    // Create the pools
-    pools = mlt_properties_new();
-
-    // Create the pools
-    for (i = 8; i < 31; i++) {
-        // Each properties item needs a name
-        char name[32];
-
-        // Construct a pool
-        mlt_pool pool = pool_init(1 << i);
-
-        // Generate a name
-        sprintf(name, "%d", i);
-
-        // Register with properties
-        mlt_properties_set_data(pools, name, pool, 0, (mlt_destructor) pool_close, NULL);
-    }
+    pthread_once(&pools_once, pools_init);
+    pool_large_config();
 }
 
 /** Allocate size bytes from the pool.
@@ -288,22 +600,13 @@ void mlt_pool_init()
 
 void *mlt_pool_alloc(int size)
 {
-    // This will be used to obtain the pool to use
-    mlt_pool pool = NULL;
-
-    // Determines the index of the pool to use
-    int index = 8;
-
     // Minimum size pooled is 256 bytes
-    size += sizeof(struct mlt_release_s);
-    while ((1 << index) < size)
-        index++;
+    int index = pool_index(size + sizeof(struct mlt_release_s));
 
-    // Now get the pool at the index
-    pool = mlt_properties_get_data_at(pools, index - 8, NULL);
+    pthread_once(&pools_once, pools_init);
 
     // Now get the real item
-    return pool_fetch(pool);
+    return index >= 0 ? pool_fetch(&pools[index]) : NULL;
 }
 
 /** Allocate size bytes from the pool.
@@ -345,32 +648,51 @@ void *mlt_pool_realloc(void *ptr, int size)
     return result;
 }
 
-/** Purge unused items in the pool.
+/** Trim unused items in the pool.
  *
- * A form of garbage collection.
+ * A form of garbage collection. Each size class keeps enough free blocks to
+ * go back to the most blocks it had in use since the previous call and frees
+ * the rest, so calling this twice without activity in between frees all of
+ * the unused blocks. Blocks cached by other threads are not affected.
  * \public \memberof mlt_pool_s
  */
 
 void mlt_pool_purge()
 {
-    int i = 0;
+    int i = 0, j;
 
-    // For each pool
-    for (i = 0; i < mlt_properties_count(pools); i++) {
-        // Get the pool
-        mlt_pool self = mlt_properties_get_data_at(pools, i, NULL);
+    pthread_once(&pools_once, pools_init);
+
+    // Give the calling thread's blocks back first
+    if (thread_cache) {
+        pthread_setspecific(cache_key, NULL);
+        pool_cache_close(thread_cache);
+    }
 
-        // Pointer to unused memory
-        void *release = NULL;
+    // For each pool
+    for (i = 0; i < POOL_CLASSES; i++) {
+        mlt_pool self = &pools[i];
 
         // Lock the pool
         pthread_mutex_lock(&self->lock);
 
-        // We'll free all unused items now
-        while ((release = mlt_deque_pop_back(self->stack)) != NULL) {
-            mlt_free((char *) release - sizeof(struct mlt_release_s));
-            self->count--;
+        // Free the blocks above the high water mark
+        int used = atomic_load_explicit(&self->used, memory_order_relaxed);
+        int excess = atomic_load_explicit(&self->count, memory_order_relaxed)
+                     - atomic_load_explicit(&self->high_water, memory_order_relaxed);
+        while (excess > 0 && mlt_deque_count(self->stack)) {
+            pool_free(self, mlt_deque_pop_back(self->stack));
+            excess--;
         }
+        for (j = 0; j < POOL_NODES; j++) {
+            while (excess > 0 && self->nodes[j] && mlt_deque_count(self->nodes[j])) {
+                pool_free(self, mlt_deque_pop_back(self->nodes[j]));
+                excess--;
+            }
+        }
+
+        // Start a new period
+        atomic_store_explicit(&self->high_water, used, memory_order_relaxed);
 
         // Unlock the pool
         pthread_mutex_unlock(&self->lock);
@@ -391,41 +713,78 @@ void mlt_pool_release(void *release)
 
 /** Close the pool.
  *
+ * This frees all of the unused blocks except those cached by other threads,
+ * which are returned to the pool when the threads exit.
  * \public \memberof mlt_pool_s
  */
 
 void mlt_pool_close()
 {
+    int i, j;
+
 #ifdef _MLT_POOL_CHECKS_
     mlt_pool_stat();
 #endif
 
-    // Close the properties
-    mlt_properties_close(pools);
+    pthread_once(&pools_once, pools_init);
+
+    if (thread_cache) {
+        pthread_setspecific(cache_key, NULL);
+        pool_cache_close(thread_cache);
+    }
+
+    // We need to free up all items in the pools
+    for (i = 0; i < POOL_CLASSES; i++) {
+        mlt_pool self = &pools[i];
+        pthread_mutex_lock(&self->lock);
+        while (mlt_deque_count(self->stack))
+            pool_free(self, mlt_deque_pop_back(self->stack));
+        for (j = 0; j < POOL_NODES; j++) {
+            while (self->nodes[j] && mlt_deque_count(self->nodes[j]))
+                pool_free(self, mlt_deque_pop_back(self->nodes[j]));
+        }
+        atomic_store_explicit(&self->high_water, 0, memory_order_relaxed);
+        pthread_mutex_unlock(&self->lock);
+    }
 }
 
+/** Log the usage of the pool.
+ *
+ * For each size class in use this reports the bytes in use, the bytes cached
+ * for reuse and the rate at which allocations are served from the cache.
+ * \public \memberof mlt_pool_s
+ */
+
 void mlt_pool_stat()
 {
     // Stats dump
     uint64_t allocated = 0, used = 0, s;
-    int i = 0, c = mlt_properties_count(pools);
+    int i = 0;
+
+    pthread_once(&pools_once, pools_init);
 
-    mlt_log(NULL, MLT_LOG_VERBOSE, "%s: count %d\n", __FUNCTION__, c);
+    mlt_log(NULL, MLT_LOG_VERBOSE, "%s: count %d\n", __FUNCTION__, POOL_CLASSES);
 
-    for (i = 0; i < c; i++) {
-        mlt_pool pool = mlt_properties_get_data_at(pools, i, NULL);
-        if (pool->count)
+    for (i = 0; i < POOL_CLASSES; i++) {
+        mlt_pool pool = &pools[i];
+        int count = atomic_load_explicit(&pool->count, memory_order_relaxed);
+        int in_use = atomic_load_explicit(&pool->used, memory_order_relaxed);
+        uint64_t hits = atomic_load_explicit(&pool->hits, memory_order_relaxed);
+        uint64_t misses = atomic_load_explicit(&pool->misses, memory_order_relaxed);
+        if (count)
             mlt_log_verbose(NULL,
-                            "%s: size %d allocated %d returned %d %c\n",
+                            "%s: size %d in use %" PRIu64 " bytes cached %" PRIu64
+                            " bytes hit rate %.1f%% %c\n",
                             __FUNCTION__,
                             pool->size,
-                            pool->count,
-                            mlt_deque_count(pool->stack),
-                            pool->count != mlt_deque_count(pool->stack) ? '*' : ' ');
+                            (uint64_t) in_use * pool->size,
+                            (uint64_t) (count - in_use) * pool->size,
+                            hits + misses ? 100.0 * hits / (hits + misses) : 0.0,
+                            in_use ? '*' : ' ');
         s = pool->size;
-        s *= pool->count;
+        s *= count;
         allocated += s;
-        s = pool->count - mlt_deque_count(pool->stack);
+        s = in_use;
         s *= pool->size;
         used += s;
     }
@@ -38,6 +38,8 @@
 #include <locale.h>
 #include <pthread.h>
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -46,15 +48,65 @@
 
 #define MAX_LOAD_LINE_SIZE 4096
 
-/** \brief private implementation of the property list */
+/** \brief the lookup table and storage of a property list
+ *
+ * The table is an open-addressing hash table with linear probing whose slots
+ * hold an index into name/value plus one, zero meaning empty. It has twice as
+ * many slots as entries, a power of two.
+ *
+ * Readers look up properties without the lock. Writers append to an index in
+ * place, publishing the slot last, but growing or renaming builds a new index.
+ * The replaced index is retired rather than freed because a reader may still
+ * be probing it. \p retired_epoch records the ::index_epoch at which that
+ * happened, and the index is freed once every reader has moved past it.
+ */
+
+typedef struct property_index_s
+{
+    struct property_index_s *retired;
+    unsigned int retired_epoch;
+    char *retired_name;
+    unsigned int retired_hash;
+    unsigned int mask;
+    int size;
+    char **name;
+    mlt_property *value;
+    unsigned int *name_hash;
+    atomic_uint slots[];
+} property_index;
+
+/** \brief a chunk of memory from which the strings of a property list are allocated
+ *
+ * Allocation bumps \p used atomically, so it does not need the lock. Nothing
+ * is freed individually; chunks are rewound by mlt_properties_reset().
+ */
+
+typedef struct property_arena_s
+{
+    struct property_arena_s *next;
+    atomic_size_t used;
+    size_t size;
+    char data[];
+} property_arena;
+
+/** \brief private implementation of the property list
+ *
+ * Names are interned (see ::interned_name) so that the same name stored in
+ * two lists is the same pointer. \p name and \p value alias the arrays of the
+ * current ::property_index. \p blocks counts the blocks of properties
+ * allocated, which may be more than \p count needs after a reset.
+ */
 
 typedef struct
 {
-    int hash[199];
+    _Atomic(property_index *) index;
     char **name;
     mlt_property *value;
     int count;
     int size;
+    int blocks;
+    _Atomic(property_arena *) arena;
+    int arena_size;
     mlt_properties mirror;
     int ref_count;
     pthread_mutex_t mutex;
@@ -64,6 +116,57 @@ typedef struct
     int children_count;
 } property_list;
 
+/** \brief a reference counted property name shared by all property lists */
+
+typedef struct interned_name_s
+{
+    struct interned_name_s *next;
+    unsigned int hash;
+    int ref_count;
+    char name[];
+} interned_name;
+
+/** \brief one lock domain of the process-wide interned name table */
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    interned_name **buckets;
+    unsigned int mask;
+    unsigned int count;
+} intern_shard;
+
+#define INTERN_SHARDS 64
+#define INTERN_INITIAL_BUCKETS 64
+#define PROPERTIES_INITIAL_SIZE 16
+#define PROPERTIES_BLOCK_SIZE 8
+
+/** \brief the announcement of a thread that reads property indexes without the lock
+ *
+ * Each thread owns one record, so announcing a read writes no memory shared
+ * with other readers. \p epoch is the ::index_epoch seen when the outermost
+ * read started, or zero while the thread is not reading. Records are never
+ * freed; the record of a finished thread is reused by the next new one.
+ */
+
+typedef struct index_reader_s
+{
+    struct index_reader_s *next;
+    atomic_uint epoch;
+    atomic_int in_use;
+    char padding[64 - sizeof(void *) - sizeof(atomic_uint) - sizeof(atomic_int)];
+} index_reader;
+
+static intern_shard intern_shards[INTERN_SHARDS];
+static pthread_once_t intern_once = PTHREAD_ONCE_INIT;
+
+/** the epoch of property index retirement, always odd so that it is never zero */
+static atomic_uint index_epoch = 1;
+static _Atomic(index_reader *) index_readers = NULL;
+static pthread_once_t index_readers_once = PTHREAD_ONCE_INIT;
+static pthread_key_t index_reader_key;
+static _Thread_local index_reader *thread_reader = NULL;
+
 /* Memory leak checks */
 
 //#define _MLT_PROPERTY_CHECKS_ 2
@@ -321,12 +424,308 @@ int mlt_properties_preset(mlt_properties self, const char *name)
  * \return an integer
  */
 
-static inline int generate_hash(const char *name)
+static inline unsigned int generate_hash(const char *name)
 {
     unsigned int hash = 5381;
     while (*name)
         hash = hash * 33 + (unsigned int) (*name++);
-    return hash % 199;
+    // Mix the high bits down since the tables index by the low bits.
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3b;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+static void intern_init()
+{
+    int i;
+    for (i = 0; i < INTERN_SHARDS; i++)
+        pthread_mutex_init(&intern_shards[i].mutex, NULL);
+}
+
+/** Get the shared copy of a property name, adding it if needed.
+ *
+ * Release the result with intern_release().
+ * \private \memberof mlt_properties_s
+ * \param name a property name
+ * \param hash the value of generate_hash() for \p name
+ * \return a string that is pointer-comparable with other interned names
+ */
+
+static char *intern_acquire(const char *name, unsigned int hash)
+{
+    intern_shard *shard = &intern_shards[hash % INTERN_SHARDS];
+    interned_name *entry;
+
+    pthread_once(&intern_once, intern_init);
+    pthread_mutex_lock(&shard->mutex);
+
+    if (shard->buckets) {
+        for (entry = shard->buckets[(hash / INTERN_SHARDS) & shard->mask]; entry;
+             entry = entry->next) {
+            if (entry->hash == hash && !strcmp(entry->name, name)) {
+                entry->ref_count++;
+                pthread_mutex_unlock(&shard->mutex);
+                return entry->name;
+            }
+        }
+    }
+
+    // Grow the buckets when the chains get longer than one on average
+    if (shard->buckets == NULL || shard->count > shard->mask) {
+        unsigned int size = shard->buckets ? (shard->mask + 1) * 2 : INTERN_INITIAL_BUCKETS;
+        interned_name **buckets = calloc(size, sizeof(interned_name *));
+        unsigned int i;
+        if (shard->buckets) {
+            for (i = 0; i <= shard->mask; i++) {
+                while ((entry = shard->buckets[i])) {
+                    shard->buckets[i] = entry->next;
+                    entry->next = buckets[(entry->hash / INTERN_SHARDS) & (size - 1)];
+                    buckets[(entry->hash / INTERN_SHARDS) & (size - 1)] = entry;
+                }
+            }
+            free(shard->buckets);
+        }
+        shard->buckets = buckets;
+        shard->mask = size - 1;
+    }
+
+    size_t length = strlen(name) + 1;
+    entry = malloc(sizeof(interned_name) + length);
+    entry->hash = hash;
+    entry->ref_count = 1;
+    memcpy(entry->name, name, length);
+    entry->next = shard->buckets[(hash / INTERN_SHARDS) & shard->mask];
+    shard->buckets[(hash / INTERN_SHARDS) & shard->mask] = entry;
+    shard->count++;
+
+    pthread_mutex_unlock(&shard->mutex);
+    return entry->name;
+}
+
+/** Release a name obtained from intern_acquire().
+ *
+ * \private \memberof mlt_properties_s
+ * \param name an interned property name
+ * \param hash the value of generate_hash() for \p name
+ */
+
+static void intern_release(char *name, unsigned int hash)
+{
+    intern_shard *shard = &intern_shards[hash % INTERN_SHARDS];
+    interned_name *entry = (interned_name *) (name - offsetof(interned_name, name));
+
+    pthread_mutex_lock(&shard->mutex);
+    if (--entry->ref_count == 0) {
+        interned_name **link = &shard->buckets[(hash / INTERN_SHARDS) & shard->mask];
+        while (*link != entry)
+            link = &(*link)->next;
+        *link = entry->next;
+        shard->count--;
+        free(entry);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+/** Allocate a new index for a property list holding a copy of its entries.
+ *
+ * The caller must hold the properties lock.
+ * \private \memberof mlt_properties_s
+ * \param list a property list
+ * \param size the number of entries, a power of two not less than the count
+ * \return the new index, not yet visible to readers
+ */
+
+static property_index *properties_index_copy(property_list *list, int size)
+{
+    property_index *old = atomic_load_explicit(&list->index, memory_order_relaxed);
+    unsigned int slots = size * 2;
+    property_index *index = calloc(1,
+                                   sizeof(property_index) + slots * sizeof(atomic_uint)
+                                       + size * (sizeof(char *) + sizeof(mlt_property))
+                                       + size * sizeof(unsigned int));
+
+    index->mask = slots - 1;
+    index->size = size;
+    index->name = (char **) &index->slots[slots];
+    index->value = (mlt_property *) &index->name[size];
+    index->name_hash = (unsigned int *) &index->value[size];
+    if (old) {
+        // Include the unused properties of the allocated blocks
+        memcpy(index->name, old->name, list->count * sizeof(char *));
+        memcpy(index->value,
+               old->value,
+               list->blocks * PROPERTIES_BLOCK_SIZE * sizeof(mlt_property));
+        memcpy(index->name_hash, old->name_hash, list->count * sizeof(unsigned int));
+    }
+    return index;
+}
+
+/** Free the retired indexes that no reader can still be probing.
+ *
+ * A reader that may have seen an index announced an epoch no later than the
+ * one at which it was retired, so the indexes retired before the oldest
+ * announced epoch are safe to free. The chain is ordered newest first.
+ * \private \memberof mlt_properties_s
+ * \param index an index whose retired indexes to free
+ */
+
+static void properties_index_free_retired(property_index *index)
+{
+    property_index **link = &index->retired;
+    unsigned int oldest = 0;
+    index_reader *reader;
+
+    for (reader = atomic_load(&index_readers); reader; reader = reader->next) {
+        unsigned int epoch = atomic_load(&reader->epoch);
+        if (epoch && (!oldest || (int) (epoch - oldest) < 0))
+            oldest = epoch;
+    }
+    if (oldest)
+        while (*link && (int) ((*link)->retired_epoch - oldest) >= 0)
+            link = &(*link)->retired;
+
+    property_index *retired = *link;
+    *link = NULL;
+    while (retired) {
+        property_index *next = retired->retired;
+        if (retired->retired_name)
+            intern_release(retired->retired_name, retired->retired_hash);
+        free(retired);
+        retired = next;
+    }
+}
+
+/** Fill the slots of a new index and make it the current one.
+ *
+ * The caller must hold the properties lock.
+ * \private \memberof mlt_properties_s
+ * \param list a property list
+ * \param index an index from properties_index_copy()
+ */
+
+static void properties_index_publish(property_list *list, property_index *index)
+{
+    int i;
+    for (i = 0; i < list->count; i++) {
+        unsigned int slot = index->name_hash[i] & index->mask;
+        while (atomic_load_explicit(&index->slots[slot], memory_order_relaxed))
+            slot = (slot + 1) & index->mask;
+        atomic_store_explicit(&index->slots[slot], i + 1, memory_order_relaxed);
+    }
+    index->retired = atomic_load_explicit(&list->index, memory_order_relaxed);
+    list->name = index->name;
+    list->value = index->value;
+    list->size = index->size;
+    atomic_store(&list->index, index);
+    if (index->retired)
+        index->retired->retired_epoch = atomic_fetch_add(&index_epoch, 2);
+    properties_index_free_retired(index);
+}
+
+/** Release the reader record of a finishing thread.
+ *
+ * \private \memberof mlt_properties_s
+ * \param reader the record of the thread
+ */
+
+static void index_reader_close(void *reader)
+{
+    thread_reader = NULL;
+    atomic_store(&((index_reader *) reader)->in_use, 0);
+}
+
+/** Initialise the thread key of the reader records once per process.
+ *
+ * \private \memberof mlt_properties_s
+ */
+
+static void index_readers_init()
+{
+    pthread_key_create(&index_reader_key, index_reader_close);
+}
+
+/** Claim a reader record for the calling thread.
+ *
+ * \private \memberof mlt_properties_s
+ * \return the record of the thread
+ */
+
+static index_reader *index_reader_register()
+{
+    index_reader *reader;
+
+    pthread_once(&index_readers_once, index_readers_init);
+    for (reader = atomic_load(&index_readers); reader; reader = reader->next) {
+        int unused = 0;
+        if (atomic_compare_exchange_strong(&reader->in_use, &unused, 1))
+            break;
+    }
+    if (!reader) {
+        reader = calloc(1, sizeof(index_reader));
+        atomic_init(&reader->in_use, 1);
+        reader->next = atomic_load(&index_readers);
+        while (!atomic_compare_exchange_weak(&index_readers, &reader->next, reader))
+            ;
+    }
+    pthread_setspecific(index_reader_key, reader);
+    thread_reader = reader;
+    return reader;
+}
+
+/** Start reading the current index without the lock.
+ *
+ * The thread announces the current epoch in its own record before loading the
+ * index, which keeps the indexes retired from then on from being freed.
+ * Reads do not nest.
+ * \private \memberof mlt_properties_s
+ * \param list a property list
+ * \param[out] reader the record of the thread to pass to properties_index_release()
+ * \return the current index
+ */
+
+static inline property_index *properties_index_acquire(property_list *list, index_reader **reader)
+{
+    *reader = thread_reader ? thread_reader : index_reader_register();
+    atomic_store(&(*reader)->epoch, atomic_load_explicit(&index_epoch, memory_order_acquire));
+    return atomic_load(&list->index);
+}
+
+/** Stop reading an index.
+ *
+ * \private \memberof mlt_properties_s
+ * \param reader the record from properties_index_acquire()
+ */
+
+static inline void properties_index_release(index_reader *reader)
+{
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+/** Locate the index of a property by name.
+ *
+ * This is safe to call without holding the properties lock.
+ * \private \memberof mlt_properties_s
+ * \param index a property index
+ * \param name the property name
+ * \param hash the value of generate_hash() for \p name
+ * \return the index or -1 if not found
+ */
+
+static inline int properties_lookup(property_index *index, const char *name, unsigned int hash)
+{
+    if (index) {
+        unsigned int slot = hash & index->mask;
+        unsigned int i;
+        while ((i = atomic_load_explicit(&index->slots[slot], memory_order_acquire))) {
+            i--;
+            if (index->name_hash[i] == hash
+                && (index->name[i] == name || !strcmp(index->name[i], name)))
+                return i;
+            slot = (slot + 1) & index->mask;
+        }
+    }
+    return -1;
 }
 
 /** Copy a serializable property to a properties list that is mirroring this one.
@@ -536,29 +935,18 @@ static inline mlt_property mlt_properties_find(mlt_properties self, const char *
     if (!self || !name)
         return NULL;
     property_list *list = self->local;
-    mlt_property value = NULL;
-    int key = generate_hash(name);
-
-    mlt_properties_lock(self);
-
-    int i = list->hash[key] - 1;
-    if (i >= 0) {
-        // Check if we're hashed
-        if (list->count > 0 && list->name[i] && !strcmp(list->name[i], name))
-            value = list->value[i];
-
-        // Locate the item
-        for (i = list->count - 1; value == NULL && i >= 0; i--)
-            if (list->name[i] && !strcmp(list->name[i], name))
-                value = list->value[i];
-    }
-    mlt_properties_unlock(self);
-
-    return value;
+    index_reader *reader;
+    property_index *index = properties_index_acquire(list, &reader);
+    int i = properties_lookup(index, name, generate_hash(name));
+    mlt_property result = i >= 0 ? index->value[i] : NULL;
+    properties_index_release(reader);
+    return result;
 }
 
 /** Add a new property.
  *
+ * If another thread added the same name since it was looked up, that property
+ * is returned instead.
  * \private \memberof mlt_properties_s
  * \param self a properties list
  * \param name the name of the new property
@@ -568,28 +956,41 @@ static inline mlt_property mlt_properties_find(mlt_properties self, const char *
 static mlt_property mlt_properties_add(mlt_properties self, const char *name)
 {
     property_list *list = self->local;
-    int key = generate_hash(name);
+    unsigned int hash = generate_hash(name);
     mlt_property result;
 
     mlt_properties_lock(self);
 
+    property_index *index = atomic_load_explicit(&list->index, memory_order_relaxed);
+    int i = properties_lookup(index, name, hash);
+    if (i >= 0) {
+        result = index->value[i];
+        mlt_properties_unlock(self);
+        return result;
+    }
+
     // Check that we have space and resize if necessary
     if (list->count == list->size) {
-        list->size += 50;
-        list->name = realloc(list->name, list->size * sizeof(const char *));
-        list->value = realloc(list->value, list->size * sizeof(mlt_property));
+        index = properties_index_copy(list, list->size ? list->size * 2 : PROPERTIES_INITIAL_SIZE);
+        properties_index_publish(list, index);
     }
 
-    // Assign name/value pair
-    list->name[list->count] = strdup(name);
-    list->value[list->count] = mlt_property_init();
+    // Properties are allocated a block at a time
+    if (list->count == list->blocks * PROPERTIES_BLOCK_SIZE) {
+        mlt_property_init_bulk(&index->value[list->count], PROPERTIES_BLOCK_SIZE);
+        list->blocks++;
+    }
 
-    // Assign to hash table
-    if (list->hash[key] == 0)
-        list->hash[key] = list->count + 1;
+    // Assign name/value pair
+    index->name[list->count] = intern_acquire(name, hash);
+    index->name_hash[list->count] = hash;
+    result = index->value[list->count++];
 
-    // Return and increment count accordingly
-    result = list->value[list->count++];
+    // Publish it to readers
+    unsigned int slot = hash & index->mask;
+    while (atomic_load_explicit(&index->slots[slot], memory_order_relaxed))
+        slot = (slot + 1) & index->mask;
+    atomic_store_explicit(&index->slots[slot], list->count, memory_order_release);
 
     mlt_properties_unlock(self);
 
@@ -617,9 +1018,81 @@ static mlt_property mlt_properties_fetch(mlt_properties self, const char *name)
     return property;
 }
 
+/** Copy a string into the arena of a property list.
+ *
+ * This is safe to call without holding the properties lock.
+ * \private \memberof mlt_properties_s
+ * \param list a property list with an arena
+ * \param value the string to copy
+ * \return the copy or NULL if the string is too long for the arena
+ */
+
+static char *properties_arena_strdup(property_list *list, const char *value)
+{
+    size_t length = strlen(value) + 1;
+    size_t size = list->arena_size;
+
+    // Long strings would waste most of a chunk
+    if (length > size / 4)
+        return NULL;
+
+    property_arena *arena = atomic_load_explicit(&list->arena, memory_order_acquire);
+    while (1) {
+        if (arena) {
+            size_t offset = atomic_fetch_add_explicit(&arena->used, length, memory_order_relaxed);
+            if (offset + length <= arena->size) {
+                memcpy(&arena->data[offset], value, length);
+                return &arena->data[offset];
+            }
+        }
+
+        // The chunk is full so start another one
+        property_arena *chunk = malloc(sizeof(property_arena) + size);
+        if (!chunk)
+            return NULL;
+        chunk->next = arena;
+        chunk->size = size;
+        atomic_init(&chunk->used, 0);
+        if (atomic_compare_exchange_strong_explicit(&list->arena,
+                                                    &arena,
+                                                    chunk,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire))
+            arena = chunk;
+        else
+            free(chunk);
+    }
+}
+
+/** Set a property to a copy of a string, using the arena if the list has one.
+ *
+ * \private \memberof mlt_properties_s
+ * \param list a property list
+ * \param property the property to set
+ * \param value the string to copy
+ * \return true if error
+ */
+
+static int properties_set_string(property_list *list, mlt_property property, const char *value)
+{
+    if (value && list->arena_size) {
+        char *copy = properties_arena_strdup(list, value);
+        if (copy)
+            return mlt_property_set_string_nocopy(property, copy);
+    }
+    return mlt_property_set_string(property, value);
+}
+
+static atomic_int property_changed_id = -1;
+
 static void fire_property_changed(mlt_properties self, const char *name)
 {
-    mlt_events_fire(self, "property-changed", mlt_event_data_from_string(name));
+    int id = atomic_load_explicit(&property_changed_id, memory_order_relaxed);
+    if (id < 0) {
+        id = mlt_events_id("property-changed");
+        atomic_store_explicit(&property_changed_id, id, memory_order_relaxed);
+    }
+    mlt_events_fire_id(self, id, mlt_event_data_from_string(name));
 }
 
 /** Copy a property to another properties list.
@@ -738,7 +1211,7 @@ int mlt_properties_set(mlt_properties self, const char *name, const char *value)
     if (property == NULL) {
         mlt_log(NULL, MLT_LOG_FATAL, "Whoops - %s not found (should never occur)\n", name);
     } else if (value == NULL) {
-        error = mlt_property_set_string(property, value);
+        error = properties_set_string(self->local, property, value);
         mlt_properties_do_mirror(self, name);
     } else if (value[0] == '@' && is_valid_expression(self, &value[1])) {
         double total = 0;
@@ -793,7 +1266,7 @@ int mlt_properties_set(mlt_properties self, const char *name, const char *value)
         error = mlt_property_set_double(property, total);
         mlt_properties_do_mirror(self, name);
     } else {
-        error = mlt_property_set_string(property, value);
+        error = properties_set_string(self->local, property, value);
         mlt_properties_do_mirror(self, name);
         if (!strcmp(name, "properties"))
             mlt_properties_preset(self, value);
@@ -851,10 +1324,10 @@ int mlt_properties_set_string(mlt_properties self, const char *name, const char
     if (property == NULL) {
         mlt_log(NULL, MLT_LOG_FATAL, "Whoops - %s not found (should never occur)\n", name);
     } else if (value == NULL) {
-        error = mlt_property_set_string(property, value);
+        error = properties_set_string(self->local, property, value);
         mlt_properties_do_mirror(self, name);
     } else {
-        error = mlt_property_set_string(property, value);
+        error = properties_set_string(self->local, property, value);
         mlt_properties_do_mirror(self, name);
         if (!strcmp(name, "properties"))
             mlt_properties_preset(self, value);
@@ -900,9 +1373,13 @@ char *mlt_properties_get_name(mlt_properties self, int index)
     if (!self)
         return NULL;
     property_list *list = self->local;
-    if (index >= 0 && index < list->count)
-        return list->name[index];
-    return NULL;
+    char *result = NULL;
+    index_reader *reader;
+    property_index *current = properties_index_acquire(list, &reader);
+    if (index >= 0 && index < list->count && current && index < current->size)
+        result = current->name[index];
+    properties_index_release(reader);
+    return result;
 }
 
 /** Get a property's string value by index (with time format).
@@ -920,9 +1397,13 @@ char *mlt_properties_get_value_tf(mlt_properties self, int index, mlt_time_forma
     if (!self)
         return NULL;
     property_list *list = self->local;
-    if (index >= 0 && index < list->count)
-        return mlt_property_get_string_l_tf(list->value[index], list->locale, time_format);
-    return NULL;
+    mlt_property value = NULL;
+    index_reader *reader;
+    property_index *current = properties_index_acquire(list, &reader);
+    if (index >= 0 && index < list->count && current && index < current->size)
+        value = current->value[index];
+    properties_index_release(reader);
+    return value ? mlt_property_get_string_l_tf(value, list->locale, time_format) : NULL;
 }
 
 /** Get a property's string value by index.
@@ -954,9 +1435,13 @@ void *mlt_properties_get_data_at(mlt_properties self, int index, int *size)
     if (!self)
         return NULL;
     property_list *list = self->local;
-    if (index >= 0 && index < list->count)
-        return mlt_property_get_data(list->value[index], size);
-    return NULL;
+    mlt_property value = NULL;
+    index_reader *reader;
+    property_index *current = properties_index_acquire(list, &reader);
+    if (index >= 0 && index < list->count && current && index < current->size)
+        value = current->value[index];
+    properties_index_release(reader);
+    return value ? mlt_property_get_data(value, size) : NULL;
 }
 
 /** Return the number of items in the list.
@@ -1278,17 +1763,20 @@ int mlt_properties_rename(mlt_properties self, const char *source, const char *d
 
     if (value == NULL) {
         property_list *list = self->local;
-        int i = 0;
 
         // Locate the item
         mlt_properties_lock(self);
-        for (i = 0; i < list->count; i++) {
-            if (list->name[i] && !strcmp(list->name[i], source)) {
-                free(list->name[i]);
-                list->name[i] = strdup(dest);
-                list->hash[generate_hash(dest)] = i + 1;
-                break;
-            }
+        property_index *index = atomic_load_explicit(&list->index, memory_order_relaxed);
+        int i = properties_lookup(index, source, generate_hash(source));
+        if (i >= 0) {
+            // Removing from a linear probing table means rebuilding it, and
+            // readers may still be comparing the old name
+            index->retired_name = index->name[i];
+            index->retired_hash = index->name_hash[i];
+            index = properties_index_copy(list, list->size);
+            index->name_hash[i] = generate_hash(dest);
+            index->name[i] = intern_acquire(dest, index->name_hash[i]);
+            properties_index_publish(list, index);
         }
         mlt_properties_unlock(self);
     }
@@ -1412,18 +1900,17 @@ static int mlt_fnmatch(const char *wild, const char *file)
     return strlen(file) == f && strlen(wild) == w;
 }
 
-/** Compare the string or serialized value of two properties.
+/** Compare two strings for qsort().
  *
  * \private \memberof mlt_properties_s
- * \param self a property
- * \param that a property
+ * \param self a pointer to a string
+ * \param that a pointer to a string
  * \return < 0 if \p self less than \p that, 0 if equal, or > 0 if \p self is greater than \p that
  */
 
 static int mlt_compare(const void *self, const void *that)
 {
-    return strcmp(mlt_property_get_string(*(const mlt_property *) self),
-                  mlt_property_get_string(*(const mlt_property *) that));
+    return strcmp(*(char *const *) self, *(char *const *) that);
 }
 
 /** Get the contents of a directory.
@@ -1461,10 +1948,18 @@ int mlt_properties_dir_list(mlt_properties self, const char *dirname, const char
     }
 
     if (sort && mlt_properties_count(self)) {
-        property_list *list = self->local;
-        mlt_properties_lock(self);
-        qsort(list->value, mlt_properties_count(self), sizeof(mlt_property), mlt_compare);
-        mlt_properties_unlock(self);
+        // Sort the values rather than the properties, which are allocated in blocks
+        int count = mlt_properties_count(self);
+        char **values = malloc(count * sizeof(char *));
+        int i;
+        for (i = 0; i < count; i++)
+            values[i] = strdup(mlt_properties_get_value(self, i));
+        qsort(values, count, sizeof(char *), mlt_compare);
+        for (i = 0; i < count; i++) {
+            mlt_properties_set_string(self, mlt_properties_get_name(self, i), values[i]);
+            free(values[i]);
+        }
+        free(values);
     }
 
     return mlt_properties_count(self);
@@ -1503,11 +1998,12 @@ void mlt_properties_close(mlt_properties self)
                     properties_destroyed);
 #endif
 
-            // Clean up names and values
-            for (index = list->count - 1; index >= 0; index--) {
-                mlt_property_close(list->value[index]);
-                free(list->name[index]);
-            }
+            // Clean up names and values, last to first
+            for (index = list->blocks - 1; index >= 0; index--)
+                mlt_property_close_bulk(&list->value[index * PROPERTIES_BLOCK_SIZE],
+                                        PROPERTIES_BLOCK_SIZE);
+            for (index = list->count - 1; index >= 0; index--)
+                intern_release(list->name[index], list->index->name_hash[index]);
 
 #if defined(__GLIBC__) || defined(__APPLE__)
             // Cleanup locale
@@ -1520,8 +2016,20 @@ void mlt_properties_close(mlt_properties self)
 
             // Clear up the list
             pthread_mutex_destroy(&list->mutex);
-            free(list->name);
-            free(list->value);
+            property_index *retired = list->index;
+            while (retired) {
+                property_index *next = retired->retired;
+                if (retired->retired_name)
+                    intern_release(retired->retired_name, retired->retired_hash);
+                free(retired);
+                retired = next;
+            }
+            property_arena *arena = list->arena;
+            while (arena) {
+                property_arena *next = arena->next;
+                free(arena);
+                arena = next;
+            }
             free(list);
 
             // Free self now if self has no child
@@ -1531,6 +2039,81 @@ void mlt_properties_close(mlt_properties self)
     }
 }
 
+/** Back the strings of a properties list with an arena.
+ *
+ * Strings set on the list are copied into chunks of \p size bytes rather than
+ * allocated one at a time, and the memory is only reclaimed when the list is
+ * reset or closed. This suits short-lived lists that are recycled with
+ * mlt_properties_reset(), such as frames.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ * \param size the size of each arena chunk in bytes or 0 to stop using the arena
+ * \return true if error
+ */
+
+int mlt_properties_set_arena(mlt_properties self, int size)
+{
+    if (!self || size < 0)
+        return 1;
+    property_list *list = self->local;
+    list->arena_size = size;
+    return 0;
+}
+
+/** Remove all properties from a properties list while keeping its storage.
+ *
+ * This releases the values as mlt_properties_close() would but keeps the
+ * lookup table, the allocated properties and the first arena chunk for reuse.
+ * The caller must ensure that no other thread is using the list.
+ * \public \memberof mlt_properties_s
+ * \param self a properties list
+ */
+
+void mlt_properties_reset(mlt_properties self)
+{
+    if (!self)
+        return;
+    property_list *list = self->local;
+    property_index *index = list->index;
+    int i;
+
+    for (i = 0; i < list->count; i++)
+        mlt_property_clear(list->value[i]);
+    for (i = list->count - 1; i >= 0; i--)
+        intern_release(list->name[i], index->name_hash[i]);
+    list->count = 0;
+
+    if (index) {
+        memset(index->slots, 0, (index->mask + 1) * sizeof(atomic_uint));
+        properties_index_free_retired(index);
+        if (index->retired_name) {
+            intern_release(index->retired_name, index->retired_hash);
+            index->retired_name = NULL;
+        }
+    }
+
+    property_arena *arena = list->arena;
+    if (arena) {
+        property_arena *next = arena->next;
+        while (next) {
+            property_arena *chunk = next;
+            next = chunk->next;
+            free(chunk);
+        }
+        arena->next = NULL;
+        atomic_store_explicit(&arena->used, 0, memory_order_relaxed);
+    }
+
+    list->mirror = NULL;
+#if defined(__GLIBC__) || defined(__APPLE__)
+    if (list->locale)
+        freelocale(list->locale);
+#else
+    free(list->locale);
+#endif
+    list->locale = NULL;
+}
+
 /** Determine if the properties list is really just a sequence or ordered list.
  *
  * \public \memberof mlt_properties_s
@@ -2850,9 +3433,13 @@ mlt_properties mlt_properties_get_properties_at(mlt_properties self, int index)
     if (!self)
         return NULL;
     property_list *list = self->local;
-    if (index >= 0 && index < list->count)
-        return mlt_property_get_properties(list->value[index]);
-    return NULL;
+    mlt_property value = NULL;
+    index_reader *reader;
+    property_index *current = properties_index_acquire(list, &reader);
+    if (index >= 0 && index < list->count && current && index < current->size)
+        value = current->value[index];
+    properties_index_release(reader);
+    return value ? mlt_property_get_properties(value) : NULL;
 }
 
 /** Check if a property is animated.
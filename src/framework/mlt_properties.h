@@ -91,6 +91,8 @@ extern void mlt_properties_debug(mlt_properties self, const char *title, FILE *o
 extern int mlt_properties_save(mlt_properties, const char *);
 extern int mlt_properties_dir_list(mlt_properties, const char *, const char *, int);
 extern void mlt_properties_close(mlt_properties self);
+extern int mlt_properties_set_arena(mlt_properties self, int size);
+extern void mlt_properties_reset(mlt_properties self);
 extern int mlt_properties_is_sequence(mlt_properties self);
 extern mlt_properties mlt_properties_parse_yaml(const char *file);
 extern char *mlt_properties_serialise_yaml(mlt_properties self);
@@ -33,6 +33,8 @@
 #include <locale.h>
 #include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -49,9 +51,24 @@ typedef enum {
     mlt_prop_data = 16,    //!< set as opaque binary
     mlt_prop_int64 = 32,   //!< set as a 64-bit integer
     mlt_prop_rect = 64,    //!< set as a mlt_rect
-    mlt_prop_color = 128   //!< set as a mlt_color
+    mlt_prop_color = 128,  //!< set as a mlt_color
+    mlt_prop_borrowed = 256 //!< the string is not owned by the property
 } mlt_property_type;
 
+/** \brief Rarely used property fields, allocated on first use
+ */
+
+typedef struct
+{
+    mlt_serialiser serialiser;
+    mlt_animation animation;
+    mlt_properties properties;
+    unsigned int generation;       /**< incremented whenever the string is released */
+    unsigned int synced;           /**< the string generation last given to the animation */
+    unsigned int synced_animation; /**< the animation generation after that */
+    int synced_length;             /**< the length last given to the animation */
+} property_extra;
+
 /** \brief Property class
  *
  * A property is like a variant or dynamic type. They are used for many things
@@ -63,40 +80,262 @@ struct mlt_property_s
     /// Stores a bit pattern of types available for this property
     mlt_property_type types;
 
-    /// Atomic type handling
-    int prop_int;
-    mlt_position prop_position;
-    double prop_double;
-    int64_t prop_int64;
+    /// Odd while the property is locked so that readers can skip locking
+    atomic_uint seq;
+
+    /// Atomic type handling, only one of these is in types at a time
+    union
+    {
+        int prop_int;
+        mlt_position prop_position;
+        double prop_double;
+        int64_t prop_int64;
+    };
 
     /// String handling
     char *prop_string;
 
     /// Generic type handling
     void *data;
-    int length;
     mlt_destructor destructor;
-    mlt_serialiser serialiser;
+    int length;
 
-    pthread_mutex_t mutex;
-    mlt_animation animation;
-    mlt_properties properties;
+    /// The lock recursion count, its blocked waiters and its owner, see property_lock()
+    int lock_depth;
+    atomic_int waiters;
+    _Atomic(void *) owner;
+
+    property_extra *extra;
 };
 
+/** \brief where threads block on a property lock held for long
+ *
+ * Properties hash to one of a few stripes, so a property needs no mutex of its
+ * own.
+ */
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} lock_stripe;
+
+#define LOCK_STRIPES 64
+#define LOCK_SPINS 100
+
+static lock_stripe lock_stripes[LOCK_STRIPES];
+static pthread_once_t lock_stripes_once = PTHREAD_ONCE_INIT;
+
+/// The address of this is unique to each thread and identifies a lock owner
+static _Thread_local char lock_owner;
+
+/** Initialise the lock stripes once per process.
+ *
+ * \private \memberof mlt_property_s
+ */
+
+static void lock_stripes_init()
+{
+    int i;
+    for (i = 0; i < LOCK_STRIPES; i++) {
+        pthread_mutex_init(&lock_stripes[i].mutex, NULL);
+        pthread_cond_init(&lock_stripes[i].cond, NULL);
+    }
+}
+
+/** Get the lock stripe of a property.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return the stripe on which to wait for the property
+ */
+
+static inline lock_stripe *property_lock_stripe(mlt_property self)
+{
+    pthread_once(&lock_stripes_once, lock_stripes_init);
+    return &lock_stripes[((uintptr_t) self / sizeof(struct mlt_property_s)) % LOCK_STRIPES];
+}
+
+/** Try to take the lock of a property once.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return true if the lock was taken
+ */
+
+static inline int property_trylock(mlt_property self)
+{
+    unsigned int seq = atomic_load_explicit(&self->seq, memory_order_relaxed);
+    return !(seq & 1)
+           && atomic_compare_exchange_strong_explicit(&self->seq,
+                                                      &seq,
+                                                      seq + 1,
+                                                      memory_order_acquire,
+                                                      memory_order_relaxed);
+}
+
+/** Lock a property against concurrent access.
+ *
+ * The lock is recursive. It is held by making the sequence count odd, which
+ * also tells the lock-free readers to retry or fall back to locking, so a
+ * property does not need a mutex. Writers are short except when a destructor
+ * runs, so a thread spins briefly and then blocks on the stripe of the
+ * property until the holder unlocks it.
+ * \private \memberof mlt_property_s
+ * \param self a property
+ */
+
+static inline void property_lock(mlt_property self)
+{
+    if (atomic_load_explicit(&self->owner, memory_order_relaxed) == &lock_owner) {
+        self->lock_depth++;
+        return;
+    }
+    int spins = 0;
+    while (!property_trylock(self)) {
+        if (++spins > LOCK_SPINS) {
+            lock_stripe *stripe = property_lock_stripe(self);
+            pthread_mutex_lock(&stripe->mutex);
+            atomic_fetch_add(&self->waiters, 1);
+            while (!property_trylock(self))
+                pthread_cond_wait(&stripe->cond, &stripe->mutex);
+            atomic_fetch_sub(&self->waiters, 1);
+            pthread_mutex_unlock(&stripe->mutex);
+            break;
+        }
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&self->owner, &lock_owner, memory_order_relaxed);
+    self->lock_depth = 1;
+}
+
+/** Unlock a property.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ */
+
+static inline void property_unlock(mlt_property self)
+{
+    if (--self->lock_depth == 0) {
+        atomic_store_explicit(&self->owner, NULL, memory_order_relaxed);
+        atomic_fetch_add(&self->seq, 1);
+        if (atomic_load(&self->waiters)) {
+            lock_stripe *stripe = property_lock_stripe(self);
+            pthread_mutex_lock(&stripe->mutex);
+            pthread_cond_broadcast(&stripe->cond);
+            pthread_mutex_unlock(&stripe->mutex);
+        }
+    }
+}
+
+/** Start reading a property without locking.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return the sequence count to pass to property_read_valid()
+ */
+
+static inline unsigned int property_read_begin(mlt_property self)
+{
+    return atomic_load_explicit(&self->seq, memory_order_acquire);
+}
+
+/** Check that nothing was locked while reading a property without locking.
+ *
+ * This must only guard plain values read from the property, never pointers
+ * that were dereferenced, because a writer may have freed them.
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \param seq the value from property_read_begin()
+ * \return true if the values read are consistent
+ */
+
+static inline int property_read_valid(mlt_property self, unsigned int seq)
+{
+    atomic_thread_fence(memory_order_acquire);
+    return !(seq & 1) && atomic_load_explicit(&self->seq, memory_order_relaxed) == seq;
+}
+
+/** Get the animation of a property.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return the animation or NULL
+ */
+
+static inline mlt_animation property_animation(mlt_property self)
+{
+    return self->extra ? self->extra->animation : NULL;
+}
+
+/** Get the serialiser of a property.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return the serialiser or NULL
+ */
+
+static inline mlt_serialiser property_serialiser(mlt_property self)
+{
+    return self->extra ? self->extra->serialiser : NULL;
+}
+
+/** Get the rarely used fields of a property, allocating them if needed.
+ *
+ * The caller must hold the property lock.
+ * \private \memberof mlt_property_s
+ * \param self a property
+ * \return the extra fields
+ */
+
+static property_extra *property_extra_fetch(mlt_property self)
+{
+    if (!self->extra)
+        self->extra = calloc(1, sizeof(property_extra));
+    return self->extra;
+}
+
 /** Construct a property and initialize it
  * \public \memberof mlt_property_s
  */
 
 mlt_property mlt_property_init()
 {
-    mlt_property self = calloc(1, sizeof(*self));
-    if (self) {
-        pthread_mutexattr_t attr;
-        pthread_mutexattr_init(&attr);
-        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-        pthread_mutex_init(&self->mutex, &attr);
-    }
-    return self;
+    return calloc(1, sizeof(struct mlt_property_s));
+}
+
+/** Construct several properties in one allocation.
+ *
+ * Properties from this must be closed together with mlt_property_close_bulk()
+ * and not with mlt_property_close().
+ * \public \memberof mlt_property_s
+ * \param[out] properties an array to receive \p count new properties
+ * \param count the number of properties to create
+ */
+
+void mlt_property_init_bulk(mlt_property *properties, int count)
+{
+    mlt_property block = calloc(count, sizeof(struct mlt_property_s));
+    int i;
+    for (i = 0; i < count; i++)
+        properties[i] = &block[i];
+}
+
+/** Release the string held by a property.
+ *
+ * \private \memberof mlt_property_s
+ * \param self a property
+ */
+
+static inline void free_string(mlt_property self)
+{
+    if (self->prop_string && !(self->types & mlt_prop_borrowed))
+        free(self->prop_string);
+    self->types &= ~mlt_prop_borrowed;
+    self->prop_string = NULL;
+    if (self->extra)
+        self->extra->generation++;
 }
 
 /** Clear (0/null) a property.
@@ -113,26 +352,21 @@ static void clear_property(mlt_property self)
         self->destructor(self->data);
 
     // Special case string handling
-    if (self->prop_string)
-        free(self->prop_string);
-
-    mlt_animation_close(self->animation);
+    free_string(self);
 
-    mlt_properties_close(self->properties);
+    if (self->extra) {
+        mlt_animation_close(self->extra->animation);
+        mlt_properties_close(self->extra->properties);
+        memset(self->extra, 0, sizeof(property_extra));
+    }
 
     // Wipe stuff
     self->types = 0;
-    self->prop_int = 0;
-    self->prop_position = 0;
-    self->prop_double = 0;
     self->prop_int64 = 0;
     self->prop_string = NULL;
     self->data = NULL;
     self->length = 0;
     self->destructor = NULL;
-    self->serialiser = NULL;
-    self->animation = NULL;
-    self->properties = NULL;
 }
 
 /** Clear (0/null) a property.
@@ -144,9 +378,9 @@ static void clear_property(mlt_property self)
 
 void mlt_property_clear(mlt_property self)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
 }
 
 /** Check if a property is cleared.
@@ -160,9 +394,15 @@ int mlt_property_is_clear(mlt_property self)
 {
     int result = 1;
     if (self) {
-        pthread_mutex_lock(&self->mutex);
-        result = self->types == 0 && self->animation == NULL && self->properties == NULL;
-        pthread_mutex_unlock(&self->mutex);
+        unsigned int seq = property_read_begin(self);
+        result = self->types == 0
+                 && (!self->extra || (!self->extra->animation && !self->extra->properties));
+        if (!property_read_valid(self, seq)) {
+            property_lock(self);
+            result = self->types == 0
+                 && (!self->extra || (!self->extra->animation && !self->extra->properties));
+            property_unlock(self);
+        }
     }
     return result;
 }
@@ -177,11 +417,11 @@ int mlt_property_is_clear(mlt_property self)
 
 int mlt_property_set_int(mlt_property self, int value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_int;
     self->prop_int = value;
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -195,11 +435,11 @@ int mlt_property_set_int(mlt_property self, int value)
 
 int mlt_property_set_double(mlt_property self, double value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_double;
     self->prop_double = value;
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -214,11 +454,11 @@ int mlt_property_set_double(mlt_property self, double value)
 
 int mlt_property_set_position(mlt_property self, mlt_position value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_position;
     self->prop_position = value;
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -234,16 +474,40 @@ int mlt_property_set_position(mlt_property self, mlt_position value)
 
 int mlt_property_set_string(mlt_property self, const char *value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (value != self->prop_string) {
         clear_property(self);
         self->types = mlt_prop_string;
         if (value != NULL)
             self->prop_string = strdup(value);
     } else {
-        self->types = mlt_prop_string;
+        self->types = mlt_prop_string | (self->types & mlt_prop_borrowed);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
+    return self->prop_string == NULL;
+}
+
+/** Set the property to a string without copying it.
+ *
+ * The property does not free the string, so it must remain valid until the
+ * property is cleared or set to something else. This is used by a properties
+ * list with an arena (see mlt_properties_set_arena()).
+ * \public \memberof mlt_property_s
+ * \param self a property
+ * \param value the string to reference
+ * \return true if it failed
+ */
+
+int mlt_property_set_string_nocopy(mlt_property self, char *value)
+{
+    property_lock(self);
+    clear_property(self);
+    self->types = mlt_prop_string;
+    if (value != NULL) {
+        self->types |= mlt_prop_borrowed;
+        self->prop_string = value;
+    }
+    property_unlock(self);
     return self->prop_string == NULL;
 }
 
@@ -257,11 +521,11 @@ int mlt_property_set_string(mlt_property self, const char *value)
 
 int mlt_property_set_int64(mlt_property self, int64_t value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_int64;
     self->prop_int64 = value;
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -286,7 +550,7 @@ int mlt_property_set_data(mlt_property self,
                           mlt_destructor destructor,
                           mlt_serialiser serialiser)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (self->data == value)
         self->destructor = NULL;
     clear_property(self);
@@ -294,8 +558,9 @@ int mlt_property_set_data(mlt_property self,
     self->data = value;
     self->length = length;
     self->destructor = destructor;
-    self->serialiser = serialiser;
-    pthread_mutex_unlock(&self->mutex);
+    if (serialiser)
+        property_extra_fetch(self)->serialiser = serialiser;
+    property_unlock(self);
     return 0;
 }
 
@@ -322,7 +587,7 @@ static int time_clock_to_frames(mlt_property self, const char *s, double fps, ml
     char *orig_localename = NULL;
     if (locale) {
         // Protect damaging the global locale from a temporary locale on another thread.
-        pthread_mutex_lock(&self->mutex);
+        property_lock(self);
 
         // Get the current locale
         orig_localename = strdup(setlocale(LC_NUMERIC, NULL));
@@ -362,7 +627,7 @@ static int time_clock_to_frames(mlt_property self, const char *s, double fps, ml
         // Restore the current locale
         setlocale(LC_NUMERIC, orig_localename);
         free(orig_localename);
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
     }
 #endif
 
@@ -473,8 +738,25 @@ static int mlt_property_atoi(mlt_property self, double fps, mlt_locale_t locale)
 
 int mlt_property_get_int(mlt_property self, double fps, mlt_locale_t locale)
 {
-    pthread_mutex_lock(&self->mutex);
+    // Try numeric values without locking first
+    unsigned int seq = property_read_begin(self);
+    mlt_property_type types = self->types;
     int result = 0;
+    if (types & mlt_prop_int || types & mlt_prop_color)
+        result = self->prop_int;
+    else if (types & mlt_prop_double)
+        result = (int) self->prop_double;
+    else if (types & mlt_prop_position)
+        result = (int) self->prop_position;
+    else if (types & mlt_prop_int64)
+        result = (int) self->prop_int64;
+    else
+        types = 0;
+    if (types && property_read_valid(self, seq))
+        return result;
+
+    property_lock(self);
+    result = 0;
     if (self->types & mlt_prop_int || self->types & mlt_prop_color)
         result = self->prop_int;
     else if (self->types & mlt_prop_double)
@@ -486,12 +768,12 @@ int mlt_property_get_int(mlt_property self, double fps, mlt_locale_t locale)
     else if (self->types & mlt_prop_rect && self->data)
         result = (int) ((mlt_rect *) self->data)->x;
     else {
-        if (self->animation && !mlt_animation_get_string(self->animation))
+        if (property_animation(self) && !mlt_animation_get_string(self->extra->animation))
             mlt_property_get_string(self);
         if ((self->types & mlt_prop_string) && self->prop_string)
             result = mlt_property_atoi(self, fps, locale);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return result;
 }
 
@@ -529,7 +811,7 @@ static double mlt_property_atof(mlt_property self, double fps, mlt_locale_t loca
         char *orig_localename = NULL;
         if (locale) {
             // Protect damaging the global locale from a temporary locale on another thread.
-            pthread_mutex_lock(&self->mutex);
+            property_lock(self);
 
             // Get the current locale
             orig_localename = strdup(setlocale(LC_NUMERIC, NULL));
@@ -548,7 +830,7 @@ static double mlt_property_atof(mlt_property self, double fps, mlt_locale_t loca
             // Restore the current locale
             setlocale(LC_NUMERIC, orig_localename);
             free(orig_localename);
-            pthread_mutex_unlock(&self->mutex);
+            property_unlock(self);
         }
 #endif
 
@@ -567,8 +849,25 @@ static double mlt_property_atof(mlt_property self, double fps, mlt_locale_t loca
 
 double mlt_property_get_double(mlt_property self, double fps, mlt_locale_t locale)
 {
+    // Try numeric values without locking first
+    unsigned int seq = property_read_begin(self);
+    mlt_property_type types = self->types;
     double result = 0.0;
-    pthread_mutex_lock(&self->mutex);
+    if (types & mlt_prop_double)
+        result = self->prop_double;
+    else if (types & mlt_prop_int || types & mlt_prop_color)
+        result = (double) self->prop_int;
+    else if (types & mlt_prop_position)
+        result = (double) self->prop_position;
+    else if (types & mlt_prop_int64)
+        result = (double) self->prop_int64;
+    else
+        types = 0;
+    if (types && property_read_valid(self, seq))
+        return result;
+
+    result = 0.0;
+    property_lock(self);
     if (self->types & mlt_prop_double)
         result = self->prop_double;
     else if (self->types & mlt_prop_int || self->types & mlt_prop_color)
@@ -580,12 +879,12 @@ double mlt_property_get_double(mlt_property self, double fps, mlt_locale_t local
     else if (self->types & mlt_prop_rect && self->data)
         result = ((mlt_rect *) self->data)->x;
     else {
-        if (self->animation && !mlt_animation_get_string(self->animation))
+        if (property_animation(self) && !mlt_animation_get_string(self->extra->animation))
             mlt_property_get_string(self);
         if ((self->types & mlt_prop_string) && self->prop_string)
             result = mlt_property_atof(self, fps, locale);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return result;
 }
 
@@ -601,8 +900,25 @@ double mlt_property_get_double(mlt_property self, double fps, mlt_locale_t local
 
 mlt_position mlt_property_get_position(mlt_property self, double fps, mlt_locale_t locale)
 {
+    // Try numeric values without locking first
+    unsigned int seq = property_read_begin(self);
+    mlt_property_type types = self->types;
     mlt_position result = 0;
-    pthread_mutex_lock(&self->mutex);
+    if (types & mlt_prop_position)
+        result = self->prop_position;
+    else if (types & mlt_prop_int || types & mlt_prop_color)
+        result = (mlt_position) self->prop_int;
+    else if (types & mlt_prop_double)
+        result = (mlt_position) self->prop_double;
+    else if (types & mlt_prop_int64)
+        result = (mlt_position) self->prop_int64;
+    else
+        types = 0;
+    if (types && property_read_valid(self, seq))
+        return result;
+
+    result = 0;
+    property_lock(self);
     if (self->types & mlt_prop_position)
         result = self->prop_position;
     else if (self->types & mlt_prop_int || self->types & mlt_prop_color)
@@ -614,12 +930,12 @@ mlt_position mlt_property_get_position(mlt_property self, double fps, mlt_locale
     else if (self->types & mlt_prop_rect && self->data)
         result = (mlt_position) ((mlt_rect *) self->data)->x;
     else {
-        if (self->animation && !mlt_animation_get_string(self->animation))
+        if (property_animation(self) && !mlt_animation_get_string(self->extra->animation))
             mlt_property_get_string(self);
         if ((self->types & mlt_prop_string) && self->prop_string)
             result = (mlt_position) mlt_property_atoi(self, fps, locale);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return result;
 }
 
@@ -650,8 +966,25 @@ static inline int64_t mlt_property_atoll(const char *value)
 
 int64_t mlt_property_get_int64(mlt_property self)
 {
+    // Try numeric values without locking first
+    unsigned int seq = property_read_begin(self);
+    mlt_property_type types = self->types;
     int64_t result = 0;
-    pthread_mutex_lock(&self->mutex);
+    if (types & mlt_prop_int64)
+        result = self->prop_int64;
+    else if (types & mlt_prop_int || types & mlt_prop_color)
+        result = (int64_t) self->prop_int;
+    else if (types & mlt_prop_double)
+        result = (int64_t) self->prop_double;
+    else if (types & mlt_prop_position)
+        result = (int64_t) self->prop_position;
+    else
+        types = 0;
+    if (types && property_read_valid(self, seq))
+        return result;
+
+    result = 0;
+    property_lock(self);
     if (self->types & mlt_prop_int64)
         result = self->prop_int64;
     else if (self->types & mlt_prop_int || self->types & mlt_prop_color)
@@ -663,12 +996,12 @@ int64_t mlt_property_get_int64(mlt_property self)
     else if (self->types & mlt_prop_rect && self->data)
         result = (int64_t) ((mlt_rect *) self->data)->x;
     else {
-        if (self->animation && !mlt_animation_get_string(self->animation))
+        if (property_animation(self) && !mlt_animation_get_string(self->extra->animation))
             mlt_property_get_string(self);
         if ((self->types & mlt_prop_string) && self->prop_string)
             result = mlt_property_atoll(self->prop_string);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return result;
 }
 
@@ -687,10 +1020,10 @@ int64_t mlt_property_get_int64(mlt_property self)
 char *mlt_property_get_string_tf(mlt_property self, mlt_time_format time_format)
 {
     // Construct a string if need be
-    pthread_mutex_lock(&self->mutex);
-    if (self->animation && self->serialiser) {
-        free(self->prop_string);
-        self->prop_string = self->serialiser(self->animation, time_format);
+    property_lock(self);
+    if (property_animation(self) && self->extra->serialiser) {
+        free_string(self);
+        self->prop_string = self->extra->serialiser(self->extra->animation, time_format);
     } else if (!(self->types & mlt_prop_string)) {
         if (self->types & mlt_prop_int) {
             self->types |= mlt_prop_string;
@@ -714,12 +1047,12 @@ char *mlt_property_get_string_tf(mlt_property self, mlt_time_format time_format)
             self->types |= mlt_prop_string;
             self->prop_string = malloc(32);
             sprintf(self->prop_string, "%" PRId64, self->prop_int64);
-        } else if (self->types & mlt_prop_data && self->data && self->serialiser) {
+        } else if (self->types & mlt_prop_data && self->data && property_serialiser(self)) {
             self->types |= mlt_prop_string;
-            self->prop_string = self->serialiser(self->data, self->length);
+            self->prop_string = self->extra->serialiser(self->data, self->length);
         }
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
 
     // Return the string (may be NULL)
     return self->prop_string;
@@ -769,10 +1102,10 @@ char *mlt_property_get_string_l_tf(mlt_property self,
         return mlt_property_get_string_tf(self, time_format);
 
     // Construct a string if need be
-    pthread_mutex_lock(&self->mutex);
-    if (self->animation && self->serialiser) {
-        free(self->prop_string);
-        self->prop_string = self->serialiser(self->animation, time_format);
+    property_lock(self);
+    if (property_animation(self) && self->extra->serialiser) {
+        free_string(self);
+        self->prop_string = self->extra->serialiser(self->extra->animation, time_format);
     } else if (!(self->types & mlt_prop_string)) {
 #if !defined(_WIN32)
         // TODO: when glibc gets sprintf_l, start using it! For now, hack on setlocale.
@@ -813,9 +1146,9 @@ char *mlt_property_get_string_l_tf(mlt_property self,
             self->types |= mlt_prop_string;
             self->prop_string = malloc(32);
             sprintf(self->prop_string, "%" PRId64, self->prop_int64);
-        } else if (self->types & mlt_prop_data && self->data && self->serialiser) {
+        } else if (self->types & mlt_prop_data && self->data && property_serialiser(self)) {
             self->types |= mlt_prop_string;
-            self->prop_string = self->serialiser(self->data, self->length);
+            self->prop_string = self->extra->serialiser(self->data, self->length);
         }
 #if !defined(_WIN32)
         // Restore the current locale
@@ -823,7 +1156,7 @@ char *mlt_property_get_string_l_tf(mlt_property self,
         free(orig_localename);
 #endif
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
 
     // Return the string (may be NULL)
     return self->prop_string;
@@ -862,14 +1195,20 @@ char *mlt_property_get_string_l(mlt_property self, mlt_locale_t locale)
 
 void *mlt_property_get_data(mlt_property self, int *length)
 {
-    // Assign length if not NULL
-    if (length != NULL)
-        *length = self->length;
-
     // Return the data (note: there is no conversion here)
-    pthread_mutex_lock(&self->mutex);
+    unsigned int seq = property_read_begin(self);
     void *result = self->data;
-    pthread_mutex_unlock(&self->mutex);
+    int size = self->length;
+    if (!property_read_valid(self, seq)) {
+        property_lock(self);
+        result = self->data;
+        size = self->length;
+        property_unlock(self);
+    }
+
+    // Assign length if not NULL
+    if (length != NULL)
+        *length = size;
     return result;
 }
 
@@ -882,10 +1221,28 @@ void *mlt_property_get_data(mlt_property self, int *length)
 void mlt_property_close(mlt_property self)
 {
     clear_property(self);
-    pthread_mutex_destroy(&self->mutex);
+    free(self->extra);
     free(self);
 }
 
+/** Destroy properties created by mlt_property_init_bulk().
+ *
+ * The properties are destroyed last to first.
+ * \public \memberof mlt_property_s
+ * \param properties the array filled by mlt_property_init_bulk()
+ * \param count the number of properties, as passed to mlt_property_init_bulk()
+ */
+
+void mlt_property_close_bulk(mlt_property *properties, int count)
+{
+    int i;
+    for (i = count - 1; i >= 0; i--) {
+        clear_property(properties[i]);
+        free(properties[i]->extra);
+    }
+    free(properties[0]);
+}
+
 /** Copy a property.
  *
  * A Property holding binary data only copies the data if a serialiser
@@ -897,10 +1254,10 @@ void mlt_property_close(mlt_property self)
  */
 void mlt_property_pass(mlt_property self, mlt_property that)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
 
-    self->types = that->types;
+    self->types = that->types & ~mlt_prop_borrowed;
 
     if (self->types & mlt_prop_int64)
         self->prop_int64 = that->prop_int64;
@@ -920,15 +1277,16 @@ void mlt_property_pass(mlt_property self, mlt_property that)
         self->data = calloc(1, self->length);
         memcpy(self->data, that->data, self->length);
         self->destructor = free;
-        self->serialiser = that->serialiser;
-    } else if (that->animation && that->serialiser) {
+        property_extra_fetch(self)->serialiser = property_serialiser(that);
+    } else if (property_animation(that) && that->extra->serialiser) {
         self->types = mlt_prop_string;
-        self->prop_string = that->serialiser(that->animation, default_time_format());
-    } else if (that->types & mlt_prop_data && that->serialiser) {
+        self->prop_string = that->extra->serialiser(that->extra->animation,
+                                                    default_time_format());
+    } else if (that->types & mlt_prop_data && property_serialiser(that)) {
         self->types = mlt_prop_string;
-        self->prop_string = that->serialiser(that->data, that->length);
+        self->prop_string = that->extra->serialiser(that->data, that->length);
     }
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
 }
 
 /** Convert frame count to a SMPTE timecode string.
@@ -1080,7 +1438,7 @@ char *mlt_property_get_time(mlt_property self,
 #endif // _WIN32
 
         // Protect damaging the global locale from a temporary locale on another thread.
-        pthread_mutex_lock(&self->mutex);
+        property_lock(self);
 
         // Get the current locale
         orig_localename = strdup(setlocale(LC_NUMERIC, NULL));
@@ -1091,7 +1449,7 @@ char *mlt_property_get_time(mlt_property self,
 #endif // _WIN32
     {
         // Make sure we have a lock before accessing self->types
-        pthread_mutex_lock(&self->mutex);
+        property_lock(self);
     }
 
     // Convert number to string
@@ -1120,12 +1478,12 @@ char *mlt_property_get_time(mlt_property self,
     if (locale) {
         setlocale(LC_NUMERIC, orig_localename);
         free(orig_localename);
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
     } else
 #endif // _WIN32
     {
         // Make sure we have a lock before accessing self->types
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
     }
 
     // Return the string (may be NULL)
@@ -1158,7 +1516,7 @@ int mlt_property_is_numeric(mlt_property self, mlt_locale_t locale)
         char *orig_localename = NULL;
         if (locale) {
             // Protect damaging the global locale from a temporary locale on another thread.
-            pthread_mutex_lock(&self->mutex);
+            property_lock(self);
 
             // Get the current locale
             orig_localename = strdup(setlocale(LC_NUMERIC, NULL));
@@ -1175,7 +1533,7 @@ int mlt_property_is_numeric(mlt_property self, mlt_locale_t locale)
             // Restore the current locale
             setlocale(LC_NUMERIC, orig_localename);
             free(orig_localename);
-            pthread_mutex_unlock(&self->mutex);
+            property_unlock(self);
         }
 #endif
 
@@ -1396,21 +1754,33 @@ int mlt_property_interpolate(mlt_property self,
 
 static void refresh_animation(mlt_property self, double fps, mlt_locale_t locale, int length)
 {
-    if (!self->animation) {
-        self->animation = mlt_animation_new();
-        self->serialiser = (mlt_serialiser) mlt_animation_serialize_tf;
-        mlt_animation_parse(self->animation, self->prop_string, length, fps, locale);
-    } else if (!mlt_animation_get_string(self->animation)) {
+    property_extra *extra = self->extra;
+
+    if (!property_animation(self)) {
+        extra = property_extra_fetch(self);
+        extra->animation = mlt_animation_new();
+        extra->serialiser = (mlt_serialiser) mlt_animation_serialize_tf;
+        mlt_animation_parse(extra->animation, self->prop_string, length, fps, locale);
+    } else if (!mlt_animation_get_string(extra->animation)) {
         // The animation clears its string if it is modified.
         // Do not use a property string that is out of sync.
         self->types &= ~mlt_prop_string;
-        free(self->prop_string);
-        self->prop_string = NULL;
+        free_string(self);
+        return;
     } else if ((self->types & mlt_prop_string) && self->prop_string) {
-        mlt_animation_refresh(self->animation, self->prop_string, length);
-    } else if (length >= 0) {
-        mlt_animation_set_length(self->animation, length);
+        // Only compare the strings if either changed since they were last compared.
+        if (extra->synced == extra->generation && extra->synced_length == length
+            && extra->synced_animation == mlt_animation_get_generation(extra->animation))
+            return;
+        mlt_animation_refresh(extra->animation, self->prop_string, length);
+    } else {
+        if (length >= 0)
+            mlt_animation_set_length(extra->animation, length);
+        return;
     }
+    extra->synced = extra->generation;
+    extra->synced_animation = mlt_animation_get_generation(extra->animation);
+    extra->synced_length = length;
 }
 
 /** Get the real number at a frame position.
@@ -1429,19 +1799,13 @@ double mlt_property_anim_get_double(
     mlt_property self, double fps, mlt_locale_t locale, int position, int length)
 {
     double result;
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (mlt_property_is_anim(self)) {
-        struct mlt_animation_item_s item;
-        item.property = mlt_property_init();
-
         refresh_animation(self, fps, locale, length);
-        mlt_animation_get_item(self->animation, &item, position);
-        pthread_mutex_unlock(&self->mutex);
-        result = mlt_property_get_double(item.property, fps, locale);
-
-        mlt_property_close(item.property);
+        result = mlt_animation_get_double(self->extra->animation, position, fps, locale);
+        property_unlock(self);
     } else {
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         result = mlt_property_get_double(self, fps, locale);
     }
     return result;
@@ -1463,19 +1827,13 @@ int mlt_property_anim_get_int(
     mlt_property self, double fps, mlt_locale_t locale, int position, int length)
 {
     int result;
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (mlt_property_is_anim(self)) {
-        struct mlt_animation_item_s item;
-        item.property = mlt_property_init();
-
         refresh_animation(self, fps, locale, length);
-        mlt_animation_get_item(self->animation, &item, position);
-        pthread_mutex_unlock(&self->mutex);
-        result = mlt_property_get_int(item.property, fps, locale);
-
-        mlt_property_close(item.property);
+        result = mlt_animation_get_int(self->extra->animation, position, fps, locale);
+        property_unlock(self);
     } else {
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         result = mlt_property_get_int(self, fps, locale);
     }
     return result;
@@ -1497,20 +1855,20 @@ char *mlt_property_anim_get_string(
     mlt_property self, double fps, mlt_locale_t locale, int position, int length)
 {
     char *result;
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (mlt_property_is_anim(self)) {
         struct mlt_animation_item_s item;
         item.property = mlt_property_init();
 
-        if (!self->animation)
+        if (!property_animation(self))
             refresh_animation(self, fps, locale, length);
-        mlt_animation_get_item(self->animation, &item, position);
+        mlt_animation_get_item(self->extra->animation, &item, position);
 
-        free(self->prop_string);
+        free_string(self);
 
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         self->prop_string = mlt_property_get_string_l(item.property, locale);
-        pthread_mutex_lock(&self->mutex);
+        property_lock(self);
 
         if (self->prop_string)
             self->prop_string = strdup(self->prop_string);
@@ -1518,9 +1876,9 @@ char *mlt_property_anim_get_string(
 
         result = self->prop_string;
         mlt_property_close(item.property);
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
     } else {
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         result = mlt_property_get_string_l(self, locale);
     }
     return result;
@@ -1556,11 +1914,11 @@ int mlt_property_anim_set_double(mlt_property self,
     item.keyframe_type = keyframe_type;
     mlt_property_set_double(item.property, value);
 
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     refresh_animation(self, fps, locale, length);
-    result = mlt_animation_insert(self->animation, &item);
-    mlt_animation_interpolate(self->animation);
-    pthread_mutex_unlock(&self->mutex);
+    result = mlt_animation_insert(self->extra->animation, &item);
+    mlt_animation_interpolate(self->extra->animation);
+    property_unlock(self);
     mlt_property_close(item.property);
 
     return result;
@@ -1596,11 +1954,11 @@ int mlt_property_anim_set_int(mlt_property self,
     item.keyframe_type = keyframe_type;
     mlt_property_set_int(item.property, value);
 
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     refresh_animation(self, fps, locale, length);
-    result = mlt_animation_insert(self->animation, &item);
-    mlt_animation_interpolate(self->animation);
-    pthread_mutex_unlock(&self->mutex);
+    result = mlt_animation_insert(self->extra->animation, &item);
+    mlt_animation_interpolate(self->extra->animation);
+    property_unlock(self);
     mlt_property_close(item.property);
 
     return result;
@@ -1633,11 +1991,11 @@ int mlt_property_anim_set_string(
     item.keyframe_type = mlt_keyframe_discrete;
     mlt_property_set_string(item.property, value);
 
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     refresh_animation(self, fps, locale, length);
-    result = mlt_animation_insert(self->animation, &item);
-    mlt_animation_interpolate(self->animation);
-    pthread_mutex_unlock(&self->mutex);
+    result = mlt_animation_insert(self->extra->animation, &item);
+    mlt_animation_interpolate(self->extra->animation);
+    property_unlock(self);
     mlt_property_close(item.property);
 
     return result;
@@ -1654,9 +2012,9 @@ int mlt_property_anim_set_string(
 
 mlt_animation mlt_property_get_animation(mlt_property self)
 {
-    pthread_mutex_lock(&self->mutex);
-    mlt_animation result = self->animation;
-    pthread_mutex_unlock(&self->mutex);
+    property_lock(self);
+    mlt_animation result = property_animation(self);
+    property_unlock(self);
     return result;
 }
 
@@ -1670,12 +2028,12 @@ mlt_animation mlt_property_get_animation(mlt_property self)
 
 int mlt_property_set_color(mlt_property self, mlt_color value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_color;
     uint32_t int_value = (value.r << 24) | (value.g << 16) | (value.b << 8) | value.a;
     self->prop_int = int_value;
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -1762,11 +2120,11 @@ int mlt_property_anim_set_color(mlt_property self,
     item.keyframe_type = keyframe_type;
     mlt_property_set_color(item.property, value);
 
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     refresh_animation(self, fps, locale, length);
-    result = mlt_animation_insert(self->animation, &item);
-    mlt_animation_interpolate(self->animation);
-    pthread_mutex_unlock(&self->mutex);
+    result = mlt_animation_insert(self->extra->animation, &item);
+    mlt_animation_interpolate(self->extra->animation);
+    property_unlock(self);
     mlt_property_close(item.property);
 
     return result;
@@ -1788,20 +2146,13 @@ mlt_color mlt_property_anim_get_color(
     mlt_property self, double fps, mlt_locale_t locale, int position, int length)
 {
     mlt_color result;
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (mlt_property_is_anim(self)) {
-        struct mlt_animation_item_s item;
-        item.property = mlt_property_init();
-        item.property->types = mlt_prop_color;
-
         refresh_animation(self, fps, locale, length);
-        mlt_animation_get_item(self->animation, &item, position);
-        pthread_mutex_unlock(&self->mutex);
-        result = mlt_property_get_color(item.property, fps, locale);
-
-        mlt_property_close(item.property);
+        result = mlt_animation_get_color(self->extra->animation, position, fps, locale);
+        property_unlock(self);
     } else {
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         result = mlt_property_get_color(self, fps, locale);
     }
     return result;
@@ -1844,15 +2195,15 @@ static char *serialise_mlt_rect(mlt_rect *rect, int length)
 
 int mlt_property_set_rect(mlt_property self, mlt_rect value)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
     self->types = mlt_prop_rect | mlt_prop_data;
     self->length = sizeof(value);
     self->data = calloc(1, self->length);
     memcpy(self->data, &value, self->length);
     self->destructor = free;
-    self->serialiser = (mlt_serialiser) serialise_mlt_rect;
-    pthread_mutex_unlock(&self->mutex);
+    property_extra_fetch(self)->serialiser = (mlt_serialiser) serialise_mlt_rect;
+    property_unlock(self);
     return 0;
 }
 
@@ -1889,7 +2240,7 @@ mlt_rect mlt_property_get_rect(mlt_property self, mlt_locale_t locale)
         char *orig_localename = NULL;
         if (locale) {
             // Protect damaging the global locale from a temporary locale on another thread.
-            pthread_mutex_lock(&self->mutex);
+            property_lock(self);
 
             // Get the current locale
             orig_localename = strdup(setlocale(LC_NUMERIC, NULL));
@@ -1947,7 +2298,7 @@ mlt_rect mlt_property_get_rect(mlt_property self, mlt_locale_t locale)
             // Restore the current locale
             setlocale(LC_NUMERIC, orig_localename);
             free(orig_localename);
-            pthread_mutex_unlock(&self->mutex);
+            property_unlock(self);
         }
 #endif
     }
@@ -1984,11 +2335,11 @@ int mlt_property_anim_set_rect(mlt_property self,
     item.keyframe_type = keyframe_type;
     mlt_property_set_rect(item.property, value);
 
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     refresh_animation(self, fps, locale, length);
-    result = mlt_animation_insert(self->animation, &item);
-    mlt_animation_interpolate(self->animation);
-    pthread_mutex_unlock(&self->mutex);
+    result = mlt_animation_insert(self->extra->animation, &item);
+    mlt_animation_interpolate(self->extra->animation);
+    property_unlock(self);
     mlt_property_close(item.property);
 
     return result;
@@ -2010,20 +2361,13 @@ mlt_rect mlt_property_anim_get_rect(
     mlt_property self, double fps, mlt_locale_t locale, int position, int length)
 {
     mlt_rect result;
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     if (mlt_property_is_anim(self)) {
-        struct mlt_animation_item_s item;
-        item.property = mlt_property_init();
-        item.property->types = mlt_prop_rect;
-
         refresh_animation(self, fps, locale, length);
-        mlt_animation_get_item(self->animation, &item, position);
-        pthread_mutex_unlock(&self->mutex);
-        result = mlt_property_get_rect(item.property, locale);
-
-        mlt_property_close(item.property);
+        result = mlt_animation_get_rect(self->extra->animation, position, locale);
+        property_unlock(self);
     } else {
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
         result = mlt_property_get_rect(self, locale);
     }
     return result;
@@ -2039,11 +2383,11 @@ mlt_rect mlt_property_anim_get_rect(
 
 int mlt_property_set_properties(mlt_property self, mlt_properties properties)
 {
-    pthread_mutex_lock(&self->mutex);
+    property_lock(self);
     clear_property(self);
-    self->properties = properties;
+    property_extra_fetch(self)->properties = properties;
     mlt_properties_inc_ref(properties);
-    pthread_mutex_unlock(&self->mutex);
+    property_unlock(self);
     return 0;
 }
 
@@ -2057,9 +2401,9 @@ int mlt_property_set_properties(mlt_property self, mlt_properties properties)
 mlt_properties mlt_property_get_properties(mlt_property self)
 {
     mlt_properties properties = NULL;
-    pthread_mutex_lock(&self->mutex);
-    properties = self->properties;
-    pthread_mutex_unlock(&self->mutex);
+    property_lock(self);
+    properties = self->extra ? self->extra->properties : NULL;
+    property_unlock(self);
     return properties;
 }
 
@@ -2074,7 +2418,7 @@ mlt_properties mlt_property_get_properties(mlt_property self)
 
 int mlt_property_is_anim(mlt_property self)
 {
-    return self->animation || (self->prop_string && strchr(self->prop_string, '='));
+    return property_animation(self) || (self->prop_string && strchr(self->prop_string, '='));
 }
 
 /** Check if a property is a color.
@@ -2088,7 +2432,7 @@ extern int mlt_property_is_color(mlt_property self)
 {
     int result = 0;
     if (self) {
-        pthread_mutex_lock(&self->mutex);
+        property_lock(self);
         if (self->types & mlt_prop_color) {
             result = 1;
         } else {
@@ -2099,7 +2443,7 @@ extern int mlt_property_is_color(mlt_property self)
                 result = 1;
             }
         }
-        pthread_mutex_unlock(&self->mutex);
+        property_unlock(self);
     }
     return result;
 }
@@ -53,6 +53,7 @@ extern int mlt_property_set_double(mlt_property self, double value);
 extern int mlt_property_set_position(mlt_property self, mlt_position value);
 extern int mlt_property_set_int64(mlt_property self, int64_t value);
 extern int mlt_property_set_string(mlt_property self, const char *value);
+extern int mlt_property_set_string_nocopy(mlt_property self, char *value);
 extern int mlt_property_set_data(mlt_property self,
                                  void *value,
                                  int length,
@@ -131,5 +132,7 @@ extern mlt_properties mlt_property_get_properties(mlt_property self);
 extern int mlt_property_is_color(mlt_property self);
 extern int mlt_property_is_numeric(mlt_property self, mlt_locale_t locale);
 extern int mlt_property_is_rect(mlt_property self);
+extern void mlt_property_init_bulk(mlt_property *properties, int count);
+extern void mlt_property_close_bulk(mlt_property *properties, int count);
 
 #endif
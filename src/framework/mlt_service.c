@@ -1000,3 +1000,34 @@ int mlt_service_cache_get_size(mlt_service self, const char *name)
     else
         return 0;
 }
+
+/** Set the number of bytes to cache for the named cache.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \param name a name for the object that is unique to the service class, but not to the instance
+ * \param max_bytes the number of bytes to cache or 0 to only limit the number of items
+ * \see mlt_cache_set_max_bytes
+ */
+
+void mlt_service_cache_set_max_bytes(mlt_service self, const char *name, int64_t max_bytes)
+{
+    mlt_cache cache = get_cache(self, name);
+    if (cache)
+        mlt_cache_set_max_bytes(cache, max_bytes);
+}
+
+/** Get the statistics of the named cache.
+ *
+ * \public \memberof mlt_service_s
+ * \param self a service
+ * \param name a name for the object that is unique to the service class, but not to the instance
+ * \return the properties of the cache or NULL if there is an error
+ * \see mlt_cache_properties
+ */
+
+mlt_properties mlt_service_cache_properties(mlt_service self, const char *name)
+{
+    mlt_cache cache = get_cache(self, name);
+    return cache ? mlt_cache_properties(cache) : NULL;
+}
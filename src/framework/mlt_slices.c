@@ -27,12 +27,12 @@
 
 #include <pthread.h>
 #include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <unistd.h>
 #ifdef _WIN32
 #include <windows.h>
 #endif
-#define MAX_SLICES 32
 #define ENV_SLICES "MLT_SLICES_COUNT"
 
 typedef enum {
@@ -45,95 +45,203 @@ typedef enum {
 static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
 static mlt_slices globals[mlt_policy_nb] = {NULL, NULL, NULL};
 
+/** the context and worker index of the calling thread if it is a worker */
+static _Thread_local mlt_slices current_ctx = NULL;
+static _Thread_local int current_id = -1;
+
 struct mlt_slices_runtime_s
 {
-    int jobs, done, curr;
+    int jobs;
+    atomic_int curr;
+    atomic_int done;
     mlt_slices_proc proc;
     void *cookie;
-    struct mlt_slices_runtime_s *next;
 };
 
+/** \brief the runs queued on one worker
+ *
+ * The owner takes the newest run and other workers steal the oldest. A run
+ * stays queued until all of its slices are claimed, and slices are only
+ * claimed under the lock so that a run is never used after it is removed.
+ */
+
+typedef struct
+{
+    pthread_mutex_t lock;
+    struct mlt_slices_runtime_s **items;
+    int count;
+    int size;
+} slices_deque;
+
 struct mlt_slices_s
 {
-    int f_exit;
+    atomic_int f_exit;
     int count;
-    int readys;
+    atomic_int readys;
     int ref;
+    atomic_int pending;
+    atomic_uint next;
     pthread_mutex_t cond_mutex;
     pthread_cond_t cond_var_job;
     pthread_cond_t cond_var_ready;
-    pthread_t threads[MAX_SLICES];
-    struct mlt_slices_runtime_s *head, *tail;
+    pthread_t *threads;
+    slices_deque *deques;
     const char *name;
 };
 
+/** Add a run to a worker's queue.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param d a worker's queue
+ * \param r the run
+ */
+
+static void deque_push(mlt_slices ctx, slices_deque *d, struct mlt_slices_runtime_s *r)
+{
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->size) {
+        d->size = d->size ? d->size * 2 : 8;
+        d->items = realloc(d->items, d->size * sizeof(*d->items));
+    }
+    d->items[d->count++] = r;
+    atomic_fetch_add(&ctx->pending, 1);
+    pthread_mutex_unlock(&d->lock);
+}
+
+/** Remove a run from a worker's queue if it is there.
+ *
+ * The caller must hold the queue's lock.
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param d a worker's queue
+ * \param r the run
+ * \return true if the run was found
+ */
+
+static int deque_remove(mlt_slices ctx, slices_deque *d, struct mlt_slices_runtime_s *r)
+{
+    int i;
+    for (i = d->count - 1; i >= 0; i--) {
+        if (d->items[i] == r) {
+            d->count--;
+            for (; i < d->count; i++)
+                d->items[i] = d->items[i + 1];
+            atomic_fetch_sub(&ctx->pending, 1);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** Claim a slice from a worker's queue.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param d a worker's queue
+ * \param steal whether to take the oldest run rather than the newest
+ * \param only a run to claim from, or NULL for any run
+ * \param[out] idx the index of the claimed slice
+ * \return the run of the slice or NULL if there was nothing to claim
+ */
+
+static struct mlt_slices_runtime_s *deque_claim(
+    mlt_slices ctx, slices_deque *d, int steal, struct mlt_slices_runtime_s *only, int *idx)
+{
+    struct mlt_slices_runtime_s *r = NULL;
+
+    pthread_mutex_lock(&d->lock);
+    while (d->count) {
+        if (only) {
+            int i;
+            for (i = 0; i < d->count && d->items[i] != only; i++)
+                ;
+            if (i == d->count)
+                break;
+            r = only;
+        } else {
+            r = steal ? d->items[0] : d->items[d->count - 1];
+        }
+        *idx = atomic_fetch_add(&r->curr, 1);
+        if (*idx < r->jobs)
+            break;
+
+        /* all slices are claimed */
+        deque_remove(ctx, d, r);
+        r = NULL;
+        if (only)
+            break;
+    }
+    pthread_mutex_unlock(&d->lock);
+
+    return r;
+}
+
+/** Run a claimed slice and signal the waiter if it was the last one.
+ *
+ * \private \memberof mlt_slices_s
+ * \param ctx context pointer
+ * \param r the run
+ * \param idx the index of the slice
+ * \param id the index of the calling worker
+ */
+
+static void slices_execute(mlt_slices ctx, struct mlt_slices_runtime_s *r, int idx, int id)
+{
+    int jobs = r->jobs;
+
+    mlt_log_debug(NULL,
+                  "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n",
+                  __FUNCTION__,
+                  __LINE__,
+                  id,
+                  idx,
+                  jobs,
+                  ctx->name);
+    r->proc(id, idx, jobs, r->cookie);
+
+    /* the run may be gone as soon as done reaches jobs */
+    if (atomic_fetch_add(&r->done, 1) + 1 == jobs) {
+        pthread_mutex_lock(&ctx->cond_mutex);
+        pthread_cond_broadcast(&ctx->cond_var_ready);
+        pthread_mutex_unlock(&ctx->cond_mutex);
+    }
+}
+
 static void *mlt_slices_worker(void *p)
 {
-    int id, idx;
+    int id, idx, i;
     struct mlt_slices_runtime_s *r;
     mlt_slices ctx = (mlt_slices) p;
 
     mlt_log_debug(NULL, "%s:%d: ctx=[%p][%s] entering\n", __FUNCTION__, __LINE__, ctx, ctx->name);
 
-    pthread_mutex_lock(&ctx->cond_mutex);
-
-    id = ctx->readys;
-    ctx->readys++;
+    id = atomic_fetch_add(&ctx->readys, 1);
+    current_ctx = ctx;
+    current_id = id;
 
     while (1) {
+        /* take the newest run of our own, then steal the oldest of another */
+        r = deque_claim(ctx, &ctx->deques[id], 0, NULL, &idx);
+        for (i = 1; !r && i < ctx->count; i++)
+            r = deque_claim(ctx, &ctx->deques[(id + i) % ctx->count], 1, NULL, &idx);
+        if (r) {
+            slices_execute(ctx, r, idx, id);
+            continue;
+        }
+
         mlt_log_debug(NULL, "%s:%d: ctx=[%p][%s] waiting\n", __FUNCTION__, __LINE__, ctx, ctx->name);
 
         /* wait for new jobs */
-        while (!ctx->f_exit && !(r = ctx->head))
+        pthread_mutex_lock(&ctx->cond_mutex);
+        while (!atomic_load(&ctx->f_exit) && !atomic_load(&ctx->pending))
             pthread_cond_wait(&ctx->cond_var_job, &ctx->cond_mutex);
-
-        if (ctx->f_exit)
-            break;
-
-        if (!r)
-            continue;
-
-        /* check if no new job */
-        if (r->curr == r->jobs) {
-            ctx->head = ctx->head->next;
-            if (!ctx->head)
-                ctx->tail = NULL;
-            mlt_log_debug(NULL, "%s:%d: new ctx->head=%p\n", __FUNCTION__, __LINE__, ctx->head);
-            continue;
-        };
-
-        /* new job id */
-        idx = r->curr;
-        r->curr++;
-
-        /* run job */
         pthread_mutex_unlock(&ctx->cond_mutex);
-        mlt_log_debug(NULL,
-                      "%s:%d: running job: id=%d, idx=%d/%d, pool=[%s]\n",
-                      __FUNCTION__,
-                      __LINE__,
-                      id,
-                      idx,
-                      r->jobs,
-                      ctx->name);
-        r->proc(id, idx, r->jobs, r->cookie);
-        pthread_mutex_lock(&ctx->cond_mutex);
-
-        /* increase done jobs counter */
-        r->done++;
 
-        /* notify we fininished last job */
-        if (r->done == r->jobs) {
-            mlt_log_debug(NULL,
-                          "%s:%d: pthread_cond_signal( &ctx->cond_var_ready )\n",
-                          __FUNCTION__,
-                          __LINE__);
-            pthread_cond_broadcast(&ctx->cond_var_ready);
-        }
+        if (atomic_load(&ctx->f_exit))
+            break;
     }
 
-    pthread_mutex_unlock(&ctx->cond_mutex);
-
     return NULL;
 }
 
@@ -185,15 +293,19 @@ static mlt_slices mlt_slices_init(int threads, int policy, int priority)
         else if (!threads)
             threads = env_val;
     }
-    if (threads > MAX_SLICES)
-        threads = MAX_SLICES;
+    if (threads < 1)
+        threads = 1;
 
     ctx->count = threads;
+    ctx->threads = calloc(threads, sizeof(pthread_t));
+    ctx->deques = calloc(threads, sizeof(slices_deque));
 
     /* init attributes */
     pthread_mutex_init(&ctx->cond_mutex, NULL);
     pthread_cond_init(&ctx->cond_var_job, NULL);
     pthread_cond_init(&ctx->cond_var_ready, NULL);
+    for (i = 0; i < ctx->count; i++)
+        pthread_mutex_init(&ctx->deques[i].lock, NULL);
     pthread_attr_init(&tattr);
     if (policy < 0)
         policy = SCHED_OTHER;
@@ -245,8 +357,8 @@ static void mlt_slices_close(mlt_slices ctx)
     pthread_mutex_unlock(&g_lock);
 
     /* notify to exit */
-    ctx->f_exit = 1;
     pthread_mutex_lock(&ctx->cond_mutex);
+    atomic_store(&ctx->f_exit, 1);
     pthread_cond_broadcast(&ctx->cond_var_job);
     pthread_cond_broadcast(&ctx->cond_var_ready);
     pthread_mutex_unlock(&ctx->cond_mutex);
@@ -256,15 +368,26 @@ static void mlt_slices_close(mlt_slices ctx)
         pthread_join(ctx->threads[j], NULL);
 
     /* destroy vars */
+    for (j = 0; j < ctx->count; j++) {
+        pthread_mutex_destroy(&ctx->deques[j].lock);
+        free(ctx->deques[j].items);
+    }
     pthread_cond_destroy(&ctx->cond_var_ready);
     pthread_cond_destroy(&ctx->cond_var_job);
     pthread_mutex_destroy(&ctx->cond_mutex);
 
     /* free context */
+    free(ctx->deques);
+    free(ctx->threads);
     free(ctx);
 }
 
 /** Run sliced execution
+ *
+ * When called from one of the context's own workers, as when a sliced filter
+ * runs inside another sliced job, the run is queued on that worker, which
+ * then processes slices itself while others steal the rest. So nesting
+ * neither deadlocks nor starts more threads.
  *
  * \private \memberof mlt_slices_s
  * \param ctx context pointer
@@ -280,9 +403,8 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
         return;
     }
     struct mlt_slices_runtime_s runtime, *r = &runtime;
-
-    /* lock */
-    pthread_mutex_lock(&ctx->cond_mutex);
+    int id = current_ctx == ctx ? current_id : -1;
+    int idx;
 
     /* check jobs count */
     if (jobs < 0)
@@ -292,25 +414,29 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
 
     /* setup runtime args */
     r->jobs = jobs;
-    r->done = 0;
-    r->curr = 0;
+    atomic_init(&r->curr, 0);
+    atomic_init(&r->done, 0);
     r->proc = proc;
     r->cookie = cookie;
-    r->next = NULL;
-
-    /* attach job */
-    if (ctx->tail) {
-        ctx->tail->next = r;
-        ctx->tail = r;
-    } else {
-        ctx->head = ctx->tail = r;
-    }
+
+    /* attach job to the calling worker or spread over the workers */
+    slices_deque *d = &ctx->deques[id >= 0 ? id : atomic_fetch_add(&ctx->next, 1) % ctx->count];
+    deque_push(ctx, d, r);
 
     /* notify workers */
+    pthread_mutex_lock(&ctx->cond_mutex);
     pthread_cond_broadcast(&ctx->cond_var_job);
+    pthread_mutex_unlock(&ctx->cond_mutex);
+
+    /* a worker helps with its own run rather than blocking */
+    if (id >= 0) {
+        while (deque_claim(ctx, d, 0, r, &idx))
+            slices_execute(ctx, r, idx, id);
+    }
 
     /* wait for end of task */
-    while (!ctx->f_exit && (r->done < r->jobs)) {
+    pthread_mutex_lock(&ctx->cond_mutex);
+    while (!atomic_load(&ctx->f_exit) && atomic_load(&r->done) < jobs) {
         pthread_cond_wait(&ctx->cond_var_ready, &ctx->cond_mutex);
         mlt_log_debug(NULL,
                       "%s:%d: ctx=[%p][%s] signalled\n",
@@ -319,8 +445,12 @@ static void mlt_slices_run(mlt_slices ctx, int jobs, mlt_slices_proc proc, void
                       ctx,
                       ctx->name);
     }
-
     pthread_mutex_unlock(&ctx->cond_mutex);
+
+    /* make sure no worker can find the run after it goes out of scope */
+    pthread_mutex_lock(&d->lock);
+    deque_remove(ctx, d, r);
+    pthread_mutex_unlock(&d->lock);
 }
 
 /** Get a global shared sliced threading context.
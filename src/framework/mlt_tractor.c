@@ -25,9 +25,11 @@
 #include "mlt_frame.h"
 #include "mlt_log.h"
 #include "mlt_multitrack.h"
+#include "mlt_slices.h"
 #include "mlt_transition.h"
 
 #include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -345,6 +347,484 @@ mlt_producer mlt_tractor_get_track(mlt_tractor self, int index)
     return mlt_multitrack_track(mlt_tractor_multitrack(self), index);
 }
 
+/** \brief the image request last seen for a track */
+
+typedef struct
+{
+    int64_t hint;           /**< the packed format, size and writable flag, see track_hint() */
+    mlt_properties request; /**< the properties a transition set on the frame before the request */
+} track_request;
+
+/** \brief the requests of all tracks of a tractor, used to render tracks concurrently */
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    mlt_tractor tractor;
+    int count;
+    track_request *tracks;
+} tractor_requests;
+
+/** \brief the track frames a tractor frame may render concurrently */
+
+typedef struct
+{
+    tractor_requests *requests;
+    int count;
+    mlt_frame *frames;
+    int *tracks;
+} tractor_parallel;
+
+static void tractor_requests_close(tractor_requests *requests)
+{
+    int i;
+    for (i = 0; i < requests->count; i++)
+        mlt_properties_close(requests->tracks[i].request);
+    free(requests->tracks);
+    pthread_mutex_destroy(&requests->mutex);
+    free(requests);
+}
+
+static void tractor_parallel_close(tractor_parallel *parallel)
+{
+    free(parallel->frames);
+    free(parallel->tracks);
+    free(parallel);
+}
+
+/** Pack an image request for a track into a hint.
+ *
+ * Bit 48 marks a request that did not change since the previous frame.
+ */
+
+static inline int64_t track_hint(mlt_image_format format, int width, int height, int writable)
+{
+    return ((int64_t) format << 50) | ((int64_t) !!writable << 49)
+           | ((int64_t) (width & 0xffffff) << 24) | (int64_t) (height & 0xffffff);
+}
+
+#define TRACK_HINT_STABLE ((int64_t) 1 << 48)
+
+/** Determine whether two sets of request properties are equal. */
+
+static int track_props_equal(mlt_properties a, mlt_properties b)
+{
+    int i, count;
+    if (!a || !b || (count = mlt_properties_count(a)) != mlt_properties_count(b))
+        return 0;
+    for (i = 0; i < count; i++) {
+        const char *value = mlt_properties_get(b, mlt_properties_get_name(a, i));
+        if (!value || strcmp(value, mlt_properties_get_value(a, i)))
+            return 0;
+    }
+    return 1;
+}
+
+/** Determine whether a frame property takes part in a request. */
+
+static inline int track_request_property(const char *name)
+{
+    return strcmp(name, "image_count") && strncmp(name, "_parallel_tracks.", 17);
+}
+
+/** Copy the values of the properties of a track frame.
+ *
+ * The copy is compared with the frame later to find every property that was
+ * set or changed since, not only those added.
+ */
+
+static mlt_properties track_snapshot(mlt_properties properties)
+{
+    mlt_properties snapshot = mlt_properties_new();
+    int i, count = mlt_properties_count(properties);
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (value && track_request_property(name))
+            mlt_properties_set(snapshot, name, value);
+    }
+    return snapshot;
+}
+
+/** Get the properties of a track frame that differ from a snapshot. */
+
+static mlt_properties track_changes(mlt_properties properties, mlt_properties snapshot)
+{
+    mlt_properties changes = mlt_properties_new();
+    int i, count = mlt_properties_count(properties);
+    for (i = 0; i < count; i++) {
+        const char *name = mlt_properties_get_name(properties, i);
+        const char *value = mlt_properties_get_value(properties, i);
+        if (value && track_request_property(name)) {
+            const char *before = snapshot ? mlt_properties_get(snapshot, name) : NULL;
+            if (!before || strcmp(before, value))
+                mlt_properties_set(changes, name, value);
+        }
+    }
+    return changes;
+}
+
+/** Render a track from a new frame when the image rendered ahead is not usable.
+ *
+ * Running the image stack of a frame twice would run stateful callbacks twice,
+ * so the track producer is asked for a new frame at the same position, which
+ * is then given the actual request. The multitrack lock keeps this from
+ * interleaving with the tractor seeking the track for the next frame.
+ * \private \memberof mlt_tractor_s
+ * \param self the track frame
+ * \param tractor the tractor
+ * \param track the track index
+ * \param request the properties the transition set on \p self, closed by this
+ * \return true on error
+ */
+
+static int track_get_fresh_image(mlt_frame self,
+                                 mlt_tractor tractor,
+                                 int track,
+                                 mlt_properties request,
+                                 uint8_t **buffer,
+                                 mlt_image_format *format,
+                                 int *width,
+                                 int *height,
+                                 int writable)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self);
+    mlt_multitrack multitrack = mlt_tractor_multitrack(tractor);
+    mlt_producer producer = mlt_multitrack_track(multitrack, track);
+    mlt_frame fresh = NULL;
+    int error = 1;
+    int i;
+
+    if (producer) {
+        mlt_service_lock(MLT_MULTITRACK_SERVICE(multitrack));
+        mlt_producer_seek(producer, mlt_frame_get_position(self));
+        mlt_service_get_frame(MLT_PRODUCER_SERVICE(producer), &fresh, 0);
+        mlt_service_unlock(MLT_MULTITRACK_SERVICE(multitrack));
+    }
+    if (fresh) {
+        mlt_properties fresh_properties = MLT_FRAME_PROPERTIES(fresh);
+        mlt_frame_set_position(fresh, mlt_frame_get_position(self));
+        mlt_properties_pass_list(fresh_properties, properties, "_speed, hide");
+        for (i = 0; i < mlt_properties_count(request); i++)
+            mlt_properties_set(fresh_properties,
+                               mlt_properties_get_name(request, i),
+                               mlt_properties_get_value(request, i));
+        error = mlt_frame_get_image(fresh, buffer, format, width, height, writable);
+        if (!error && *buffer) {
+            int size = 0;
+            uint8_t *alpha = mlt_frame_get_alpha_size(fresh, &size);
+            mlt_frame_set_image(self, *buffer, 0, NULL);
+            mlt_frame_set_alpha(self, alpha, size, NULL);
+            mlt_properties_pass_list(properties,
+                                     fresh_properties,
+                                     "aspect_ratio, progressive, distort, colorspace, full_range, "
+                                     "force_full_luma, top_field_first, color_trc");
+        }
+        mlt_properties_set_data(properties,
+                                "_parallel_tracks.fresh",
+                                fresh,
+                                0,
+                                (mlt_destructor) mlt_frame_close,
+                                NULL);
+    }
+    mlt_properties_close(request);
+    return error;
+}
+
+/** Record the image request a transition made of a track.
+ *
+ * This is pushed on top of the image stack of every track frame a transition
+ * pulls. Besides the format and size, it keeps the properties the transition
+ * set or changed on the frame, found by comparing all of them with a snapshot
+ * taken when the tractor assembled the frame. Together they predict the
+ * request for the next frame, and a track is rendered ahead of time only when
+ * that prediction held for the previous frame. If the actual request differs,
+ * the image rendered ahead is discarded and the track is rendered from a new
+ * frame.
+ */
+
+static int track_get_image(mlt_frame self,
+                           uint8_t **buffer,
+                           mlt_image_format *format,
+                           int *width,
+                           int *height,
+                           int writable)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(self);
+    tractor_requests *requests = mlt_frame_pop_service(self);
+    int track = mlt_frame_pop_service_int(self);
+    int rendered = track < 0;
+    int changed = 0;
+    int64_t hint = track_hint(*format, *width, *height, writable);
+    int i;
+
+    // Once rendered ahead, the properties rendering set are not part of the request.
+    if (rendered)
+        track = -1 - track;
+    mlt_properties request
+        = track_changes(properties,
+                        mlt_properties_get_data(properties,
+                                                rendered ? "_parallel_tracks.rendered"
+                                                         : "_parallel_tracks.base",
+                                                NULL));
+
+    pthread_mutex_lock(&requests->mutex);
+    if (track >= requests->count) {
+        requests->tracks = realloc(requests->tracks, (track + 1) * sizeof(track_request));
+        memset(&requests->tracks[requests->count],
+               0,
+               (track + 1 - requests->count) * sizeof(track_request));
+        requests->count = track + 1;
+    }
+    track_request *last = &requests->tracks[track];
+    if (rendered) {
+        // The predicted properties were set before rendering, so take their current values.
+        for (i = 0; last->request && i < mlt_properties_count(last->request); i++) {
+            const char *name = mlt_properties_get_name(last->request, i);
+            const char *value = mlt_properties_get(properties, name);
+            if (value)
+                mlt_properties_set(request, name, value);
+        }
+        changed = (last->hint & ~TRACK_HINT_STABLE) != hint
+                  || !track_props_equal(request, last->request);
+        if (changed) {
+            mlt_log_debug(NULL, "[tractor] track %d request changed after rendering ahead\n", track);
+            mlt_properties_close(last->request);
+            last->request = mlt_properties_new();
+            mlt_properties_inherit(last->request, request);
+            last->hint = hint;
+        } else {
+            mlt_properties_close(request);
+        }
+    } else {
+        if ((last->hint & ~TRACK_HINT_STABLE) == hint && track_props_equal(request, last->request))
+            hint |= TRACK_HINT_STABLE;
+        mlt_properties_close(last->request);
+        last->request = request;
+        last->hint = hint;
+    }
+    pthread_mutex_unlock(&requests->mutex);
+
+    if (changed)
+        return track_get_fresh_image(self,
+                                     requests->tractor,
+                                     track,
+                                     request,
+                                     buffer,
+                                     format,
+                                     width,
+                                     height,
+                                     writable);
+
+    // This is not an image of its own, so undo the count mlt_frame_get_image() took off.
+    mlt_properties_set_int(properties,
+                           "image_count",
+                           mlt_properties_get_int(properties, "image_count") + 1);
+    return mlt_frame_get_image(self, buffer, format, width, height, writable);
+}
+
+static void track_push_request(mlt_frame frame, tractor_requests *requests, int track)
+{
+    mlt_frame_push_service_int(frame, track);
+    mlt_frame_push_service(frame, requests);
+    mlt_frame_push_get_image(frame, track_get_image);
+}
+
+/** Get the request last seen for a track if it is stable.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param requests the requests of a tractor
+ * \param track the track index
+ * \param frame a frame on which to set the request properties, or NULL
+ * \return the hint, or 0 if there is none
+ */
+
+static int64_t track_predict(tractor_requests *requests, int track, mlt_frame frame)
+{
+    int64_t hint = 0;
+    int i;
+
+    pthread_mutex_lock(&requests->mutex);
+    if (track < requests->count && (requests->tracks[track].hint & TRACK_HINT_STABLE)) {
+        mlt_properties request = requests->tracks[track].request;
+        hint = requests->tracks[track].hint;
+        for (i = 0; frame && i < mlt_properties_count(request); i++)
+            mlt_properties_set(MLT_FRAME_PROPERTIES(frame),
+                               mlt_properties_get_name(request, i),
+                               mlt_properties_get_value(request, i));
+    }
+    pthread_mutex_unlock(&requests->mutex);
+    return hint;
+}
+
+/** Render the image of one track frame with its predicted request.
+ *
+ * \private \memberof mlt_tractor_s
+ */
+
+static int track_render_slice(int id, int index, int jobs, void *cookie)
+{
+    tractor_parallel *parallel = cookie;
+    mlt_frame frame = parallel->frames[index];
+    int track = parallel->tracks[index];
+    int64_t hint = track_predict(parallel->requests, track, frame);
+    mlt_image_format format = (hint >> 50) & 0xff;
+    int writable = (hint >> 49) & 1;
+    int width = (hint >> 24) & 0xffffff;
+    int height = hint & 0xffffff;
+    uint8_t *image = NULL;
+
+    mlt_frame_get_image(frame, &image, &format, &width, &height, writable);
+
+    // What changes from here on was set after rendering ahead.
+    mlt_properties_set_data(MLT_FRAME_PROPERTIES(frame),
+                            "_parallel_tracks.rendered",
+                            track_snapshot(MLT_FRAME_PROPERTIES(frame)),
+                            0,
+                            (mlt_destructor) mlt_properties_close,
+                            NULL);
+
+    // Check the prediction against the request the transition makes later.
+    track_push_request(frame, parallel->requests, -1 - track);
+    return 0;
+}
+
+/** Render the images of independent tracks concurrently.
+ *
+ * This runs before the output track frame pulls its transitions, so each
+ * transition finds its b frame already rendered and composites it in the
+ * usual order. Only tracks with a stable request take part; the others are
+ * rendered on demand as before.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param parallel the candidate track frames
+ */
+
+static void tractor_render_tracks(tractor_parallel *parallel)
+{
+    tractor_parallel ready = *parallel;
+    int i;
+
+    ready.frames = calloc(parallel->count, sizeof(mlt_frame));
+    ready.tracks = calloc(parallel->count, sizeof(int));
+    ready.count = 0;
+    for (i = 0; i < parallel->count; i++) {
+        int64_t hint = track_predict(parallel->requests, parallel->tracks[i], NULL);
+        mlt_image_format format = (hint >> 50) & 0xff;
+        if (hint && format != mlt_image_movit && format != mlt_image_opengl_texture) {
+            ready.frames[ready.count] = parallel->frames[i];
+            ready.tracks[ready.count++] = parallel->tracks[i];
+        }
+    }
+    if (ready.count > 1)
+        mlt_slices_run_normal(ready.count, track_render_slice, &ready);
+    free(ready.frames);
+    free(ready.tracks);
+}
+
+/** Determine whether a frame appears on the image stack of another. */
+
+static int frame_pulls(mlt_frame frame, mlt_frame other)
+{
+    mlt_deque stack = MLT_FRAME_IMAGE_STACK(frame);
+    int i;
+    for (i = 0; i < mlt_deque_count(stack); i++)
+        if (mlt_deque_peek(stack, i) == other)
+            return 1;
+    return 0;
+}
+
+/** Determine whether a filter is planted on a track of a tractor.
+ *
+ * A new frame from the track producer would miss such a filter.
+ */
+
+static int tractor_track_filtered(mlt_tractor self, int track)
+{
+    mlt_service service = mlt_service_producer(MLT_TRACTOR_SERVICE(self));
+    while (service) {
+        if (mlt_service_identify(service) == mlt_service_filter_type
+            && mlt_properties_get_int(MLT_SERVICE_PROPERTIES(service), "track") == track)
+            return 1;
+        service = mlt_service_producer(service);
+    }
+    return 0;
+}
+
+/** Find the track frames that can render concurrently.
+ *
+ * A track frame qualifies when a transition on another track pulls it, which
+ * means it appears on that frame's image stack, it pulls no track frame other
+ * than the one the tractor outputs, and no filter is planted on its track. The
+ * transition's own hook on the b frame only copies consumer properties from
+ * the a frame, and those of the output frame are final before any track
+ * renders. The image of such a frame then depends only on its own producer and
+ * filters.
+ *
+ * \private \memberof mlt_tractor_s
+ * \param self a tractor
+ * \param frame the frame of the tractor
+ * \param video the track frame the tractor outputs
+ * \param tracks the frames of each track
+ * \param count the number of entries in \p tracks
+ */
+
+static void tractor_parallel_setup(
+    mlt_tractor self, mlt_frame frame, mlt_frame video, mlt_frame *tracks, int count)
+{
+    mlt_properties properties = MLT_TRACTOR_PROPERTIES(self);
+    tractor_requests *requests = mlt_properties_get_data(properties, "_parallel_tracks", NULL);
+    tractor_parallel *parallel = calloc(1, sizeof(tractor_parallel));
+    int i, j;
+
+    if (!requests) {
+        requests = calloc(1, sizeof(tractor_requests));
+        pthread_mutex_init(&requests->mutex, NULL);
+        requests->tractor = self;
+        mlt_properties_set_data(properties,
+                                "_parallel_tracks",
+                                requests,
+                                0,
+                                (mlt_destructor) tractor_requests_close,
+                                NULL);
+    }
+    parallel->requests = requests;
+    parallel->frames = calloc(count, sizeof(mlt_frame));
+    parallel->tracks = calloc(count, sizeof(int));
+
+    for (i = 0; i < count; i++) {
+        int pulled = 0;
+        int pulls = 0;
+
+        if (tracks[i] == video || mlt_deque_count(MLT_FRAME_IMAGE_STACK(tracks[i])) == 0)
+            continue;
+        for (j = 0; j < count; j++) {
+            if (j != i) {
+                pulled |= frame_pulls(tracks[j], tracks[i]);
+                pulls |= tracks[j] != video && frame_pulls(tracks[i], tracks[j]);
+            }
+        }
+        if (pulled && !pulls && !tractor_track_filtered(self, i)) {
+            mlt_properties track_properties = MLT_FRAME_PROPERTIES(tracks[i]);
+            mlt_properties_set_data(track_properties,
+                                    "_parallel_tracks.base",
+                                    track_snapshot(track_properties),
+                                    0,
+                                    (mlt_destructor) mlt_properties_close,
+                                    NULL);
+            track_push_request(tracks[i], requests, i);
+            parallel->frames[parallel->count] = tracks[i];
+            parallel->tracks[parallel->count++] = i;
+        }
+    }
+    mlt_properties_set_data(MLT_FRAME_PROPERTIES(frame),
+                            "_parallel_tracks",
+                            parallel,
+                            0,
+                            (mlt_destructor) tractor_parallel_close,
+                            NULL);
+}
+
 static int producer_get_image(mlt_frame self,
                               uint8_t **buffer,
                               mlt_image_format *format,
@@ -373,6 +853,10 @@ static int producer_get_image(mlt_frame self,
                             NULL,
                             NULL);
 
+    tractor_parallel *parallel = mlt_properties_get_data(properties, "_parallel_tracks", NULL);
+    if (parallel)
+        tractor_render_tracks(parallel);
+
     mlt_frame_get_image(frame, buffer, format, width, height, writable);
     mlt_frame_set_image(self, *buffer, 0, NULL);
 
@@ -504,6 +988,10 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
             // Temporary properties
             mlt_properties temp_properties = NULL;
 
+            // The track frames, kept when tracks may render concurrently
+            int parallel_tracks = mlt_properties_get_int(properties, "parallel_tracks");
+            mlt_frame *tracks = NULL;
+
             // Get the multitrack's producer
             mlt_producer target = MLT_MULTITRACK_PRODUCER(multitrack);
             mlt_producer_seek(target, mlt_producer_frame(parent));
@@ -537,6 +1025,11 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
                 // Check for last track
                 done = mlt_properties_get_int(temp_properties, "last_track");
 
+                if (parallel_tracks && !done) {
+                    tracks = realloc(tracks, (i + 1) * sizeof(mlt_frame));
+                    tracks[i] = temp;
+                }
+
                 // Handle fx only tracks
                 if (mlt_properties_get_int(temp_properties, "fx_cut")) {
                     int hide = (video == NULL ? 1 : 0) | (audio == NULL ? 2 : 0);
@@ -577,6 +1070,12 @@ static int producer_get_frame(mlt_producer parent, mlt_frame_ptr frame, int trac
                 }
             }
 
+            if (tracks) {
+                if (video != NULL)
+                    tractor_parallel_setup(self, *frame, video, tracks, i - 1);
+                free(tracks);
+            }
+
             // Now stack callbacks
             if (audio != NULL) {
                 mlt_frame_push_audio(*frame, audio);
@@ -34,6 +34,9 @@
  * \properties \em multitrack holds a reference to the mulitrack object that a tractor manages
  * \properties \em field holds a reference to the field object that a tractor manages
  * \properties \em producer holds a reference to an encapsulated producer
+ * \properties \em parallel_tracks set to render the images of tracks that transitions
+ * composite concurrently, using the slices pool, before the transitions run. A track takes
+ * part once a transition requested its image the same way on two consecutive frames.
  */
 
 struct mlt_tractor_s
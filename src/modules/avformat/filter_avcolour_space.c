@@ -304,6 +304,9 @@ static int convert_image(mlt_frame frame,
         mlt_properties_set_int(properties, "format", output_format);
         mlt_properties_set_int(properties, "width", out_width);
         mlt_properties_set_int(properties, "height", out_height);
+        mlt_properties_set_int(properties,
+                               "image_conversions",
+                               mlt_properties_get_int(properties, "image_conversions") + 1);
     }
     return error;
 }
@@ -2066,6 +2066,9 @@ static void init_cache(mlt_properties properties, mlt_cache *cache)
     // set cache size if supplied
     if (*cache && cache_supplied)
         mlt_cache_set_size(*cache, cache_size);
+    // limit the memory used by the cache if supplied
+    if (*cache && mlt_properties_get(properties, "cache_bytes"))
+        mlt_cache_set_max_bytes(*cache, mlt_properties_get_int64(properties, "cache_bytes"));
 }
 
 /** Get an image from a frame.
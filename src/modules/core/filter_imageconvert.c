@@ -22,403 +22,520 @@
 #include <framework/mlt_image.h>
 #include <framework/mlt_log.h>
 #include <framework/mlt_pool.h>
+#include <framework/mlt_slices.h>
 
 #include <stdlib.h>
 
-/** This macro converts a YUV value to the RGB color space. */
-#define RGB2YUV_601_UNSCALED(r, g, b, y, u, v) \
-    y = (299 * r + 587 * g + 114 * b) >> 10; \
-    u = ((-169 * r - 331 * g + 500 * b) >> 10) + 128; \
-    v = ((500 * r - 419 * g - 81 * b) >> 10) + 128; \
-    y = y < 16 ? 16 : y; \
-    u = u < 16 ? 16 : u; \
-    v = v < 16 ? 16 : v; \
-    y = y > 235 ? 235 : y; \
-    u = u > 240 ? 240 : u; \
-    v = v > 240 ? 240 : v
-
-/** This macro converts a YUV value to the RGB color space. */
-#define YUV2RGB_601_UNSCALED(y, u, v, r, g, b) \
-    r = ((1024 * y + 1404 * (v - 128)) >> 10); \
-    g = ((1024 * y - 715 * (v - 128) - 345 * (u - 128)) >> 10); \
-    b = ((1024 * y + 1774 * (u - 128)) >> 10); \
-    r = r < 0 ? 0 : r > 255 ? 255 : r; \
-    g = g < 0 ? 0 : g > 255 ? 255 : g; \
-    b = b < 0 ? 0 : b > 255 ? 255 : b;
-
-#define SCALED 1
-#if SCALED
-#define RGB2YUV_601 RGB2YUV_601_SCALED
-#define YUV2RGB_601 YUV2RGB_601_SCALED
-#else
-#define RGB2YUV_601 RGB2YUV_601_UNSCALED
-#define YUV2RGB_601 YUV2RGB_601_UNSCALED
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
 #endif
 
-static void convert_yuv422_to_rgba(mlt_image src, mlt_image dst)
+/** The fixed-point coefficients for one YCbCr matrix and range.
+ *
+ * All values are scaled by 1024. The offsets and rounding are folded into
+ * the biases so that every conversion is a dot product followed by a shift.
+ */
+
+typedef struct
 {
-    int yy, uu, vv;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pAlpha = src->planes[3] + src->strides[3] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
-
-        if (pAlpha)
-            while (--total) {
-                yy = pSrc[0];
-                uu = pSrc[1];
-                vv = pSrc[3];
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[0] = r;
-                pDst[1] = g;
-                pDst[2] = b;
-                pDst[3] = *pAlpha++;
-                yy = pSrc[2];
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[4] = r;
-                pDst[5] = g;
-                pDst[6] = b;
-                pDst[7] = *pAlpha++;
-                pSrc += 4;
-                pDst += 8;
-            }
-        else
-            while (--total) {
-                yy = pSrc[0];
-                uu = pSrc[1];
-                vv = pSrc[3];
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[0] = r;
-                pDst[1] = g;
-                pDst[2] = b;
-                pDst[3] = 0xff;
-                yy = pSrc[2];
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[4] = r;
-                pDst[5] = g;
-                pDst[6] = b;
-                pDst[7] = 0xff;
-                pSrc += 4;
-                pDst += 8;
-            }
-    }
+    int y_scale; ///< YCbCr to RGB
+    int y_offset;
+    int r_v;
+    int g_u;
+    int g_v;
+    int b_u;
+    int rgb_bias;
+    int y_r; ///< RGB to YCbCr
+    int y_g;
+    int y_b;
+    int u_r;
+    int u_g;
+    int u_b;
+    int v_r;
+    int v_g;
+    int v_b;
+    int y_bias;
+    int uv_bias;
+} yuv_matrix;
+
+#define LIMITED(y, rv, gu, gv, bu, yr, yg, yb, ur, ug, ub, vr, vg, vb) \
+    {y, 16, rv, gu, gv, bu, 512, \
+     yr, yg, yb, ur, ug, ub, vr, vg, vb, (16 << 10) + 512, (128 << 10) + 512}
+#define FULL(y, rv, gu, gv, bu, yr, yg, yb, ur, ug, ub, vr, vg, vb) \
+    {y, 0, rv, gu, gv, bu, 512, yr, yg, yb, ur, ug, ub, vr, vg, vb, 512, (128 << 10) + 512}
+
+static const yuv_matrix yuv_matrices[3][2] = {
+    // ITU-R BT.601 limited range is the legacy YUV2RGB_601_SCALED and RGB2YUV_601_SCALED
+    // without rounding, which keeps the output of existing projects bit for bit.
+    {{1192, 16, 1634, -401, -832, 2066, 0,
+      263, 516, 100, -152, -300, 450, 450, -377, -73, 16 << 10, 128 << 10},
+     FULL(1024, 1436, -352, -731, 1815, 306, 601, 117, -173, -339, 512, 512, -429, -83)},
+    // ITU-R BT.709
+    {LIMITED(1192, 1836, -218, -546, 2163, 187, 629, 63, -103, -347, 450, 450, -409, -41),
+     FULL(1024, 1613, -192, -479, 1900, 218, 732, 74, -117, -395, 512, 512, -465, -47)},
+    // ITU-R BT.2020 non-constant luminance
+    {LIMITED(1192, 1719, -192, -666, 2193, 231, 596, 52, -126, -324, 450, 450, -414, -36),
+     FULL(1024, 1510, -169, -585, 1927, 269, 694, 61, -143, -369, 512, 512, -471, -41)},
+};
+
+#undef LIMITED
+#undef FULL
+
+static const yuv_matrix *yuv_matrix_get(int colorspace, int full_range)
+{
+    int index = colorspace == 709 ? 1 : colorspace == 2020 ? 2 : 0;
+    return &yuv_matrices[index][full_range ? 1 : 0];
 }
 
-static void convert_yuv422_to_rgb(mlt_image src, mlt_image dst)
+/* The per-line kernels are plain loops that the compiler vectorizes; see
+ * CMakeLists.txt. On x86-64 each one is also built for SSE4.1 and AVX2 and
+ * picked at load time for the running CPU. NEON is always present on
+ * AArch64, so the default build already uses it there.
+ */
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)
+#if __has_attribute(target_clones)
+#define CONVERT_KERNEL __attribute__((target_clones("avx2", "sse4.1", "default")))
+#endif
+#endif
+#ifndef CONVERT_KERNEL
+#define CONVERT_KERNEL
+#endif
+
+static inline uint8_t clamp_byte(int value)
 {
-    int yy, uu, vv;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
-        while (--total) {
-            yy = pSrc[0];
-            uu = pSrc[1];
-            vv = pSrc[3];
-            YUV2RGB_601(yy, uu, vv, r, g, b);
-            pDst[0] = r;
-            pDst[1] = g;
-            pDst[2] = b;
-            yy = pSrc[2];
-            YUV2RGB_601(yy, uu, vv, r, g, b);
-            pDst[3] = r;
-            pDst[4] = g;
-            pDst[5] = b;
-            pSrc += 4;
-            pDst += 6;
-        }
-    }
+    return value < 0 ? 0 : value > 255 ? 255 : value;
 }
 
-static void convert_rgba_to_yuv422(mlt_image src, mlt_image dst)
+CONVERT_KERNEL
+static void yuv422_to_rgba_line(const uint8_t *restrict src,
+                                const uint8_t *restrict alpha,
+                                uint8_t *restrict dst,
+                                int pairs,
+                                const yuv_matrix *m)
 {
-    int y0, y1, u0, u1, v0, v1;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-    mlt_image_alloc_alpha(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        uint8_t *pAlpha = dst->planes[3] + dst->strides[3] * line;
-        int j = src->width / 2 + 1;
-        while (--j) {
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            *pAlpha++ = *pSrc++;
-            RGB2YUV_601(r, g, b, y0, u0, v0);
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            *pAlpha++ = *pSrc++;
-            RGB2YUV_601(r, g, b, y1, u1, v1);
-            *pDst++ = y0;
-            *pDst++ = (u0 + u1) >> 1;
-            *pDst++ = y1;
-            *pDst++ = (v0 + v1) >> 1;
+    const int y_scale = m->y_scale, y_offset = m->y_offset, bias = m->rgb_bias;
+    const int r_v = m->r_v, g_u = m->g_u, g_v = m->g_v, b_u = m->b_u;
+
+    if (alpha)
+        for (int i = 0; i < pairs; i++) {
+            int y0 = y_scale * (src[4 * i] - y_offset) + bias;
+            int y1 = y_scale * (src[4 * i + 2] - y_offset) + bias;
+            int u = src[4 * i + 1] - 128;
+            int v = src[4 * i + 3] - 128;
+            int r = r_v * v, g = g_u * u + g_v * v, b = b_u * u;
+            dst[8 * i] = clamp_byte((y0 + r) >> 10);
+            dst[8 * i + 1] = clamp_byte((y0 + g) >> 10);
+            dst[8 * i + 2] = clamp_byte((y0 + b) >> 10);
+            dst[8 * i + 3] = alpha[2 * i];
+            dst[8 * i + 4] = clamp_byte((y1 + r) >> 10);
+            dst[8 * i + 5] = clamp_byte((y1 + g) >> 10);
+            dst[8 * i + 6] = clamp_byte((y1 + b) >> 10);
+            dst[8 * i + 7] = alpha[2 * i + 1];
         }
-        if (src->width % 2) {
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            *pAlpha++ = *pSrc++;
-            RGB2YUV_601(r, g, b, y0, u0, v0);
-            *pDst++ = y0;
-            *pDst++ = u0;
+    else
+        for (int i = 0; i < pairs; i++) {
+            int y0 = y_scale * (src[4 * i] - y_offset) + bias;
+            int y1 = y_scale * (src[4 * i + 2] - y_offset) + bias;
+            int u = src[4 * i + 1] - 128;
+            int v = src[4 * i + 3] - 128;
+            int r = r_v * v, g = g_u * u + g_v * v, b = b_u * u;
+            dst[8 * i] = clamp_byte((y0 + r) >> 10);
+            dst[8 * i + 1] = clamp_byte((y0 + g) >> 10);
+            dst[8 * i + 2] = clamp_byte((y0 + b) >> 10);
+            dst[8 * i + 3] = 0xff;
+            dst[8 * i + 4] = clamp_byte((y1 + r) >> 10);
+            dst[8 * i + 5] = clamp_byte((y1 + g) >> 10);
+            dst[8 * i + 6] = clamp_byte((y1 + b) >> 10);
+            dst[8 * i + 7] = 0xff;
         }
-    }
 }
 
-static void convert_rgb_to_yuv422(mlt_image src, mlt_image dst)
+CONVERT_KERNEL
+static void yuv420p_to_rgba_line(const uint8_t *restrict src_y,
+                                 const uint8_t *restrict src_u,
+                                 const uint8_t *restrict src_v,
+                                 const uint8_t *restrict alpha,
+                                 uint8_t *restrict dst,
+                                 int pairs,
+                                 const yuv_matrix *m)
 {
-    int y0, y1, u0, u1, v0, v1;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int j = src->width / 2 + 1;
-        while (--j) {
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            RGB2YUV_601(r, g, b, y0, u0, v0);
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            RGB2YUV_601(r, g, b, y1, u1, v1);
-            *pDst++ = y0;
-            *pDst++ = (u0 + u1) >> 1;
-            *pDst++ = y1;
-            *pDst++ = (v0 + v1) >> 1;
+    const int y_scale = m->y_scale, y_offset = m->y_offset, bias = m->rgb_bias;
+    const int r_v = m->r_v, g_u = m->g_u, g_v = m->g_v, b_u = m->b_u;
+
+    if (alpha)
+        for (int i = 0; i < pairs; i++) {
+            int y0 = y_scale * (src_y[2 * i] - y_offset) + bias;
+            int y1 = y_scale * (src_y[2 * i + 1] - y_offset) + bias;
+            int u = src_u[i] - 128;
+            int v = src_v[i] - 128;
+            int r = r_v * v, g = g_u * u + g_v * v, b = b_u * u;
+            dst[8 * i] = clamp_byte((y0 + r) >> 10);
+            dst[8 * i + 1] = clamp_byte((y0 + g) >> 10);
+            dst[8 * i + 2] = clamp_byte((y0 + b) >> 10);
+            dst[8 * i + 3] = alpha[2 * i];
+            dst[8 * i + 4] = clamp_byte((y1 + r) >> 10);
+            dst[8 * i + 5] = clamp_byte((y1 + g) >> 10);
+            dst[8 * i + 6] = clamp_byte((y1 + b) >> 10);
+            dst[8 * i + 7] = alpha[2 * i + 1];
         }
-        if (src->width % 2) {
-            r = *pSrc++;
-            g = *pSrc++;
-            b = *pSrc++;
-            RGB2YUV_601(r, g, b, y0, u0, v0);
-            *pDst++ = y0;
-            *pDst++ = u0;
+    else
+        for (int i = 0; i < pairs; i++) {
+            int y0 = y_scale * (src_y[2 * i] - y_offset) + bias;
+            int y1 = y_scale * (src_y[2 * i + 1] - y_offset) + bias;
+            int u = src_u[i] - 128;
+            int v = src_v[i] - 128;
+            int r = r_v * v, g = g_u * u + g_v * v, b = b_u * u;
+            dst[8 * i] = clamp_byte((y0 + r) >> 10);
+            dst[8 * i + 1] = clamp_byte((y0 + g) >> 10);
+            dst[8 * i + 2] = clamp_byte((y0 + b) >> 10);
+            dst[8 * i + 3] = 0xff;
+            dst[8 * i + 4] = clamp_byte((y1 + r) >> 10);
+            dst[8 * i + 5] = clamp_byte((y1 + g) >> 10);
+            dst[8 * i + 6] = clamp_byte((y1 + b) >> 10);
+            dst[8 * i + 7] = 0xff;
         }
+}
+
+/** Convert one line of RGBA to YUV 4:2:2.
+ *
+ * The chroma of each pair is the average of its two pixels. An odd last
+ * pixel keeps its own chroma. The alpha channel is copied to \p alpha if
+ * it is not NULL.
+ */
+
+CONVERT_KERNEL
+static void rgba_to_yuv422_line(const uint8_t *restrict src,
+                                uint8_t *restrict dst,
+                                uint8_t *restrict alpha,
+                                int width,
+                                const yuv_matrix *m)
+{
+    const int y_r = m->y_r, y_g = m->y_g, y_b = m->y_b, y_bias = m->y_bias;
+    const int u_r = m->u_r, u_g = m->u_g, u_b = m->u_b;
+    const int v_r = m->v_r, v_g = m->v_g, v_b = m->v_b, uv_bias = m->uv_bias;
+    int pairs = width / 2;
+
+    for (int i = 0; i < pairs; i++) {
+        int r0 = src[8 * i], g0 = src[8 * i + 1], b0 = src[8 * i + 2];
+        int r1 = src[8 * i + 4], g1 = src[8 * i + 5], b1 = src[8 * i + 6];
+        int u0 = clamp_byte((u_r * r0 + u_g * g0 + u_b * b0 + uv_bias) >> 10);
+        int u1 = clamp_byte((u_r * r1 + u_g * g1 + u_b * b1 + uv_bias) >> 10);
+        int v0 = clamp_byte((v_r * r0 + v_g * g0 + v_b * b0 + uv_bias) >> 10);
+        int v1 = clamp_byte((v_r * r1 + v_g * g1 + v_b * b1 + uv_bias) >> 10);
+        dst[4 * i] = clamp_byte((y_r * r0 + y_g * g0 + y_b * b0 + y_bias) >> 10);
+        dst[4 * i + 1] = (u0 + u1) >> 1;
+        dst[4 * i + 2] = clamp_byte((y_r * r1 + y_g * g1 + y_b * b1 + y_bias) >> 10);
+        dst[4 * i + 3] = (v0 + v1) >> 1;
+    }
+    if (alpha)
+        for (int i = 0; i < pairs * 2; i++)
+            alpha[i] = src[4 * i + 3];
+
+    if (width % 2) {
+        const uint8_t *s = src + 4 * (width - 1);
+        dst += 4 * pairs;
+        dst[0] = clamp_byte((y_r * s[0] + y_g * s[1] + y_b * s[2] + y_bias) >> 10);
+        dst[1] = clamp_byte((u_r * s[0] + u_g * s[1] + u_b * s[2] + uv_bias) >> 10);
+        if (alpha)
+            alpha[width - 1] = s[3];
     }
 }
 
-static void convert_yuv420p_to_yuv422(mlt_image src, mlt_image dst)
+CONVERT_KERNEL
+static void rgba_to_rgb_line(const uint8_t *restrict src,
+                             uint8_t *restrict dst,
+                             uint8_t *restrict alpha,
+                             int width)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_yuv422, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
-        uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
-        uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int j = src->width / 2 + 1;
-        while (--j) {
-            *pDst++ = *pSrcY++;
-            *pDst++ = *pSrcU++;
-            *pDst++ = *pSrcY++;
-            *pDst++ = *pSrcV++;
-        }
+    for (int i = 0; i < width; i++) {
+        dst[3 * i] = src[4 * i];
+        dst[3 * i + 1] = src[4 * i + 1];
+        dst[3 * i + 2] = src[4 * i + 2];
     }
+    if (alpha)
+        for (int i = 0; i < width; i++)
+            alpha[i] = src[4 * i + 3];
 }
 
-static void convert_yuv420p_to_rgb(mlt_image src, mlt_image dst)
+/* Compilers do not vectorize loads of 3 byte pixels well, so widening RGB
+ * to RGBA is written by hand. It returns the number of pixels done and
+ * leaves the rest of the line to the scalar loop.
+ */
+#if defined(__x86_64__) && defined(__GNUC__)
+
+__attribute__((target("ssse3"))) static int rgb_to_rgba_ssse3(const uint8_t *src,
+                                                              const uint8_t *alpha,
+                                                              uint8_t *dst,
+                                                              int width)
 {
-    int yy, uu, vv;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
-        uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
-        uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
-        while (--total) {
-            yy = *pSrcY++;
-            uu = *pSrcU++;
-            vv = *pSrcV++;
-            YUV2RGB_601(yy, uu, vv, r, g, b);
-            pDst[0] = r;
-            pDst[1] = g;
-            pDst[2] = b;
-            yy = *pSrcY++;
-            YUV2RGB_601(yy, uu, vv, r, g, b);
-            pDst[3] = r;
-            pDst[4] = g;
-            pDst[5] = b;
-            pDst += 6;
+    const __m128i rgb = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i opaque = _mm_set1_epi32(0xff000000);
+    int i = 0;
+
+    // The last load of each block reads 4 bytes beyond it.
+    for (; 3 * i + 52 <= 3 * width; i += 16) {
+        const uint8_t *s = src + 3 * i;
+        __m128i p0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) s), rgb);
+        __m128i p1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 12)), rgb);
+        __m128i p2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 24)), rgb);
+        __m128i p3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (s + 36)), rgb);
+        if (alpha) {
+            __m128i a = _mm_loadu_si128((const __m128i *) (alpha + i));
+            __m128i lo = _mm_unpacklo_epi8(_mm_setzero_si128(), a);
+            __m128i hi = _mm_unpackhi_epi8(_mm_setzero_si128(), a);
+            p0 = _mm_or_si128(p0, _mm_unpacklo_epi16(_mm_setzero_si128(), lo));
+            p1 = _mm_or_si128(p1, _mm_unpackhi_epi16(_mm_setzero_si128(), lo));
+            p2 = _mm_or_si128(p2, _mm_unpacklo_epi16(_mm_setzero_si128(), hi));
+            p3 = _mm_or_si128(p3, _mm_unpackhi_epi16(_mm_setzero_si128(), hi));
+        } else {
+            p0 = _mm_or_si128(p0, opaque);
+            p1 = _mm_or_si128(p1, opaque);
+            p2 = _mm_or_si128(p2, opaque);
+            p3 = _mm_or_si128(p3, opaque);
         }
+        _mm_storeu_si128((__m128i *) (dst + 4 * i), p0);
+        _mm_storeu_si128((__m128i *) (dst + 4 * i + 16), p1);
+        _mm_storeu_si128((__m128i *) (dst + 4 * i + 32), p2);
+        _mm_storeu_si128((__m128i *) (dst + 4 * i + 48), p3);
     }
+    return i;
 }
 
-static void convert_yuv420p_to_rgba(mlt_image src, mlt_image dst)
+#elif defined(__aarch64__)
+
+static int rgb_to_rgba_neon(const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width)
 {
-    int yy, uu, vv;
-    int r, g, b;
-
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrcY = src->planes[0] + src->strides[0] * line;
-        uint8_t *pSrcU = src->planes[1] + src->strides[1] * line / 2;
-        uint8_t *pSrcV = src->planes[2] + src->strides[2] * line / 2;
-        uint8_t *pSrcA = src->planes[3] + src->strides[3] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width / 2 + 1;
-        if (pSrcA)
-            while (--total) {
-                yy = *pSrcY++;
-                uu = *pSrcU++;
-                vv = *pSrcV++;
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[0] = r;
-                pDst[1] = g;
-                pDst[2] = b;
-                pDst[3] = *pSrcA++;
-                yy = *pSrcY++;
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[4] = r;
-                pDst[5] = g;
-                pDst[6] = b;
-                pDst[7] = *pSrcA++;
-                pDst += 8;
-            }
-        else
-            while (--total) {
-                yy = *pSrcY++;
-                uu = *pSrcU++;
-                vv = *pSrcV++;
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[0] = r;
-                pDst[1] = g;
-                pDst[2] = b;
-                pDst[3] = 0xff;
-                yy = *pSrcY++;
-                YUV2RGB_601(yy, uu, vv, r, g, b);
-                pDst[4] = r;
-                pDst[5] = g;
-                pDst[6] = b;
-                pDst[7] = 0xff;
-                pDst += 8;
-            }
+    int i = 0;
+
+    for (; i + 16 <= width; i += 16) {
+        uint8x16x3_t in = vld3q_u8(src + 3 * i);
+        uint8x16x4_t out = {{in.val[0],
+                             in.val[1],
+                             in.val[2],
+                             alpha ? vld1q_u8(alpha + i) : vdupq_n_u8(0xff)}};
+        vst4q_u8(dst + 4 * i, out);
     }
+    return i;
 }
 
-static void convert_yuv422_to_yuv420p(mlt_image src, mlt_image dst)
+#endif
+
+static void rgb_to_rgba_line(const uint8_t *src, const uint8_t *alpha, uint8_t *dst, int width)
 {
-    int lines = src->height;
-    int pixels = src->width;
-
-    mlt_image_set_values(dst, NULL, mlt_image_yuv420p, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    // Y
-    for (int line = 0; line < lines; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        for (int pixel = 0; pixel < pixels; pixel++) {
-            *pDst++ = *pSrc;
-            pSrc += 2;
-        }
+    int i = 0;
+
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("ssse3"))
+        i = rgb_to_rgba_ssse3(src, alpha, dst, width);
+#elif defined(__aarch64__)
+    i = rgb_to_rgba_neon(src, alpha, dst, width);
+#endif
+    for (; i < width; i++) {
+        dst[4 * i] = src[3 * i];
+        dst[4 * i + 1] = src[3 * i + 1];
+        dst[4 * i + 2] = src[3 * i + 2];
+        dst[4 * i + 3] = alpha ? alpha[i] : 0xff;
     }
+}
 
-    lines = src->height / 2;
-    pixels = src->width / 2;
+CONVERT_KERNEL
+static void yuv420p_to_yuv422_line(const uint8_t *restrict src_y,
+                                   const uint8_t *restrict src_u,
+                                   const uint8_t *restrict src_v,
+                                   uint8_t *restrict dst,
+                                   int pairs)
+{
+    for (int i = 0; i < pairs; i++) {
+        dst[4 * i] = src_y[2 * i];
+        dst[4 * i + 1] = src_u[i];
+        dst[4 * i + 2] = src_y[2 * i + 1];
+        dst[4 * i + 3] = src_v[i];
+    }
+}
 
-    // U
-    for (int line = 0; line < lines; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line * 2 + 1;
-        uint8_t *pDst = dst->planes[1] + dst->strides[1] * line;
-        for (int pixel = 0; pixel < pixels; pixel++) {
-            *pDst++ = *pSrc;
-            pSrc += 4;
-        }
+CONVERT_KERNEL
+static void yuv422_to_y_line(const uint8_t *restrict src, uint8_t *restrict dst, int width)
+{
+    for (int i = 0; i < width; i++)
+        dst[i] = src[2 * i];
+}
+
+CONVERT_KERNEL
+static void yuv422_to_uv_line(const uint8_t *restrict src,
+                              uint8_t *restrict dst_u,
+                              uint8_t *restrict dst_v,
+                              int pairs)
+{
+    for (int i = 0; i < pairs; i++) {
+        dst_u[i] = src[4 * i + 1];
+        dst_v[i] = src[4 * i + 3];
     }
+}
+
+typedef struct
+{
+    mlt_image src;
+    mlt_image dst;
+    const yuv_matrix *matrix;
+} convert_desc;
+
+/** The number of pixels packed RGB goes through RGBA at a time */
+#define CHUNK 256
+
+#define LINE(image, plane, line) \
+    ((image)->planes[plane] ? (image)->planes[plane] + (image)->strides[plane] * (line) : NULL)
+
+static void convert_yuv422_to_rgba(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        yuv422_to_rgba_line(LINE(src, 0, line),
+                            LINE(src, 3, line),
+                            LINE(dst, 0, line),
+                            src->width / 2,
+                            desc->matrix);
+}
 
-    // V
-    for (int line = 0; line < lines; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line * 2 + 3;
-        uint8_t *pDst = dst->planes[2] + dst->strides[2] * line;
-        for (int pixel = 0; pixel < pixels; pixel++) {
-            *pDst++ = *pSrc;
-            pSrc += 4;
+static void convert_yuv422_to_rgb(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    uint8_t rgba[CHUNK * 4];
+    int width = src->width / 2 * 2;
+
+    for (int line = start; line < end; line++) {
+        uint8_t *s = LINE(src, 0, line);
+        uint8_t *d = LINE(dst, 0, line);
+        for (int x = 0; x < width; x += CHUNK) {
+            int n = MIN(CHUNK, width - x);
+            yuv422_to_rgba_line(s + 2 * x, NULL, rgba, n / 2, desc->matrix);
+            rgba_to_rgb_line(rgba, d + 3 * x, NULL, n);
         }
     }
 }
 
-static void convert_rgb_to_rgba(mlt_image src, mlt_image dst)
+static void convert_rgba_to_yuv422(convert_desc *desc, int start, int end)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_rgba, src->width, src->height);
-    mlt_image_alloc_data(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pAlpha = src->planes[3] + src->strides[3] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        int total = src->width + 1;
-        if (pAlpha)
-            while (--total) {
-                *pDst++ = pSrc[0];
-                *pDst++ = pSrc[1];
-                *pDst++ = pSrc[2];
-                *pDst++ = *pAlpha++;
-                pSrc += 3;
-            }
-        else
-            while (--total) {
-                *pDst++ = pSrc[0];
-                *pDst++ = pSrc[1];
-                *pDst++ = pSrc[2];
-                *pDst++ = 0xff;
-                pSrc += 3;
-            }
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        rgba_to_yuv422_line(LINE(src, 0, line),
+                            LINE(dst, 0, line),
+                            LINE(dst, 3, line),
+                            src->width,
+                            desc->matrix);
+}
+
+static void convert_rgb_to_yuv422(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    uint8_t rgba[CHUNK * 4];
+
+    for (int line = start; line < end; line++) {
+        uint8_t *s = LINE(src, 0, line);
+        uint8_t *d = LINE(dst, 0, line);
+        for (int x = 0; x < src->width; x += CHUNK) {
+            int n = MIN(CHUNK, src->width - x);
+            rgb_to_rgba_line(s + 3 * x, NULL, rgba, n);
+            rgba_to_yuv422_line(rgba, d + 2 * x, NULL, n, desc->matrix);
+        }
     }
 }
 
-static void convert_rgba_to_rgb(mlt_image src, mlt_image dst)
+static void convert_yuv420p_to_yuv422(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        yuv420p_to_yuv422_line(LINE(src, 0, line),
+                               LINE(src, 1, line / 2),
+                               LINE(src, 2, line / 2),
+                               LINE(dst, 0, line),
+                               src->width / 2);
+}
+
+static void convert_yuv420p_to_rgb(convert_desc *desc, int start, int end)
 {
-    mlt_image_set_values(dst, NULL, mlt_image_rgb, src->width, src->height);
-    mlt_image_alloc_data(dst);
-    mlt_image_alloc_alpha(dst);
-
-    for (int line = 0; line < src->height; line++) {
-        uint8_t *pSrc = src->planes[0] + src->strides[0] * line;
-        uint8_t *pDst = dst->planes[0] + dst->strides[0] * line;
-        uint8_t *pAlpha = dst->planes[3] + dst->strides[3] * line;
-        int total = src->width + 1;
-        while (--total) {
-            *pDst++ = pSrc[0];
-            *pDst++ = pSrc[1];
-            *pDst++ = pSrc[2];
-            *pAlpha++ = pSrc[3];
-            pSrc += 4;
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    uint8_t rgba[CHUNK * 4];
+    int width = src->width / 2 * 2;
+
+    for (int line = start; line < end; line++) {
+        uint8_t *y = LINE(src, 0, line);
+        uint8_t *u = LINE(src, 1, line / 2);
+        uint8_t *v = LINE(src, 2, line / 2);
+        uint8_t *d = LINE(dst, 0, line);
+        for (int x = 0; x < width; x += CHUNK) {
+            int n = MIN(CHUNK, width - x);
+            yuv420p_to_rgba_line(y + x, u + x / 2, v + x / 2, NULL, rgba, n / 2, desc->matrix);
+            rgba_to_rgb_line(rgba, d + 3 * x, NULL, n);
         }
     }
 }
 
-typedef void (*conversion_function)(mlt_image src, mlt_image dst);
+static void convert_yuv420p_to_rgba(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        yuv420p_to_rgba_line(LINE(src, 0, line),
+                             LINE(src, 1, line / 2),
+                             LINE(src, 2, line / 2),
+                             LINE(src, 3, line),
+                             LINE(dst, 0, line),
+                             src->width / 2,
+                             desc->matrix);
+}
+
+static void convert_yuv422_to_yuv420p(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    // Slices start on an even line, so each owns the chroma of its lines.
+    for (int line = start; line < end; line++)
+        yuv422_to_y_line(LINE(src, 0, line), LINE(dst, 0, line), src->width);
+    for (int line = start / 2; line < MIN(end, src->height) / 2; line++)
+        yuv422_to_uv_line(LINE(src, 0, line * 2),
+                          LINE(dst, 1, line),
+                          LINE(dst, 2, line),
+                          src->width / 2);
+}
+
+static void convert_rgb_to_rgba(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        rgb_to_rgba_line(LINE(src, 0, line), LINE(src, 3, line), LINE(dst, 0, line), src->width);
+}
+
+static void convert_rgba_to_rgb(convert_desc *desc, int start, int end)
+{
+    mlt_image src = desc->src;
+    mlt_image dst = desc->dst;
+
+    for (int line = start; line < end; line++)
+        rgba_to_rgb_line(LINE(src, 0, line), LINE(dst, 0, line), LINE(dst, 3, line), src->width);
+}
+
+#undef LINE
+#undef CHUNK
+
+typedef void (*conversion_function)(convert_desc *desc, int start, int end);
 
 static conversion_function conversion_matrix[mlt_image_invalid - 1][mlt_image_invalid - 1] = {
     {NULL, convert_rgb_to_rgba, convert_rgb_to_yuv422, NULL, NULL, NULL, NULL},
@@ -436,6 +553,26 @@ static conversion_function conversion_matrix[mlt_image_invalid - 1][mlt_image_in
     {NULL, NULL, NULL, NULL, NULL, NULL, NULL},
 };
 
+typedef struct
+{
+    convert_desc desc;
+    conversion_function converter;
+} convert_slice_desc;
+
+static int convert_slice(int id, int index, int jobs, void *cookie)
+{
+    (void) id; // unused
+    convert_slice_desc *ctx = cookie;
+    int height = ctx->desc.src->height;
+    int start = 0;
+    // Slice whole pairs of lines so 4:2:0 chroma lines are never shared.
+    int size = mlt_slices_size_slice(jobs, index, (height + 1) / 2, &start);
+
+    if (size > 0)
+        ctx->converter(&ctx->desc, start * 2, MIN(height, (start + size) * 2));
+    return 0;
+}
+
 static int convert_image(mlt_frame frame,
                          uint8_t **buffer,
                          mlt_image_format *format,
@@ -448,16 +585,22 @@ static int convert_image(mlt_frame frame,
 
     if (*format != requested_format) {
         conversion_function converter = conversion_matrix[*format - 1][requested_format - 1];
+        int colorspace = mlt_properties_get_int(properties, "colorspace");
+        int full_range = mlt_properties_get_int(properties, "full_range");
 
         mlt_log_debug(NULL,
-                      "[filter imageconvert] %s -> %s @ %dx%d\n",
+                      "[filter imageconvert] %s -> %s @ %dx%d space %d full %d\n",
                       mlt_image_format_name(*format),
                       mlt_image_format_name(requested_format),
                       width,
-                      height);
+                      height,
+                      colorspace,
+                      full_range);
         if (converter) {
             struct mlt_image_s src;
             struct mlt_image_s dst;
+            convert_slice_desc ctx = {{&src, &dst, yuv_matrix_get(colorspace, full_range)},
+                                      converter};
             mlt_image_set_values(&src, *buffer, *format, width, height);
             if (requested_format == mlt_image_rgba && mlt_frame_get_alpha(frame)) {
                 // imageconvert leaves the alpha buffer alone except in the case of rgba.
@@ -466,7 +609,18 @@ static int convert_image(mlt_frame frame,
                 src.planes[3] = mlt_frame_get_alpha(frame);
                 src.strides[3] = src.width;
             }
-            converter(&src, &dst);
+            mlt_image_set_values(&dst, NULL, requested_format, width, height);
+            mlt_image_alloc_data(&dst);
+            if (*format == mlt_image_rgba)
+                mlt_image_alloc_alpha(&dst);
+
+            // Small images are not worth waking the other threads for.
+            int jobs = CLAMP(height / 64, 1, MAX(1, mlt_slices_count_normal()));
+            if (jobs == 1)
+                convert_slice(0, 0, 1, &ctx);
+            else
+                mlt_slices_run_normal(jobs, convert_slice, &ctx);
+
             mlt_frame_set_image(frame, dst.data, 0, dst.release_data);
             if (requested_format == mlt_image_rgba) {
                 // Clear the alpha buffer on the frame
@@ -476,6 +630,9 @@ static int convert_image(mlt_frame frame,
             }
             *buffer = dst.data;
             *format = dst.format;
+            mlt_properties_set_int(properties,
+                                   "image_conversions",
+                                   mlt_properties_get_int(properties, "image_conversions") + 1);
         } else {
             mlt_log_error(NULL,
                           "imageconvert: no conversion from %s to %s\n",
@@ -31,6 +31,7 @@
  *
  * image scaler implementations are expected to support the following in and out formats:
  * yuv422 -> yuv422
+ * yuv420p, yuv422p16, yuv420p10 and yuv444p10 to themselves
  * rgb -> rgb
  * rgba -> rgba
  * rgb -> yuv422
@@ -45,6 +46,62 @@ typedef int (*image_scaler)(mlt_frame frame,
                             int owidth,
                             int oheight);
 
+static int is_planar(mlt_image_format format)
+{
+    return format == mlt_image_yuv420p || format == mlt_image_yuv422p16
+           || format == mlt_image_yuv420p10 || format == mlt_image_yuv444p10;
+}
+
+/** Scale each plane of a planar image using nearest neighbour sampling.
+*/
+
+static int scale_planar(mlt_frame frame,
+                        uint8_t **image,
+                        mlt_image_format *format,
+                        int iwidth,
+                        int iheight,
+                        int owidth,
+                        int oheight)
+{
+    struct mlt_image_s input, output;
+    int plane;
+
+    mlt_image_set_values(&input, *image, *format, iwidth, iheight);
+    mlt_image_set_values(&output, NULL, *format, owidth, oheight);
+    mlt_image_alloc_data(&output);
+
+    for (plane = 0; plane < 3; plane++) {
+        int in_width, in_height, out_width, out_height, i, j, x, y;
+        int bytes = mlt_image_plane_dimensions(&input, plane, &in_width, &in_height);
+        mlt_image_plane_dimensions(&output, plane, &out_width, &out_height);
+        if (!bytes || !out_width || !out_height)
+            break;
+
+        int ox = (in_width << 16) / out_width;
+        int oy = (in_height << 16) / out_height;
+
+        for (i = 0, y = (oy >> 1); i < out_height; i++, y += oy) {
+            uint8_t *in_line = input.planes[plane] + (y >> 16) * input.strides[plane];
+            uint8_t *out_line = output.planes[plane] + i * output.strides[plane];
+            if (bytes == 2) {
+                uint16_t *in = (uint16_t *) in_line;
+                uint16_t *out = (uint16_t *) out_line;
+                for (j = 0, x = (ox >> 1); j < out_width; j++, x += ox)
+                    *out++ = in[x >> 16];
+            } else {
+                for (j = 0, x = (ox >> 1); j < out_width; j++, x += ox)
+                    *out_line++ = in_line[x >> 16];
+            }
+        }
+    }
+
+    // Now update the frame
+    mlt_frame_set_image(frame, output.data, mlt_image_calculate_size(&output), output.release_data);
+    *image = output.data;
+
+    return 0;
+}
+
 static int filter_scale(mlt_frame frame,
                         uint8_t **image,
                         mlt_image_format *format,
@@ -53,6 +110,9 @@ static int filter_scale(mlt_frame frame,
                         int owidth,
                         int oheight)
 {
+    if (is_planar(*format))
+        return scale_planar(frame, image, format, iwidth, iheight, owidth, oheight);
+
     // Create the output image
     uint8_t *output = mlt_pool_alloc(owidth * (oheight + 1) * 2);
 
@@ -218,8 +278,9 @@ static int filter_get_image(mlt_frame frame,
         if (iheight != oheight && (strcmp(interps, "nearest") || (iheight % oheight != 0)))
             mlt_properties_set_int(properties, "consumer.progressive", 1);
 
-        // Convert the image to yuv422 when using the local scaler
-        if (scaler_method == filter_scale)
+        // Convert packed images to yuv422 when using the local scaler, which
+        // scales planar images as they are
+        if (scaler_method == filter_scale && !is_planar(*format))
             *format = mlt_image_yuv422;
 
         // Get the image as requested
@@ -240,7 +301,7 @@ static int filter_get_image(mlt_frame frame,
 
             // If valid colorspace
             if (*format == mlt_image_yuv422 || *format == mlt_image_rgb || *format == mlt_image_rgba
-                || *format == mlt_image_yuv420p) {
+                || is_planar(*format)) {
                 // Call the virtual function
                 scaler_method(frame, image, format, iwidth, iheight, owidth, oheight);
                 *width = owidth;
@@ -126,6 +126,48 @@ static void resize_image(uint8_t *output,
     }
 }
 
+/** Pad each plane of a planar image without converting it to a packed format.
+*/
+
+static void resize_planar(mlt_image output, mlt_image input)
+{
+    int offset_x = (output->width - input->width) / 2;
+    int offset_y = (output->height - input->height) / 2;
+    int plane;
+
+    // Keep the chroma samples aligned
+    offset_x -= offset_x % 2;
+    offset_y -= offset_y % 2;
+
+    mlt_image_fill_black(output);
+
+    for (plane = 0; plane < 3; plane++) {
+        int iwidth, iheight, owidth, oheight;
+        int bytes = mlt_image_plane_dimensions(input, plane, &iwidth, &iheight);
+        if (!bytes)
+            break;
+        mlt_image_plane_dimensions(output, plane, &owidth, &oheight);
+
+        // Scale the offsets to the subsampling of this plane
+        int x = owidth < output->width ? offset_x / 2 : offset_x;
+        int y = oheight < output->height ? offset_y / 2 : offset_y;
+        int src_x = x < 0 ? -x : 0;
+        int src_y = y < 0 ? -y : 0;
+        int dst_x = x > 0 ? x : 0;
+        int dst_y = y > 0 ? y : 0;
+        int width = MIN(iwidth - src_x, owidth - dst_x);
+        int height = MIN(iheight - src_y, oheight - dst_y);
+        uint8_t *in_line = input->planes[plane] + src_y * input->strides[plane] + src_x * bytes;
+        uint8_t *out_line = output->planes[plane] + dst_y * output->strides[plane] + dst_x * bytes;
+
+        while (height-- > 0) {
+            memcpy(out_line, in_line, width * bytes);
+            in_line += input->strides[plane];
+            out_line += output->strides[plane];
+        }
+    }
+}
+
 /** A padding function for frames - this does not rescale, but simply
 	resizes.
 */
@@ -157,14 +199,31 @@ static uint8_t *frame_resize_image(mlt_frame frame, int owidth, int oheight, mlt
                       mlt_image_format_name(format));
 
         uint8_t alpha_value = mlt_properties_get_int(properties, "resize_alpha");
-        // Create the output image
-        uint8_t *output = mlt_pool_alloc(owidth * (oheight + 1) * bpp);
-
-        // Call the generic resize
-        resize_image(output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value);
-
-        // Now update the frame
-        mlt_frame_set_image(frame, output, owidth * (oheight + 1) * bpp, mlt_pool_release);
+        uint8_t *output;
+        struct mlt_image_s input_image;
+        mlt_image_set_values(&input_image, input, format, iwidth, iheight);
+
+        if (mlt_image_plane_dimensions(&input_image, 1, NULL, NULL)) {
+            // Pad the planes directly
+            struct mlt_image_s output_image;
+            mlt_image_set_values(&output_image, NULL, format, owidth, oheight);
+            mlt_image_alloc_data(&output_image);
+            resize_planar(&output_image, &input_image);
+            output = output_image.data;
+            mlt_frame_set_image(frame,
+                                output,
+                                mlt_image_calculate_size(&output_image),
+                                output_image.release_data);
+        } else {
+            // Create the output image
+            output = mlt_pool_alloc(owidth * (oheight + 1) * bpp);
+
+            // Call the generic resize
+            resize_image(output, owidth, oheight, input, iwidth, iheight, bpp, format, alpha_value);
+
+            // Now update the frame
+            mlt_frame_set_image(frame, output, owidth * (oheight + 1) * bpp, mlt_pool_release);
+        }
 
         // We should resize the alpha too
         if (format != mlt_image_rgba && alpha && alpha_size >= iwidth * iheight) {
@@ -265,19 +324,15 @@ static int filter_get_image(mlt_frame frame,
     mlt_properties_set_int(properties, "resize_width", *width);
     mlt_properties_set_int(properties, "resize_height", *height);
 
-    // If there will be padding, then we need packed image format.
-    if (*format == mlt_image_yuv420p && (owidth < *width || oheight < *height)) {
-        *format = mlt_image_yuv422;
-    }
-
     // Now get the image
-    if (*format == mlt_image_yuv422) {
+    if (*format == mlt_image_yuv422 || *format == mlt_image_yuv420p
+        || *format == mlt_image_yuv422p16 || *format == mlt_image_yuv420p10) {
         owidth -= owidth % 2;
         *width -= *width % 2;
     }
     error = mlt_frame_get_image(frame, image, format, &owidth, &oheight, writable);
 
-    if (error == 0 && *image && *format != mlt_image_yuv420p) {
+    if (error == 0 && *image) {
         *image = frame_resize_image(frame, *width, *height, *format);
     } else {
         *width = owidth;
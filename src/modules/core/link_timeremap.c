@@ -17,24 +17,35 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <framework/mlt_animation.h>
 #include <framework/mlt_factory.h>
 #include <framework/mlt_frame.h>
 #include <framework/mlt_link.h>
 #include <framework/mlt_log.h>
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+// The number of source times to add to the table at a time
+#define SOURCE_TIMES_CHUNK 1024
+
 // Private Types
 typedef struct
 {
-    mlt_position prev_integration_position;
-    double prev_integration_time;
     mlt_frame prev_frame;
     mlt_filter resample_filter;
     mlt_filter pitch_filter;
+    // The source time at each position from the in point, integrated from speed_map
+    pthread_mutex_t source_times_mutex;
+    double *source_times;
+    int source_times_count;
+    int source_times_size;
+    unsigned int speed_map_generation;
+    mlt_position speed_map_length;
+    double speed_map_fps;
 } private_data;
 
 static void property_changed(mlt_service owner, mlt_link self, mlt_event_data event_data)
@@ -51,8 +62,24 @@ static void property_changed(mlt_service owner, mlt_link self, mlt_event_data ev
     } else if (strcmp("speed_map", name) == 0) {
         // speed_map changed. Need to re-integrate from the beginning.
         private_data *pdata = (private_data *) self->child;
-        pdata->prev_integration_position = 0;
-        pdata->prev_integration_time = 0.0;
+        pthread_mutex_lock(&pdata->source_times_mutex);
+        pdata->source_times_count = 0;
+        pthread_mutex_unlock(&pdata->source_times_mutex);
+    }
+}
+
+static void get_speeds(mlt_link self,
+                       mlt_animation animation,
+                       mlt_position start,
+                       mlt_position end,
+                       double *speeds)
+{
+    if (animation) {
+        mlt_animation_sample(animation, start, end, speeds);
+    } else {
+        double speed = mlt_properties_get_double(MLT_LINK_PROPERTIES(self), "speed_map");
+        for (mlt_position p = start; p < end; p++)
+            speeds[p - start] = speed;
     }
 }
 
@@ -63,34 +90,64 @@ static double integrate_source_time(mlt_link self, mlt_position position)
     mlt_position length = mlt_producer_get_length(MLT_LINK_PRODUCER(self));
     mlt_position in = mlt_producer_get_in(MLT_LINK_PRODUCER(self));
     double link_fps = mlt_producer_get_fps(MLT_LINK_PRODUCER(self));
-    mlt_position integration_distance = abs(pdata->prev_integration_position - position);
+    mlt_position offset = position - in;
+    double source_time = 0.0;
 
-    if (pdata->prev_integration_position < in || integration_distance > (position - in)) {
-        // Restart integration from the beginning
-        pdata->prev_integration_position = in;
-        pdata->prev_integration_time = 0.0;
+    // Let the property parse or refresh the animation for the length.
+    mlt_properties_anim_get_double(properties, "speed_map", 0, length);
+    mlt_animation animation = mlt_properties_get_animation(properties, "speed_map");
+    unsigned int generation = mlt_animation_get_generation(animation);
+
+    pthread_mutex_lock(&pdata->source_times_mutex);
+    if (generation != pdata->speed_map_generation || length != pdata->speed_map_length
+        || link_fps != pdata->speed_map_fps) {
+        pdata->source_times_count = 0;
+        pdata->speed_map_generation = generation;
+        pdata->speed_map_length = length;
+        pdata->speed_map_fps = link_fps;
     }
 
-    double source_time = pdata->prev_integration_time;
-
-    if (pdata->prev_integration_position < position) {
-        for (mlt_position p = pdata->prev_integration_position; p < position; p++) {
-            double speed = mlt_properties_anim_get_double(properties, "speed_map", p - in, length);
-            double time_delta = speed / link_fps;
-            source_time += time_delta;
+    if (offset < 0) {
+        // Integrate backwards from the in point without caching.
+        int count = -offset;
+        double *speeds = malloc(count * sizeof(*speeds));
+        if (speeds) {
+            get_speeds(self, animation, offset, 0, speeds);
+            for (int i = 0; i < count; i++)
+                source_time -= speeds[i] / link_fps;
+            free(speeds);
         }
-    } else if (pdata->prev_integration_position > position) {
-        for (mlt_position p = position; p < pdata->prev_integration_position; p++) {
-            double speed = mlt_properties_anim_get_double(properties, "speed_map", p - in, length);
-            double time_delta = speed / link_fps;
-            source_time -= time_delta;
+    } else {
+        if (offset >= pdata->source_times_count) {
+            // Extend the table of sums, which starts at zero for the in point.
+            int count = (offset / SOURCE_TIMES_CHUNK + 1) * SOURCE_TIMES_CHUNK;
+            if (count > pdata->source_times_size) {
+                double *source_times = realloc(pdata->source_times,
+                                               count * sizeof(*source_times));
+                if (source_times) {
+                    pdata->source_times = source_times;
+                    pdata->source_times_size = count;
+                } else {
+                    count = pdata->source_times_size;
+                }
+            }
+            if (count > offset) {
+                double *source_times = pdata->source_times;
+                int i = pdata->source_times_count;
+                if (i == 0)
+                    source_times[i++] = 0.0;
+                // Put the speed for the previous position into each entry, then sum them.
+                get_speeds(self, animation, i - 1, count - 1, &source_times[i]);
+                for (; i < count; i++)
+                    source_times[i] = source_times[i - 1] + source_times[i] / link_fps;
+                pdata->source_times_count = count;
+            }
         }
+        if (offset < pdata->source_times_count)
+            source_time = pdata->source_times[offset];
     }
+    pthread_mutex_unlock(&pdata->source_times_mutex);
 
-    // Remember the integration results so that the next frame can start
-    // integration from this position instead of from the beginning.
-    pdata->prev_integration_position = position;
-    pdata->prev_integration_time = source_time;
     return source_time;
 }
 
@@ -633,6 +690,8 @@ static void link_close(mlt_link self)
             mlt_frame_close(pdata->prev_frame);
             mlt_filter_close(pdata->resample_filter);
             mlt_filter_close(pdata->pitch_filter);
+            pthread_mutex_destroy(&pdata->source_times_mutex);
+            free(pdata->source_times);
             free(pdata);
         }
         self->close = NULL;
@@ -648,6 +707,7 @@ mlt_link link_timeremap_init(mlt_profile profile, mlt_service_type type, const c
 
     if (self && pdata) {
         self->child = pdata;
+        pthread_mutex_init(&pdata->source_times_mutex, NULL);
 
         // Callback registration
         self->configure = link_configure;
@@ -20,6 +20,7 @@
 #include <QtTest>
 
 #include <mlt++/Mlt.h>
+#include <vector>
 using namespace Mlt;
 
 class TestAnimation : public QObject
@@ -1056,6 +1057,173 @@ private Q_SLOTS:
             QVERIFY(boun <= 100.1);
         }
     }
+
+    void TypedGettersMatchItems_data()
+    {
+        QTest::addColumn<QString>("animation");
+        QTest::newRow("numbers") << "0=0; 10~=100; 25$=50; 40-=-20; 50g=80; 70y=0; 90|=30; 99=10";
+        QTest::newRow("percents") << "5=10%; 15c=90%; 30=50%";
+        QTest::newRow("colors") << "0=#ff000000; 20~=#00ff00ff; 40r=#000080ff; 60=#ffffffff";
+        QTest::newRow("rects") << "0=0 0 100 100 1; 30~=50 50 200 100 0.5; 60=0 100 20 20 0";
+        QTest::newRow("strings") << "0=one; 50=two; 80=three";
+    }
+
+    void TypedGettersMatchItems()
+    {
+        QFETCH(QString, animation);
+        Properties p;
+        p.set("foo", animation.toUtf8().constData());
+        p.anim_get_double("foo", 0);
+        mlt_animation a = p.get_animation("foo");
+        QVERIFY(a);
+        mlt_locale_t locale = NULL;
+        struct mlt_animation_item_s item;
+
+        // The animation was parsed without a frame rate, so the second converts keys again.
+        for (double fps : {0.0, 25.0}) {
+            for (int position = -5; position < 105; ++position) {
+                item.property = mlt_property_init();
+                mlt_animation_get_item(a, &item, position);
+                QCOMPARE(mlt_animation_get_double(a, position, fps, locale),
+                         mlt_property_get_double(item.property, fps, locale));
+                QCOMPARE(mlt_animation_get_int(a, position, fps, locale),
+                         mlt_property_get_int(item.property, fps, locale));
+                mlt_property_close(item.property);
+
+                // mlt_property_anim_get_color() and _rect() used to start with a typed item.
+                item.property = mlt_property_init();
+                mlt_property_set_color(item.property, mlt_color{0, 0, 0, 0});
+                mlt_animation_get_item(a, &item, position);
+                mlt_color expected = mlt_property_get_color(item.property, fps, locale);
+                mlt_color color = mlt_animation_get_color(a, position, fps, locale);
+                mlt_property_close(item.property);
+                QCOMPARE(color.r, expected.r);
+                QCOMPARE(color.g, expected.g);
+                QCOMPARE(color.b, expected.b);
+                QCOMPARE(color.a, expected.a);
+
+                item.property = mlt_property_init();
+                mlt_property_set_rect(item.property, mlt_rect{0, 0, 0, 0, 0});
+                mlt_animation_get_item(a, &item, position);
+                mlt_rect expected_rect = mlt_property_get_rect(item.property, locale);
+                mlt_rect rect = mlt_animation_get_rect(a, position, locale);
+                mlt_property_close(item.property);
+                QCOMPARE(rect.x, expected_rect.x);
+                QCOMPARE(rect.y, expected_rect.y);
+                QCOMPARE(rect.w, expected_rect.w);
+                QCOMPARE(rect.h, expected_rect.h);
+                QCOMPARE(rect.o, expected_rect.o);
+            }
+        }
+    }
+
+    void TypedGettersSeeEdits()
+    {
+        Properties p;
+        p.set("foo", "0=0; 100=100");
+        QCOMPARE(p.anim_get_double("foo", 50), 50.0);
+        mlt_animation a = p.get_animation("foo");
+        unsigned int generation = mlt_animation_get_generation(a);
+
+        // Serializing does not change the keyframes.
+        QCOMPARE(p.get("foo"), "0=0;100=100");
+        QCOMPARE(mlt_animation_get_generation(a), generation);
+        QCOMPARE(p.anim_get_double("foo", 50), 50.0);
+
+        // Changing a keyframe through the animation does.
+        mlt_animation_key_set_frame(a, 1, 50);
+        QVERIFY(mlt_animation_get_generation(a) != generation);
+        QCOMPARE(p.anim_get_double("foo", 25), 50.0);
+        QCOMPARE(p.anim_get_double("foo", 75), 100.0);
+
+        // So does setting the property again.
+        p.set("foo", "0=0; 100=200");
+        QCOMPARE(p.anim_get_double("foo", 50), 100.0);
+        p.anim_set("foo", 0.0, 100);
+        QCOMPARE(p.anim_get_double("foo", 50), 0.0);
+    }
+
+    void SampleMatchesGetDouble_data()
+    {
+        QTest::addColumn<QString>("animation");
+        QTest::newRow("linear") << "0=0; 50=100; 100=-100";
+        QTest::newRow("smooth") << "0~=0; 20~=100; 45$=50; 70-=80; 100=0";
+        QTest::newRow("easing") << "0a=0; 10f=100; 20i=0; 30p=100; 40u=0; 50x=100; 60y=0; 70D=100";
+        QTest::newRow("discrete") << "0|=0; 50=100; 100=-100";
+        QTest::newRow("colors") << "10=#ff000000; 60=#00ff00ff";
+        QTest::newRow("strings") << "10=one; 60=two";
+        QTest::newRow("one key") << "30=42";
+        QTest::newRow("empty") << "";
+    }
+
+    void SampleMatchesGetDouble()
+    {
+        QFETCH(QString, animation);
+        mlt_animation a = mlt_animation_new();
+        mlt_animation_parse(a, animation.toUtf8().constData(), 0, 25.0, NULL);
+
+        const int start = -10, end = 120;
+        double values[end - start];
+        QCOMPARE(mlt_animation_sample(a, start, end, values), 0);
+        for (int position = start; position < end; ++position)
+            QCOMPARE(values[position - start], mlt_animation_get_double(a, position, 25.0, NULL));
+
+        // A range that starts inside a segment
+        QCOMPARE(mlt_animation_sample(a, 33, 34, values), 0);
+        QCOMPARE(values[0], mlt_animation_get_double(a, 33, 25.0, NULL));
+        mlt_animation_close(a);
+    }
+
+    void BenchmarkSample_data()
+    {
+        QTest::addColumn<bool>("batch");
+        QTest::newRow("get_double") << false;
+        QTest::newRow("sample") << true;
+    }
+
+    void BenchmarkSample()
+    {
+        QFETCH(bool, batch);
+        // One second of per-sample gain automation at 48 kHz
+        mlt_animation a = mlt_animation_new();
+        mlt_animation_parse(a, "0=0; 12000~=1; 24000~=0.5; 36000i=1; 48000=0", 0, 25.0, NULL);
+        std::vector<double> values(48000);
+        QBENCHMARK {
+            if (batch) {
+                mlt_animation_sample(a, 0, values.size(), values.data());
+            } else {
+                for (int i = 0; i < int(values.size()); ++i)
+                    values[i] = mlt_animation_get_double(a, i, 25.0, NULL);
+            }
+        }
+        QVERIFY(values[24000] == 0.5);
+        mlt_animation_close(a);
+    }
+
+    void BenchmarkAnimGetDouble_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+    }
+
+    void BenchmarkAnimGetDouble()
+    {
+        QFETCH(int, count);
+        Properties p;
+        for (int i = 0; i < count; ++i)
+            p.anim_set("foo", i % 2 ? 100.0 : 0.0, i * 10, 0, mlt_keyframe_smooth);
+        int length = count * 10;
+        // A fixed number of lookups so the results compare across rows
+        double sum = 0.0;
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                sum += p.anim_get_double("foo", i * length / 1000 + 5, length);
+        }
+        QVERIFY(sum > 0.0);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestAnimation)
@@ -51,6 +51,66 @@ private Q_SLOTS:
         free(data);
         a.set_data(nullptr);
     }
+
+    void FifoRejectsPlanarFormat()
+    {
+        QVERIFY(!mlt_audio_fifo_new(mlt_audio_float, 2));
+        QVERIFY(!mlt_audio_fifo_new(mlt_audio_s32, 2));
+        mlt_audio_fifo fifo = mlt_audio_fifo_new(mlt_audio_f32le, 2);
+        QVERIFY(fifo);
+        mlt_audio_fifo_close(fifo);
+    }
+
+    void FifoKeepsOrderAcrossWrap()
+    {
+        mlt_audio_fifo fifo = mlt_audio_fifo_new(mlt_audio_s16, 2);
+        int16_t in[2 * 700];
+        int16_t out[2 * 700];
+        int16_t next = 0, expected = 0;
+
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 2 * 700; ++i)
+                in[i] = next++;
+            QCOMPARE(mlt_audio_fifo_write(fifo, in, 700), 700);
+            QCOMPARE(mlt_audio_fifo_read(fifo, out, 600), 600);
+            for (int i = 0; i < 2 * 600; ++i)
+                QCOMPARE(out[i], expected++);
+        }
+        QCOMPARE(mlt_audio_fifo_samples(fifo), 1000);
+        QCOMPARE(mlt_audio_fifo_read(fifo, out, 700), 700);
+        QCOMPARE(out[0], expected);
+        QCOMPARE(mlt_audio_fifo_read(fifo, out, 700), 300);
+        QCOMPARE(mlt_audio_fifo_samples(fifo), 0);
+        mlt_audio_fifo_close(fifo);
+    }
+
+    void FifoPeeksWithoutCopying()
+    {
+        mlt_audio_fifo fifo = mlt_audio_fifo_new(mlt_audio_u8, 1);
+        uint8_t data[1024];
+        for (int i = 0; i < 1024; ++i)
+            data[i] = i & 0xff;
+        mlt_audio_fifo_write(fifo, data, 1024);
+        mlt_audio_fifo_consume(fifo, 1000);
+        mlt_audio_fifo_write(fifo, data, 100);
+
+        void *spans[2];
+        int span_samples[2];
+        QCOMPARE(mlt_audio_fifo_peek(fifo, 200, spans, span_samples), 124);
+        QCOMPARE(span_samples[0], 24);
+        QCOMPARE(span_samples[1], 100);
+        QCOMPARE(static_cast<uint8_t *>(spans[0])[0], uint8_t(1000 & 0xff));
+        QCOMPARE(static_cast<uint8_t *>(spans[1])[0], uint8_t(0));
+        QCOMPARE(mlt_audio_fifo_samples(fifo), 124);
+
+        // A peek that fits before the end of the buffer is a single span.
+        QCOMPARE(mlt_audio_fifo_peek(fifo, 10, spans, span_samples), 10);
+        QCOMPARE(span_samples[1], 0);
+        QVERIFY(!spans[1]);
+        mlt_audio_fifo_clear(fifo);
+        QCOMPARE(mlt_audio_fifo_samples(fifo), 0);
+        mlt_audio_fifo_close(fifo);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestAudio)
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+class TestCache : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestCache() { Factory::init(); }
+
+private:
+    static int s_destroyed;
+
+    static void destroy(void *data)
+    {
+        ++s_destroyed;
+        delete static_cast<int *>(data);
+    }
+
+    static mlt_frame makeFrame(mlt_position position, int width, int height)
+    {
+        mlt_frame frame = mlt_frame_init(NULL);
+        int size = mlt_image_format_size(mlt_image_rgba, width, height, NULL);
+        uint8_t *image = static_cast<uint8_t *>(mlt_pool_alloc(size));
+        memset(image, position & 0xff, size);
+        mlt_frame_set_position(frame, position);
+        mlt_frame_set_image(frame, image, size, mlt_pool_release);
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        mlt_properties_set_int(properties, "format", mlt_image_rgba);
+        mlt_properties_set_int(properties, "width", width);
+        mlt_properties_set_int(properties, "height", height);
+        return frame;
+    }
+
+private Q_SLOTS:
+    void PutAndGetData()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int owner;
+        s_destroyed = 0;
+        mlt_cache_put(cache, &owner, new int(42), sizeof(int), destroy);
+        mlt_cache_item item = mlt_cache_get(cache, &owner);
+        QVERIFY(item);
+        int size = 0;
+        QCOMPARE(*static_cast<int *>(mlt_cache_item_data(item, &size)), 42);
+        QCOMPARE(size, int(sizeof(int)));
+        mlt_cache_item_close(item);
+        QCOMPARE(s_destroyed, 0);
+        mlt_cache_close(cache);
+        QCOMPARE(s_destroyed, 1);
+    }
+
+    void PutReplacesData()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int owner;
+        s_destroyed = 0;
+        mlt_cache_put(cache, &owner, new int(1), sizeof(int), destroy);
+        mlt_cache_put(cache, &owner, new int(2), sizeof(int), destroy);
+        QCOMPARE(s_destroyed, 1);
+        mlt_cache_item item = mlt_cache_get(cache, &owner);
+        QCOMPARE(*static_cast<int *>(mlt_cache_item_data(item, NULL)), 2);
+        mlt_cache_item_close(item);
+        QCOMPARE(mlt_properties_get_int(mlt_cache_properties(cache), "count"), 1);
+        mlt_cache_close(cache);
+        QCOMPARE(s_destroyed, 2);
+    }
+
+    void EvictsUnusedBeforeUsed()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int owners[5];
+        s_destroyed = 0;
+        for (int i = 0; i < 4; ++i)
+            mlt_cache_put(cache, &owners[i], new int(i), sizeof(int), destroy);
+        mlt_cache_item_close(mlt_cache_get(cache, &owners[0]));
+        mlt_cache_put(cache, &owners[4], new int(4), sizeof(int), destroy);
+        QCOMPARE(s_destroyed, 1);
+        mlt_cache_item item = mlt_cache_get(cache, &owners[0]);
+        QVERIFY(item);
+        mlt_cache_item_close(item);
+        QVERIFY(!mlt_cache_get(cache, &owners[1]));
+        mlt_properties stats = mlt_cache_properties(cache);
+        QCOMPARE(mlt_properties_get_int(stats, "count"), 4);
+        QCOMPARE(mlt_properties_get_int(stats, "hits"), 2);
+        QCOMPARE(mlt_properties_get_int(stats, "misses"), 1);
+        QCOMPARE(mlt_properties_get_int(stats, "evictions"), 1);
+        mlt_cache_close(cache);
+        QCOMPARE(s_destroyed, 5);
+    }
+
+    void PurgeRemovesData()
+    {
+        mlt_cache cache = mlt_cache_init();
+        int owners[2];
+        s_destroyed = 0;
+        mlt_cache_put(cache, &owners[0], new int(0), sizeof(int), destroy);
+        mlt_cache_put(cache, &owners[1], new int(1), sizeof(int), destroy);
+        mlt_cache_purge(cache, &owners[0]);
+        QCOMPARE(s_destroyed, 1);
+        QVERIFY(!mlt_cache_get(cache, &owners[0]));
+        mlt_cache_item item = mlt_cache_get(cache, &owners[1]);
+        QVERIFY(item);
+        mlt_cache_item_close(item);
+        mlt_cache_close(cache);
+        QCOMPARE(s_destroyed, 2);
+    }
+
+    void GetFrameReturnsCopy()
+    {
+        mlt_cache cache = mlt_cache_init();
+        mlt_frame frame = makeFrame(7, 4, 2);
+        mlt_cache_put_frame(cache, frame);
+        mlt_frame_close(frame);
+        QVERIFY(!mlt_cache_get_frame(cache, 8));
+        mlt_frame copy = mlt_cache_get_frame(cache, 7);
+        QVERIFY(copy);
+        QCOMPARE(mlt_frame_original_position(copy), 7);
+        uint8_t *image = static_cast<uint8_t *>(
+            mlt_properties_get_data(MLT_FRAME_PROPERTIES(copy), "image", NULL));
+        QCOMPARE(image[0], uint8_t(7));
+        image[0] = 0;
+        mlt_frame_close(copy);
+        copy = mlt_cache_get_frame(cache, 7);
+        image = static_cast<uint8_t *>(
+            mlt_properties_get_data(MLT_FRAME_PROPERTIES(copy), "image", NULL));
+        QCOMPARE(image[0], uint8_t(7));
+        mlt_frame_close(copy);
+        mlt_cache_close(cache);
+    }
+
+    void ByteBudgetLimitsFrames()
+    {
+        mlt_cache cache = mlt_cache_init();
+        const int frameBytes = mlt_image_format_size(mlt_image_rgba, 64, 36, NULL);
+        mlt_cache_set_size(cache, 100);
+        mlt_cache_set_max_bytes(cache, 3 * frameBytes);
+        QCOMPARE(mlt_cache_get_max_bytes(cache), int64_t(3 * frameBytes));
+        for (int i = 0; i < 10; ++i) {
+            mlt_frame frame = makeFrame(i, 64, 36);
+            mlt_cache_put_frame(cache, frame);
+            mlt_frame_close(frame);
+        }
+        mlt_properties stats = mlt_cache_properties(cache);
+        QCOMPARE(mlt_properties_get_int(stats, "count"), 3);
+        QCOMPARE(mlt_properties_get_int64(stats, "bytes"), int64_t(3 * frameBytes));
+        QCOMPARE(mlt_properties_get_int(stats, "evictions"), 7);
+
+        // One large frame counts more than one small frame.
+        mlt_frame frame = makeFrame(100, 64, 72);
+        mlt_cache_put_frame(cache, frame);
+        mlt_frame_close(frame);
+        QCOMPARE(mlt_properties_get_int(mlt_cache_properties(cache), "count"), 2);
+
+        // Lowering the budget evicts right away.
+        mlt_cache_set_max_bytes(cache, 2 * frameBytes);
+        QCOMPARE(mlt_properties_get_int(mlt_cache_properties(cache), "count"), 1);
+        frame = mlt_cache_get_frame(cache, 100);
+        QVERIFY(frame);
+        mlt_frame_close(frame);
+        mlt_cache_close(cache);
+    }
+
+    void ShardedCacheKeepsItsSize()
+    {
+        mlt_cache cache = mlt_cache_init();
+        mlt_cache_set_size(cache, 200);
+        for (int i = 0; i < 300; ++i) {
+            mlt_frame frame = makeFrame(i, 2, 2);
+            mlt_cache_put_frame(cache, frame);
+            mlt_frame_close(frame);
+        }
+        QCOMPARE(mlt_properties_get_int(mlt_cache_properties(cache), "count"), 200);
+        int found = 0;
+        for (int i = 100; i < 300; ++i) {
+            mlt_frame frame = mlt_cache_get_frame(cache, i);
+            found += frame != NULL;
+            mlt_frame_close(frame);
+        }
+        QVERIFY(found >= 190);
+
+        // Shrinking joins the shards and keeps the budget.
+        mlt_cache_set_size(cache, 4);
+        QCOMPARE(mlt_properties_get_int(mlt_cache_properties(cache), "count"), 4);
+        mlt_cache_close(cache);
+    }
+
+    void ServiceCacheReportsStatistics()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        mlt_service service = producer.get_service();
+        mlt_service_cache_set_size(service, "test_cache.stats", 8);
+        mlt_service_cache_set_max_bytes(service, "test_cache.stats", 1000);
+        mlt_service_cache_put(service, "test_cache.stats", new int(1), 400, destroy);
+        mlt_cache_item_close(mlt_service_cache_get(service, "test_cache.stats"));
+        mlt_properties stats = mlt_service_cache_properties(service, "test_cache.stats");
+        QVERIFY(stats);
+        QCOMPARE(mlt_properties_get_int(stats, "hits"), 1);
+        QCOMPARE(mlt_properties_get_int(stats, "bytes"), 400);
+        QCOMPARE(mlt_properties_get_int(stats, "size"), 8);
+        QCOMPARE(mlt_properties_get_int(stats, "max_bytes"), 1000);
+        mlt_service_cache_purge(service);
+    }
+};
+
+int TestCache::s_destroyed = 0;
+
+QTEST_APPLESS_MAIN(TestCache)
+
+#include "test_cache.moc"
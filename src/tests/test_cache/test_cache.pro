@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = test_cache
+SOURCES += test_cache.cpp
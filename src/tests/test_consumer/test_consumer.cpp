@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QtTest>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+class TestConsumer : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestConsumer() { Factory::init(); }
+
+private Q_SLOTS:
+    void NegotiatesFormatOfLastFilter()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        Filter blur(profile, "box_blur");
+        producer.attach(blur);
+        Consumer consumer(profile, "null");
+        consumer.set("negotiate_image_format", 1);
+        consumer.set("real_time", 0);
+        consumer.connect(producer);
+        consumer.start();
+        consumer.stop();
+        QCOMPARE(consumer.get("mlt_image_format"), "rgba");
+        QCOMPARE(consumer.get_int("image_conversions"), 1);
+        QCOMPARE(consumer.get("image_format_plan"), "null:rgba box_blur:rgba noise:yuv422");
+
+        // A restart negotiates again for the changed graph
+        producer.detach(blur);
+        consumer.start();
+        consumer.stop();
+        QVERIFY(!consumer.get("mlt_image_format"));
+        QCOMPARE(consumer.get_int("image_conversions"), 0);
+        QCOMPARE(consumer.get("image_format_plan"), "null:yuv422 noise:yuv422");
+    }
+
+    void KeepsExplicitFormat()
+    {
+        Profile profile;
+        Producer producer(profile, "noise");
+        Filter blur(profile, "box_blur");
+        producer.attach(blur);
+        Consumer consumer(profile, "null");
+        consumer.set("negotiate_image_format", 1);
+        consumer.set("mlt_image_format", "yuv422");
+        consumer.set("real_time", 0);
+        consumer.connect(producer);
+        consumer.start();
+        consumer.stop();
+        QCOMPARE(consumer.get("mlt_image_format"), "yuv422");
+        QCOMPARE(consumer.get_int("image_conversions"), 2);
+    }
+
+    void CountsConversionsAcrossTracks()
+    {
+        Profile profile;
+        Producer a(profile, "noise");
+        Producer b(profile, "noise");
+        Filter blur(profile, "box_blur");
+        b.attach(blur);
+        Tractor tractor(profile);
+        tractor.set_track(a, 0);
+        tractor.set_track(b, 1);
+        Transition composite(profile, "composite");
+        tractor.plant_transition(composite, 0, 1);
+        Consumer consumer(profile, "null");
+        consumer.set("negotiate_image_format", 1);
+        consumer.set("real_time", 0);
+        consumer.connect(tractor);
+        consumer.start();
+        consumer.stop();
+        // The blurred track goes to rgba and back for the composite
+        QVERIFY(!consumer.get("mlt_image_format"));
+        QCOMPARE(consumer.get_int("image_conversions"), 2);
+        QCOMPARE(consumer.get("image_format_plan"),
+                 "null:yuv422 composite:yuv422 noise:yuv422 box_blur:rgba noise:yuv422");
+    }
+};
+
+QTEST_APPLESS_MAIN(TestConsumer)
+
+#include "test_consumer.moc"
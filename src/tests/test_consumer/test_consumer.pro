@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = test_consumer
+SOURCES += test_consumer.cpp
@@ -46,6 +46,16 @@ private:
         self->checkOwner(owner);
     }
 
+    static void onCount(mlt_properties, int *count, mlt_event_data) { ++*count; }
+
+    static void onListenAndDisconnect(mlt_properties owner, int *count, mlt_event_data)
+    {
+        // Changing the listeners while firing affects only the next fire.
+        ++*count;
+        mlt_events_listen(owner, count + 1, "test-event", (mlt_listener) onCount);
+        mlt_events_disconnect(owner, count);
+    }
+
 private Q_SLOTS:
 
     void ListenToPropertyChanged()
@@ -90,6 +100,71 @@ private Q_SLOTS:
         producer.set("foo", 1);
         delete event;
     }
+
+    void FireById()
+    {
+        Properties properties;
+        mlt_properties p = properties.get_properties();
+        mlt_events_init(p);
+        mlt_events_register(p, "test-event");
+        int id = mlt_events_id("test-event");
+        QVERIFY(id >= 0);
+        QCOMPARE(mlt_events_id("test-event"), id);
+        QVERIFY(mlt_events_id("test-other-event") != id);
+        int count = 0;
+        QCOMPARE(mlt_events_fire_id(p, id, mlt_event_data_none()), 0);
+        mlt_events_listen(p, &count, "test-event", (mlt_listener) onCount);
+        QCOMPARE(mlt_events_fire_id(p, id, mlt_event_data_none()), 1);
+        QCOMPARE(mlt_events_fire(p, "test-event", mlt_event_data_none()), 1);
+        QCOMPARE(mlt_events_fire_id(p, mlt_events_id("test-other-event"), mlt_event_data_none()),
+                 0);
+        QCOMPARE(count, 2);
+    }
+
+    void ChangeListenersWhileFiring()
+    {
+        Properties properties;
+        mlt_properties p = properties.get_properties();
+        mlt_events_init(p);
+        mlt_events_register(p, "test-event");
+        int counts[2] = {0, 0};
+        mlt_events_listen(p, &counts[0], "test-event", (mlt_listener) onListenAndDisconnect);
+        QCOMPARE(mlt_events_fire(p, "test-event", mlt_event_data_none()), 1);
+        QCOMPARE(counts[0], 1);
+        QCOMPARE(counts[1], 0);
+        QCOMPARE(mlt_events_fire(p, "test-event", mlt_event_data_none()), 1);
+        QCOMPARE(counts[0], 1);
+        QCOMPARE(counts[1], 1);
+    }
+
+    void DisconnectKeepsOtherListeners()
+    {
+        Properties properties;
+        mlt_properties p = properties.get_properties();
+        mlt_events_init(p);
+        mlt_events_register(p, "test-event");
+        int counts[3] = {0, 0, 0};
+        for (int i = 0; i < 3; ++i)
+            mlt_events_listen(p, &counts[i], "test-event", (mlt_listener) onCount);
+        mlt_events_disconnect(p, &counts[1]);
+        QCOMPARE(mlt_events_fire(p, "test-event", mlt_event_data_none()), 2);
+        QCOMPARE(counts[0], 1);
+        QCOMPARE(counts[1], 0);
+        QCOMPARE(counts[2], 1);
+    }
+
+    void BenchmarkSetWithoutListeners()
+    {
+        Properties properties;
+        mlt_properties p = properties.get_properties();
+        mlt_events_init(p);
+        mlt_events_register(p, "property-changed");
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                properties.set("foo", i);
+        }
+        QCOMPARE(properties.get_int("foo"), 999);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestEvents)
@@ -19,9 +19,92 @@
 #include <QString>
 #include <QtTest>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+// The BT.601 conversions as they were before imageconvert was vectorized and
+// sliced, to benchmark against. Widths must be even.
+template<mlt_image_format in, mlt_image_format out>
+static void referenceConvert(mlt_image src, mlt_image dst)
+{
+    const bool rgbIn = in == mlt_image_rgb || in == mlt_image_rgba;
+    const bool rgbOut = out == mlt_image_rgb || out == mlt_image_rgba;
+    for (int line = 0; line < src->height; ++line) {
+        uint8_t *s = src->planes[0] + src->strides[0] * line;
+        uint8_t *d = dst->planes[0] + dst->strides[0] * line;
+        uint8_t *alpha = src->planes[3] ? src->planes[3] + src->strides[3] * line : nullptr;
+        for (int x = 0; x < src->width; x += 2) {
+            int y[2], u[2], v[2], r[2], g[2], b[2], a[2] = {0xff, 0xff};
+            for (int k = 0; k < 2; ++k) {
+                if (in == mlt_image_rgb) {
+                    r[k] = s[3 * (x + k)], g[k] = s[3 * (x + k) + 1], b[k] = s[3 * (x + k) + 2];
+                } else if (in == mlt_image_rgba) {
+                    r[k] = s[4 * (x + k)], g[k] = s[4 * (x + k) + 1], b[k] = s[4 * (x + k) + 2];
+                    a[k] = s[4 * (x + k) + 3];
+                } else if (in == mlt_image_yuv422) {
+                    y[k] = s[2 * (x + k)], u[k] = s[2 * x + 1], v[k] = s[2 * x + 3];
+                } else {
+                    y[k] = s[x + k];
+                    u[k] = src->planes[1][src->strides[1] * (line / 2) + x / 2];
+                    v[k] = src->planes[2][src->strides[2] * (line / 2) + x / 2];
+                }
+                if (alpha)
+                    a[k] = alpha[x + k];
+                if (rgbIn && !rgbOut) {
+                    RGB2YUV_601_SCALED(r[k], g[k], b[k], y[k], u[k], v[k]);
+                } else if (!rgbIn && rgbOut) {
+                    YUV2RGB_601_SCALED(y[k], u[k], v[k], r[k], g[k], b[k]);
+                }
+            }
+            for (int k = 0; k < 2; ++k) {
+                if (out == mlt_image_rgb) {
+                    d[3 * (x + k)] = r[k], d[3 * (x + k) + 1] = g[k], d[3 * (x + k) + 2] = b[k];
+                } else if (out == mlt_image_rgba) {
+                    d[4 * (x + k)] = r[k], d[4 * (x + k) + 1] = g[k], d[4 * (x + k) + 2] = b[k];
+                    d[4 * (x + k) + 3] = a[k];
+                } else if (out == mlt_image_yuv422) {
+                    d[2 * (x + k)] = y[k];
+                    d[2 * (x + k) + 1] = k ? (v[0] + v[1]) >> 1 : (u[0] + u[1]) >> 1;
+                } else {
+                    d[x + k] = y[k];
+                    if (!(line % 2)) {
+                        dst->planes[1][dst->strides[1] * (line / 2) + x / 2] = u[0];
+                        dst->planes[2][dst->strides[2] * (line / 2) + x / 2] = v[0];
+                    }
+                }
+                if (in == mlt_image_rgba && out != mlt_image_rgba)
+                    dst->planes[3][dst->strides[3] * line + x + k] = a[k];
+            }
+        }
+    }
+}
+
+typedef void (*ReferenceConvert)(mlt_image src, mlt_image dst);
+
+static const struct
+{
+    mlt_image_format in;
+    mlt_image_format out;
+    ReferenceConvert reference;
+} conversions[] = {
+    {mlt_image_rgb, mlt_image_rgba, referenceConvert<mlt_image_rgb, mlt_image_rgba>},
+    {mlt_image_rgb, mlt_image_yuv422, referenceConvert<mlt_image_rgb, mlt_image_yuv422>},
+    {mlt_image_rgba, mlt_image_rgb, referenceConvert<mlt_image_rgba, mlt_image_rgb>},
+    {mlt_image_rgba, mlt_image_yuv422, referenceConvert<mlt_image_rgba, mlt_image_yuv422>},
+    {mlt_image_yuv422, mlt_image_rgb, referenceConvert<mlt_image_yuv422, mlt_image_rgb>},
+    {mlt_image_yuv422, mlt_image_rgba, referenceConvert<mlt_image_yuv422, mlt_image_rgba>},
+    {mlt_image_yuv422, mlt_image_yuv420p, referenceConvert<mlt_image_yuv422, mlt_image_yuv420p>},
+    {mlt_image_yuv420p, mlt_image_rgb, referenceConvert<mlt_image_yuv420p, mlt_image_rgb>},
+    {mlt_image_yuv420p, mlt_image_rgba, referenceConvert<mlt_image_yuv420p, mlt_image_rgba>},
+    {mlt_image_yuv420p, mlt_image_yuv422, referenceConvert<mlt_image_yuv420p, mlt_image_yuv422>},
+};
+
 class TestImage : public QObject
 {
     Q_OBJECT
@@ -29,6 +112,64 @@ class TestImage : public QObject
 public:
     TestImage() { Factory::init(); }
 
+private:
+    // The Image takes ownership
+    static mlt_image newImage(int width, int height, mlt_image_format format)
+    {
+        mlt_image image = mlt_image_new();
+        mlt_image_set_values(image, nullptr, format, width, height);
+        mlt_image_alloc_data(image);
+        return image;
+    }
+
+    // Converts with the frame's convert_image, which the loader sets from the
+    // imageconvert filter.
+    static uint8_t *convert(mlt_frame frame,
+                            mlt_image src,
+                            mlt_image_format format,
+                            int colorspace = 601,
+                            int full_range = 0)
+    {
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        mlt_properties_set_int(properties, "width", src->width);
+        mlt_properties_set_int(properties, "height", src->height);
+        mlt_properties_set_int(properties, "colorspace", colorspace);
+        mlt_properties_set_int(properties, "full_range", full_range);
+        mlt_properties_set_int(properties, "format", src->format);
+        mlt_frame_set_image(frame, (uint8_t *) src->data, 0, nullptr);
+        mlt_frame_set_alpha(frame, src->planes[3], 0, nullptr);
+        uint8_t *buffer = (uint8_t *) src->data;
+        mlt_image_format in = src->format;
+        if (frame->convert_image(frame, &buffer, &in, format) || in != format)
+            return nullptr;
+        mlt_properties_set_int(properties, "format", format);
+        return buffer;
+    }
+
+    // A yuv420p10 frame with constant planes and no get_image stack
+    static mlt_frame newPlanarFrame(int width, int height)
+    {
+        mlt_frame frame = mlt_frame_init(nullptr);
+        struct mlt_image_s image;
+        mlt_image_set_values(&image, nullptr, mlt_image_yuv420p10, width, height);
+        mlt_image_alloc_data(&image);
+        const uint16_t values[] = {400, 300, 500};
+        for (int plane = 0; plane < 3; ++plane) {
+            int w, h;
+            mlt_image_plane_dimensions(&image, plane, &w, &h);
+            std::fill_n((uint16_t *) image.planes[plane], w * h, values[plane]);
+        }
+        mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+        mlt_frame_set_image(frame,
+                            (uint8_t *) image.data,
+                            mlt_image_calculate_size(&image),
+                            image.release_data);
+        mlt_properties_set_int(properties, "format", image.format);
+        mlt_properties_set_int(properties, "width", width);
+        mlt_properties_set_int(properties, "height", height);
+        return frame;
+    }
+
 private Q_SLOTS:
 
     void DefaultConstructor()
@@ -129,6 +270,258 @@ private Q_SLOTS:
         i.init_alpha();
         QVERIFY(i.plane(3) != nullptr);
     }
+
+    void PlaneDimensions()
+    {
+        mlt_image planar = newImage(64, 36, mlt_image_yuv420p10);
+        Image planarImage(planar);
+        int width = 0;
+        int height = 0;
+        QCOMPARE(mlt_image_plane_dimensions(planar, 0, &width, &height), 2);
+        QCOMPARE(width, 64);
+        QCOMPARE(height, 36);
+        QCOMPARE(mlt_image_plane_dimensions(planar, 2, &width, &height), 2);
+        QCOMPARE(width, 32);
+        QCOMPARE(height, 18);
+        QCOMPARE(mlt_image_plane_dimensions(planar, 3, &width, &height), 0);
+        mlt_image_alloc_alpha(planar);
+        QCOMPARE(mlt_image_plane_dimensions(planar, 3, &width, &height), 1);
+        QCOMPARE(width, 64);
+
+        mlt_image packed = newImage(64, 36, mlt_image_rgba);
+        Image packedImage(packed);
+        QCOMPARE(mlt_image_plane_dimensions(packed, 0, &width, &height), 4);
+        QCOMPARE(mlt_image_plane_dimensions(packed, 1, &width, &height), 0);
+    }
+
+    void ResizePadsPlanarImage()
+    {
+        Profile profile;
+        Filter filter(profile, "resize");
+        mlt_frame frame = newPlanarFrame(8, 8);
+        mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "distort", 1);
+        mlt_filter_process(filter.get_filter(), frame);
+        uint8_t *buffer = nullptr;
+        mlt_image_format format = mlt_image_yuv420p10;
+        int width = 16;
+        int height = 8;
+        QCOMPARE(mlt_frame_get_image(frame, &buffer, &format, &width, &height, 0), 0);
+        QCOMPARE(format, mlt_image_yuv420p10);
+        QCOMPARE(width, 16);
+        QCOMPARE(height, 8);
+        struct mlt_image_s image;
+        mlt_image_set_values(&image, buffer, format, width, height);
+        QCOMPARE(((uint16_t *) image.planes[0])[0], uint16_t(16 << 2));
+        QCOMPARE(((uint16_t *) image.planes[0])[4], uint16_t(400));
+        QCOMPARE(((uint16_t *) image.planes[0])[12], uint16_t(16 << 2));
+        QCOMPARE(((uint16_t *) image.planes[1])[0], uint16_t(128 << 2));
+        QCOMPARE(((uint16_t *) image.planes[1])[2], uint16_t(300));
+        QCOMPARE(((uint16_t *) image.planes[2])[5], uint16_t(500));
+        mlt_frame_close(frame);
+    }
+
+    void RescaleKeepsPlanarFormat()
+    {
+        Profile profile;
+        Filter filter(profile, "rescale");
+        mlt_frame frame = newPlanarFrame(16, 16);
+        mlt_filter_process(filter.get_filter(), frame);
+        uint8_t *buffer = nullptr;
+        mlt_image_format format = mlt_image_yuv420p10;
+        int width = 8;
+        int height = 8;
+        QCOMPARE(mlt_frame_get_image(frame, &buffer, &format, &width, &height, 0), 0);
+        QCOMPARE(format, mlt_image_yuv420p10);
+        QCOMPARE(width, 8);
+        QCOMPARE(height, 8);
+        struct mlt_image_s image;
+        mlt_image_set_values(&image, buffer, format, width, height);
+        QCOMPARE(((uint16_t *) image.planes[0])[63], uint16_t(400));
+        QCOMPARE(((uint16_t *) image.planes[1])[15], uint16_t(300));
+        QCOMPARE(((uint16_t *) image.planes[2])[0], uint16_t(500));
+        mlt_frame_close(frame);
+    }
+
+    void ImageConvertMatchesReference()
+    {
+        Profile profile;
+        Filter filter(profile, "imageconvert");
+        QVERIFY(filter.is_valid());
+        for (const auto &conversion : conversions) {
+            mlt_image src = newImage(64, 18, conversion.in);
+            Image srcImage(src);
+            for (int i = 0; i < mlt_image_calculate_size(src); ++i)
+                src->planes[0][i] = i * 7 + i / 13;
+            mlt_image expected = newImage(64, 18, conversion.out);
+            Image expectedImage(expected);
+            if (conversion.in == mlt_image_rgba)
+                mlt_image_alloc_alpha(expected);
+            conversion.reference(src, expected);
+
+            mlt_frame frame = mlt_frame_init(nullptr);
+            mlt_filter_process(filter.get_filter(), frame);
+            uint8_t *image = convert(frame, src, conversion.out);
+            QVERIFY(image);
+            int size = mlt_image_format_size(conversion.out, 64, 18, nullptr);
+            QVERIFY(!std::memcmp(image, expected->planes[0], size));
+            if (conversion.in == mlt_image_rgba)
+                QVERIFY(!std::memcmp(mlt_frame_get_alpha(frame), expected->planes[3], 64 * 18));
+            mlt_frame_close(frame);
+        }
+    }
+
+    void ImageConvertHonoursColorspace_data()
+    {
+        QTest::addColumn<int>("colorspace");
+        QTest::addColumn<int>("fullRange");
+        QTest::addColumn<int>("y");
+        QTest::addColumn<int>("u");
+        QTest::addColumn<int>("v");
+        // Pure red
+        QTest::newRow("601") << 601 << 0 << 81 << 90 << 240;
+        QTest::newRow("601 full") << 601 << 1 << 76 << 85 << 255;
+        QTest::newRow("709") << 709 << 0 << 63 << 102 << 240;
+        QTest::newRow("709 full") << 709 << 1 << 54 << 99 << 255;
+        QTest::newRow("2020") << 2020 << 0 << 74 << 97 << 240;
+        QTest::newRow("2020 full") << 2020 << 1 << 67 << 92 << 255;
+    }
+
+    void ImageConvertHonoursColorspace()
+    {
+        QFETCH(int, colorspace);
+        QFETCH(int, fullRange);
+        QFETCH(int, y);
+        QFETCH(int, u);
+        QFETCH(int, v);
+        Profile profile;
+        Filter filter(profile, "imageconvert");
+        mlt_image src = newImage(2, 2, mlt_image_rgb);
+        Image srcImage(src);
+        for (int i = 0; i < 4; ++i) {
+            src->planes[0][3 * i] = 255;
+            src->planes[0][3 * i + 1] = 0;
+            src->planes[0][3 * i + 2] = 0;
+        }
+        mlt_frame frame = mlt_frame_init(nullptr);
+        mlt_filter_process(filter.get_filter(), frame);
+        uint8_t *yuv = convert(frame, src, mlt_image_yuv422, colorspace, fullRange);
+        QVERIFY(yuv);
+        QCOMPARE(int(yuv[0]), y);
+        QCOMPARE(int(yuv[1]), u);
+        QCOMPARE(int(yuv[3]), v);
+
+        // And back again
+        mlt_image image = newImage(2, 2, mlt_image_yuv422);
+        Image yuvImage(image);
+        std::memcpy(image->data, yuv, 8);
+        uint8_t *rgb = convert(frame, image, mlt_image_rgb, colorspace, fullRange);
+        QVERIFY(rgb);
+        QVERIFY(rgb[0] >= 253 && rgb[1] <= 1 && rgb[2] <= 1);
+        mlt_frame_close(frame);
+    }
+
+    void BenchmarkImageConvert_data()
+    {
+        QTest::addColumn<int>("conversion");
+        QTest::addColumn<int>("height");
+        QTest::addColumn<bool>("reference");
+        for (int i = 0; i < int(sizeof(conversions) / sizeof(conversions[0])); ++i) {
+            for (int height : {1080, 2160}) {
+                for (bool reference : {true, false}) {
+                    QTest::newRow(QString("%1 -> %2 %3p %4")
+                                      .arg(mlt_image_format_name(conversions[i].in))
+                                      .arg(mlt_image_format_name(conversions[i].out))
+                                      .arg(height)
+                                      .arg(reference ? "reference" : "imageconvert")
+                                      .toLatin1()
+                                      .constData())
+                        << i << height << reference;
+                }
+            }
+        }
+    }
+
+    // Run with MLT_SLICES_COUNT=1 to compare the kernels alone.
+    void BenchmarkImageConvert()
+    {
+        QFETCH(int, conversion);
+        QFETCH(int, height);
+        QFETCH(bool, reference);
+        const auto &c = conversions[conversion];
+        Profile profile;
+        Filter filter(profile, "imageconvert");
+        mlt_image src = newImage(height * 16 / 9, height, c.in);
+        Image srcImage(src);
+        std::memset(src->data, 0x80, mlt_image_calculate_size(src));
+        mlt_frame frame = mlt_frame_init(nullptr);
+        mlt_filter_process(filter.get_filter(), frame);
+        if (reference) {
+            QBENCHMARK {
+                mlt_image dst = newImage(src->width, height, c.out);
+                Image dstImage(dst);
+                if (c.in == mlt_image_rgba)
+                    mlt_image_alloc_alpha(dst);
+                c.reference(src, dst);
+            }
+        } else {
+            QBENCHMARK {
+                QVERIFY(convert(frame, src, c.out));
+            }
+        }
+        mlt_frame_close(frame);
+    }
+
+    void BenchmarkAllocData_data()
+    {
+        QTest::addColumn<QString>("mode");
+        QTest::addColumn<int>("threads");
+        for (auto mode : {"heap", "transparent", "explicit"}) {
+            for (int threads : {1, 4, 16}) {
+                QTest::newRow(QString("%1 %2").arg(mode).arg(threads).toLatin1().constData())
+                    << QString(mode) << threads;
+            }
+        }
+    }
+
+    // Each worker fills and reads back 4K frames, like a parallel consumer's
+    // workers. The mode only differs on a machine with huge pages or more
+    // than one NUMA node; run it under numactl --interleave to compare
+    // against buffers that are not node-local.
+    void BenchmarkAllocData()
+    {
+        QFETCH(QString, mode);
+        QFETCH(int, threads);
+        mlt_properties_set(mlt_global_properties(),
+                           "MLT_POOL_HUGE_PAGES",
+                           mode == "heap" ? nullptr : mode.toLatin1().constData());
+        mlt_pool_init();
+        mlt_pool_purge();
+        mlt_pool_purge();
+        std::atomic<unsigned> total(0);
+        QBENCHMARK {
+            std::vector<std::thread> workers;
+            for (int i = 0; i < threads; ++i) {
+                workers.emplace_back([&total] {
+                    for (int j = 0; j < 4; ++j) {
+                        Image image(3840, 2160, mlt_image_rgba);
+                        int size = image.stride(0) * image.height();
+                        std::memset(image.plane(0), j, size);
+                        unsigned sum = 0;
+                        for (int k = 0; k < size; k += 64)
+                            sum += image.plane(0)[k];
+                        total += sum;
+                    }
+                });
+            }
+            for (auto &worker : workers)
+                worker.join();
+        }
+        QVERIFY(total > 0);
+        mlt_properties_set(mlt_global_properties(), "MLT_POOL_HUGE_PAGES", nullptr);
+        mlt_pool_init();
+        mlt_pool_purge();
+        mlt_pool_purge();
+    }
 };
 
 QTEST_APPLESS_MAIN(TestImage)
@@ -263,6 +263,60 @@ private Q_SLOTS:
         delete pp2;
         delete pp3;
     }
+
+    void ClipStartsFollowEdits()
+    {
+        Playlist pl(profile);
+        Producer p(profile, "noise");
+        for (int i = 0; i < 20; ++i) {
+            if (i % 3 == 0)
+                pl.blank(i);
+            else
+                pl.append(p, 0, i * 2);
+        }
+        pl.repeat(4, 3);
+        pl.resize_clip(7, 0, 0);
+        pl.move(2, 15);
+        pl.remove(9);
+        pl.insert_blank(11, 4);
+        QCOMPARE(pl.count(), 20);
+
+        int start = 0;
+        for (int i = 0; i < pl.count(); ++i) {
+            int length = pl.clip_length(i);
+            QCOMPARE(pl.clip_start(i), start);
+            QCOMPARE(pl.get_clip_index_at(start), i);
+            QCOMPARE(pl.get_clip_index_at(start + length - 1), i);
+            start += length;
+        }
+        QCOMPARE(pl.get_playtime(), start);
+        QCOMPARE(pl.get_clip_index_at(start), pl.count());
+        QCOMPARE(pl.clip_start(pl.count()), start);
+    }
+
+    void BenchmarkClipIndexAt_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+        QTest::newRow("100000") << 100000;
+    }
+
+    void BenchmarkClipIndexAt()
+    {
+        QFETCH(int, count);
+        Playlist pl(profile);
+        for (int i = 0; i < count; ++i)
+            pl.blank(i % 50);
+        int length = pl.get_playtime();
+        // A fixed number of lookups so the results compare across rows
+        int sum = 0;
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                sum += pl.get_clip_index_at(int(qint64(i) * length / 1000));
+        }
+        QVERIFY(sum > 0);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestPlaylist)
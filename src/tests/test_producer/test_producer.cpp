@@ -28,6 +28,39 @@ using namespace Mlt;
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+// Integrate the timeremap speed_map one frame at a time
+static double integrateSpeedMap(Link &link, int position)
+{
+    int in = link.get_in();
+    int length = link.get_length();
+    double fps = link.get_fps();
+    double sourceTime = 0.0;
+    for (int i = 0; i < position - in; i++)
+        sourceTime += link.anim_get_double("speed_map", i, length) / fps;
+    for (int i = position - in; i < 0; i++)
+        sourceTime -= link.anim_get_double("speed_map", i, length) / fps;
+    return sourceTime + in / fps;
+}
+
+static double remappedSourceTime(Link &link, int position)
+{
+    link.seek(position);
+    Frame *frame = link.get_frame();
+    Properties unique(mlt_frame_get_unique_properties(frame->get_frame(), link.get_service()));
+    double sourceTime = unique.get_double("source_time");
+    delete frame;
+    return sourceTime;
+}
+
+static void compareSourceTimes(Link &link)
+{
+    // Seek back and forth, across table chunks and before the in point
+    static const int positions[] = {60, 1500, 61, 0, 2100, 59, 50, 10, 1024, 1023, 300};
+    for (int position : positions)
+        QVERIFY(qAbs(remappedSourceTime(link, position) - integrateSpeedMap(link, position))
+                < 1e-9);
+}
+
 class TestProducer : public QObject
 {
     Q_OBJECT
@@ -59,6 +92,41 @@ private Q_SLOTS:
 
         delete cutService;
     }
+
+    void TimeremapSpeedMapMatchesIntegration_data()
+    {
+        QTest::addColumn<QString>("change");
+        QTest::newRow("speed_map") << "speed_map";
+        QTest::newRow("generation") << "generation";
+        QTest::newRow("length") << "length";
+        QTest::newRow("fps") << "fps";
+    }
+
+    void TimeremapSpeedMapMatchesIntegration()
+    {
+        QFETCH(QString, change);
+        Profile profile("dv_pal");
+        Producer producer(profile, "color", "red");
+        Link link("timeremap");
+        QVERIFY(link.is_valid());
+        link.connect_next(producer, profile);
+        link.set("length", 2500);
+        link.set_in_and_out(50, 2499);
+        link.set("speed_map", "0=1;1000=2;-1=0.5");
+        compareSourceTimes(link);
+
+        if (change == "speed_map") {
+            link.set("speed_map", "0=0.5;500=1.5");
+        } else if (change == "generation") {
+            Animation animation(link.get_animation("speed_map"));
+            animation.key_set_type(0, mlt_keyframe_discrete);
+        } else if (change == "length") {
+            link.set("length", 2000);
+        } else if (change == "fps") {
+            profile.set_frame_rate(30, 1);
+        }
+        compareSourceTimes(link);
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProducer)
@@ -28,7 +28,10 @@ extern "C" {
 #include <framework/mlt_animation.h>
 #include <framework/mlt_property.h>
 }
+#include <atomic>
 #include <cfloat>
+#include <thread>
+#include <vector>
 
 static const bool kRunLongTests = true;
 
@@ -421,6 +424,36 @@ private Q_SLOTS:
         QVERIFY(p.get("new key") == 0);
         p.rename("key", "new key");
         QCOMPARE(p.get("new key"), "value");
+        QVERIFY(p.get("key") == 0);
+    }
+
+    void ManyProperties()
+    {
+        Properties p;
+        char name[20];
+        for (int i = 0; i < 10000; ++i) {
+            sprintf(name, "key%d", i);
+            p.set(name, i);
+        }
+        QCOMPARE(p.count(), 10000);
+        for (int i = 0; i < 10000; ++i) {
+            sprintf(name, "key%d", i);
+            QCOMPARE(p.get_int(name), i);
+        }
+        QVERIFY(p.get("key10000") == 0);
+        p.rename("key5000", "renamed");
+        QCOMPARE(p.get_int("renamed"), 5000);
+        QVERIFY(p.get("key5000") == 0);
+        QCOMPARE(p.get_int("key5001"), 5001);
+    }
+
+    void NamesAreShared()
+    {
+        Properties p[2];
+        p[0].set("shared", 1);
+        p[1].set("other", 2);
+        p[1].set("shared", 3);
+        QVERIFY(p[0].get_name(0) == p[1].get_name(1));
     }
 
     void SequenceDetected()
@@ -1510,6 +1543,154 @@ private Q_SLOTS:
         QCOMPARE(p.get_int("foo"), 123);
         QCOMPARE(p.get_double("foo"), 123.4);
     }
+
+    void PropertyInitBulk()
+    {
+        mlt_property properties[4];
+        mlt_property_init_bulk(properties, 4);
+        for (int i = 0; i < 4; ++i)
+            QVERIFY(mlt_property_is_clear(properties[i]));
+        mlt_property_set_int(properties[0], 1);
+        mlt_property_set_double(properties[1], 2.5);
+        mlt_property_set_string(properties[2], "0=0;10=10");
+        mlt_rect rect = {1, 2, 3, 4, 1};
+        mlt_property_set_rect(properties[3], rect);
+        QCOMPARE(mlt_property_get_int(properties[0], 0, locale), 1);
+        QCOMPARE(mlt_property_get_double(properties[1], 0, locale), 2.5);
+        QCOMPARE(mlt_property_anim_get_int(properties[2], 25, locale, 5, 10), 5);
+        QCOMPARE(mlt_property_get_string(properties[3]), "1 2 3 4 1");
+        mlt_property_close_bulk(properties, 4);
+    }
+
+    void ArenaStringsSurviveUntilReset()
+    {
+        mlt_properties p = mlt_properties_new();
+        QCOMPARE(mlt_properties_set_arena(p, 64), 0);
+        for (int round = 0; round < 2; ++round) {
+            for (int i = 0; i < 100; ++i) {
+                QString s = QString::number(i);
+                mlt_properties_set(p, s.toLatin1().constData(), s.toLatin1().constData());
+            }
+            const char *long_value = "a string that is too long to go in the arena chunks";
+            mlt_properties_set(p, "long", long_value);
+            mlt_properties_set(p, "anim", "0=0;10=10");
+            QCOMPARE(mlt_properties_anim_get_int(p, "anim", 5, 20), 5);
+            mlt_properties_anim_set_int(p, "anim", 20, 20, 20, mlt_keyframe_linear);
+            QCOMPARE(mlt_properties_get(p, "anim"), "0=0;10=10;20=20");
+            QCOMPARE(mlt_properties_count(p), 102);
+            QCOMPARE(mlt_properties_get(p, "99"), "99");
+            QCOMPARE(mlt_properties_get(p, "long"), long_value);
+            mlt_properties_reset(p);
+            QCOMPARE(mlt_properties_count(p), 0);
+            QVERIFY(!mlt_properties_get(p, "99"));
+        }
+        mlt_properties_close(p);
+    }
+
+    void BenchmarkLookup_data()
+    {
+        QTest::addColumn<int>("count");
+        QTest::newRow("10") << 10;
+        QTest::newRow("100") << 100;
+        QTest::newRow("1000") << 1000;
+        QTest::newRow("10000") << 10000;
+    }
+
+    void BenchmarkLookup()
+    {
+        QFETCH(int, count);
+        Properties p;
+        QList<QByteArray> names;
+        for (int i = 0; i < count; ++i) {
+            names << QByteArray("key") + QByteArray::number(i);
+            p.set(names.last().constData(), i);
+        }
+        // A fixed number of lookups so the results compare across rows
+        int sum = 0;
+        QBENCHMARK {
+            for (int i = 0; i < 1000; ++i)
+                sum += p.get_int(names[i % count].constData());
+        }
+        QVERIFY(sum > 0);
+    }
+
+    void BenchmarkInsert_data()
+    {
+        BenchmarkLookup_data();
+    }
+
+    void BenchmarkInsert()
+    {
+        QFETCH(int, count);
+        QList<QByteArray> names;
+        for (int i = 0; i < count; ++i)
+            names << QByteArray("key") + QByteArray::number(i);
+        QBENCHMARK {
+            Properties p;
+            for (int i = 0; i < count; ++i)
+                p.set(names[i].constData(), i);
+        }
+    }
+
+    void ConcurrentGetWhileSetting()
+    {
+        Properties p;
+        p.set("level", 0.5);
+        std::vector<std::thread> readers;
+        std::atomic<bool> ok(true);
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&p, &ok]() {
+                for (int i = 0; i < 100000; ++i) {
+                    double level = p.get_double("level");
+                    if (level != 0.5 && level != 1.0)
+                        ok = false;
+                }
+            });
+        }
+        char name[20];
+        for (int i = 0; i < 1000; ++i) {
+            p.set("level", (i % 2) ? 0.5 : 1.0);
+            sprintf(name, "key%d", i);
+            p.set(name, i);
+        }
+        for (auto &thread : readers)
+            thread.join();
+        QVERIFY(ok);
+        QCOMPARE(p.get_int("key999"), 999);
+    }
+
+    void BenchmarkConcurrentGet_data()
+    {
+        QTest::addColumn<int>("threads");
+        QTest::newRow("1") << 1;
+        QTest::newRow("2") << 2;
+        QTest::newRow("4") << 4;
+        QTest::newRow("8") << 8;
+        QTest::newRow("16") << 16;
+        QTest::newRow("32") << 32;
+    }
+
+    void BenchmarkConcurrentGet()
+    {
+        QFETCH(int, threads);
+        Properties p;
+        p.set("level", 0.5);
+        p.set("width", 1920);
+        // Each thread does the same amount of work, so perfect scaling keeps the time constant
+        QBENCHMARK {
+            std::vector<std::thread> readers;
+            for (int t = 0; t < threads; ++t) {
+                readers.emplace_back([&p]() {
+                    double sum = 0.0;
+                    for (int i = 0; i < 100000; ++i)
+                        sum += p.get_double("level") + p.get_int("width");
+                    Q_UNUSED(sum)
+                });
+            }
+            for (auto &thread : readers)
+                thread.join();
+        }
+    }
 };
 
 QTEST_APPLESS_MAIN(TestProperties)
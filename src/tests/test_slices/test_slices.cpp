@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2026 Meltytech, LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <QString>
+#include <QtTest>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <mlt++/Mlt.h>
+using namespace Mlt;
+
+// More workers than fit in a 32-bit mask, whatever the number of CPUs
+static const int kWorkers = 40;
+
+struct Run
+{
+    std::vector<std::atomic<int>> calls;
+    std::atomic<int> badId{0};
+    std::atomic<int> badJobs{0};
+    int jobs;
+    int depth;
+    int innerJobs;
+    std::vector<std::unique_ptr<Run>> inner;
+
+    Run(int jobs, int depth = 0, int innerJobs = 0)
+        : calls(jobs)
+        , jobs(jobs)
+        , depth(depth)
+        , innerJobs(innerJobs)
+    {
+        for (auto &count : calls)
+            count = 0;
+        if (depth > 0)
+            for (int i = 0; i < jobs; ++i)
+                inner.emplace_back(new Run(innerJobs, depth - 1, innerJobs));
+    }
+
+    bool complete() const
+    {
+        for (auto &count : calls)
+            if (count != 1)
+                return false;
+        for (auto &run : inner)
+            if (!run->complete())
+                return false;
+        return !badId && !badJobs;
+    }
+
+    static int proc(int id, int idx, int jobs, void *cookie)
+    {
+        Run *self = static_cast<Run *>(cookie);
+        if (id < 0 || id >= mlt_slices_count_normal())
+            ++self->badId;
+        if (jobs != self->jobs)
+            ++self->badJobs;
+        ++self->calls[idx];
+        if (self->depth > 0)
+            mlt_slices_run_normal(self->innerJobs, proc, self->inner[idx].get());
+        return 0;
+    }
+};
+
+class TestSlices : public QObject
+{
+    Q_OBJECT
+
+public:
+    TestSlices()
+    {
+        qputenv("MLT_SLICES_COUNT", QByteArray::number(kWorkers));
+        Factory::init();
+    }
+
+private Q_SLOTS:
+    void CountHonoursEnvironment() { QCOMPARE(mlt_slices_count_normal(), kWorkers); }
+
+    void RunsEverySliceOnce()
+    {
+        Run run(kWorkers);
+        mlt_slices_run_normal(0, Run::proc, &run);
+        QVERIFY(run.complete());
+    }
+
+    void RunsMoreSlicesThanWorkers()
+    {
+        Run run(3 * kWorkers);
+        mlt_slices_run_normal(-3, Run::proc, &run);
+        QVERIFY(run.complete());
+    }
+
+    void NestedRunCompletes()
+    {
+        // Every worker blocks in an inner run, which must not deadlock.
+        Run run(kWorkers, 1, 8);
+        mlt_slices_run_normal(kWorkers, Run::proc, &run);
+        QVERIFY(run.complete());
+    }
+
+    void DeeplyNestedRunCompletes()
+    {
+        Run run(4, 3, 4);
+        mlt_slices_run_normal(4, Run::proc, &run);
+        QVERIFY(run.complete());
+    }
+
+    void ConcurrentNestedRunsComplete()
+    {
+        // Runs from threads outside of the pool share its workers.
+        std::vector<std::unique_ptr<Run>> runs;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i)
+            runs.emplace_back(new Run(kWorkers / 2, 1, 4));
+        for (auto &run : runs) {
+            Run *cookie = run.get();
+            threads.emplace_back(
+                [cookie] { mlt_slices_run_normal(cookie->jobs, Run::proc, cookie); });
+        }
+        for (auto &thread : threads)
+            thread.join();
+        for (auto &run : runs)
+            QVERIFY(run->complete());
+    }
+};
+
+QTEST_APPLESS_MAIN(TestSlices)
+
+#include "test_slices.moc"
@@ -0,0 +1,3 @@
+include(../common.pri)
+TARGET = test_slices
+SOURCES += test_slices.cpp
@@ -22,6 +22,41 @@
 #include <mlt++/Mlt.h>
 using namespace Mlt;
 
+// Counts the frames whose image stack ran more than once
+static int shadeReruns = 0;
+
+// Shades the luma by whether composite set resize_alpha or distort on the frame
+static int shadeGetImage(mlt_frame frame,
+                         uint8_t **image,
+                         mlt_image_format *format,
+                         int *width,
+                         int *height,
+                         int writable)
+{
+    mlt_properties properties = MLT_FRAME_PROPERTIES(frame);
+    if (mlt_properties_get_int(properties, "_shaded"))
+        ++shadeReruns;
+    mlt_properties_set_int(properties, "_shaded", 1);
+    // Read the request first, resize clears distort once it has used it
+    uint8_t luma = 50 + (mlt_properties_get_int(properties, "resize_alpha") ? 75 : 0)
+                   + (mlt_properties_get_int(properties, "distort") ? 100 : 0);
+    *format = mlt_image_yuv422;
+    int error = mlt_frame_get_image(frame, image, format, width, height, 1);
+    if (!error) {
+        for (int i = 0; i < *width * *height; ++i)
+            (*image)[2 * i] = luma;
+    }
+    return error;
+}
+
+static mlt_frame shadeProcess(mlt_filter, mlt_frame frame)
+{
+    // Composite changes this existing property rather than adding it
+    mlt_properties_set_int(MLT_FRAME_PROPERTIES(frame), "distort", 0);
+    mlt_frame_push_get_image(frame, shadeGetImage);
+    return frame;
+}
+
 class TestTractor : public QObject
 {
     Q_OBJECT
@@ -402,6 +437,170 @@ private Q_SLOTS:
         QCOMPARE(t.count(), 1);
         QCOMPARE(filter.get_track(), 0);
     }
+    void ParallelTracksMatchSequential()
+    {
+        QByteArray sequential = renderTracks(4, false, 8);
+        QByteArray parallel = renderTracks(4, true, 8);
+        QCOMPARE(parallel.size(), sequential.size());
+        QVERIFY(parallel == sequential);
+    }
+
+    void ParallelTracksFollowChangedRequest()
+    {
+        // The size changes after the requests were stable for two frames, so
+        // the tracks rendered ahead for the third frame must be rendered again.
+        QList<int> scales = {2, 2, 1, 1, 2};
+        QByteArray sequential = renderTracks(4, false, scales);
+        QByteArray parallel = renderTracks(4, true, scales);
+        QCOMPARE(parallel.size(), sequential.size());
+        QVERIFY(parallel == sequential);
+    }
+
+    void ParallelTracksFollowChangedRequestProperties()
+    {
+        // Composite sets resize_alpha on its b frame only when it is not
+        // aligned. That changes after two stable frames without changing the
+        // size, so the tracks rendered ahead for the fourth frame must be
+        // rendered again.
+        shadeReruns = 0;
+        QByteArray sequential = renderShadedTracks(false, "aligned", 1, 0);
+        QByteArray parallel = renderShadedTracks(true, "aligned", 1, 0);
+        QCOMPARE(parallel.size(), sequential.size());
+        QVERIFY(parallel == sequential);
+        QCOMPARE(shadeReruns, 0);
+    }
+
+    void ParallelTracksFollowChangedExistingProperty()
+    {
+        // Composite sets distort on its b frame from its own property, which
+        // changes a property the frame already had when the tractor assembled it.
+        shadeReruns = 0;
+        QByteArray sequential = renderShadedTracks(false, "distort", 0, 1);
+        QByteArray parallel = renderShadedTracks(true, "distort", 0, 1);
+        QCOMPARE(parallel.size(), sequential.size());
+        QVERIFY(parallel == sequential);
+        QCOMPARE(shadeReruns, 0);
+    }
+
+    void BenchmarkTrackCount_data()
+    {
+        QTest::addColumn<int>("tracks");
+        QTest::addColumn<bool>("parallel");
+        for (int tracks : {1, 2, 4, 6, 8, 12}) {
+            for (bool parallel : {false, true}) {
+                QTest::newRow(QString("%1 tracks%2")
+                                  .arg(tracks)
+                                  .arg(parallel ? " parallel" : "")
+                                  .toLatin1()
+                                  .constData())
+                    << tracks << parallel;
+            }
+        }
+    }
+
+    // Reports the time to render one composited frame, so compare the rows to
+    // see the per-frame latency against the number of tracks.
+    void BenchmarkTrackCount()
+    {
+        QFETCH(int, tracks);
+        QFETCH(bool, parallel);
+        Tractor tractor(profile);
+        buildTracks(tractor, tracks, parallel);
+        int position = 0;
+        QBENCHMARK {
+            tractor.seek(position++ % 100);
+            Frame *frame = tractor.get_frame();
+            mlt_image_format format = mlt_image_yuv422;
+            int width = profile.width();
+            int height = profile.height();
+            QVERIFY(frame->get_image(format, width, height));
+            delete frame;
+        }
+    }
+
+private:
+    void buildTracks(Tractor &tractor,
+                     int tracks,
+                     bool parallel,
+                     QList<Transition> *transitions = nullptr,
+                     bool shade = false)
+    {
+        tractor.set("parallel_tracks", parallel ? 1 : 0);
+        for (int i = 0; i < tracks; ++i) {
+            QString color = QString("color:0x%1ff").arg(0x204060 + 0x181008 * i, 6, 16, QChar('0'));
+            Producer producer(profile, color.toLatin1().constData());
+            producer.set("out", 99);
+            Filter filter(profile, "brightness");
+            filter.set("level", "0=0.3;99=1");
+            producer.attach(filter);
+            if (shade) {
+                mlt_filter shader = mlt_filter_new();
+                shader->process = shadeProcess;
+                mlt_service_attach(producer.get_service(), shader);
+                mlt_filter_close(shader);
+            }
+            tractor.set_track(producer, i);
+            if (i > 0) {
+                Transition transition(profile, "composite");
+                // Composite leaves the last row of an odd height to whatever the
+                // buffer held, so keep the fitted size even at half size too.
+                QString geometry = QString("%1%/%2%:50%x50%:75").arg(10 * i % 60).arg(8 * i % 60);
+                transition.set("geometry", geometry.toLatin1().constData());
+                transition.set("always_active", 1);
+                tractor.plant_transition(transition, 0, i);
+                if (transitions)
+                    transitions->append(transition);
+            }
+        }
+    }
+
+    QByteArray renderTracks(int tracks, bool parallel, int frames)
+    {
+        QList<int> scales;
+        for (int i = 0; i < frames; ++i)
+            scales << 1;
+        return renderTracks(tracks, parallel, scales);
+    }
+
+    // Renders a frame for each entry of scales, requesting the profile size
+    // divided by it.
+    QByteArray renderTracks(int tracks, bool parallel, const QList<int> &scales)
+    {
+        Tractor tractor(profile);
+        buildTracks(tractor, tracks, parallel);
+        QByteArray result;
+        for (int scale : scales) {
+            Frame *frame = tractor.get_frame();
+            mlt_image_format format = mlt_image_yuv422;
+            int width = profile.width() / scale;
+            int height = profile.height() / scale;
+            uint8_t *image = frame->get_image(format, width, height);
+            result.append(reinterpret_cast<const char *>(image), width * height * 2);
+            delete frame;
+        }
+        return result;
+    }
+
+    // Renders six frames, switching a property of the transitions after three.
+    QByteArray renderShadedTracks(bool parallel, const char *property, int before, int after)
+    {
+        Tractor tractor(profile);
+        QList<Transition> transitions;
+        buildTracks(tractor, 4, parallel, &transitions, true);
+        QByteArray result;
+        for (int i = 0; i < 6; ++i) {
+            for (Transition &transition : transitions)
+                transition.set(property, i < 3 ? before : after);
+            Frame *frame = tractor.get_frame();
+            mlt_image_format format = mlt_image_yuv422;
+            int width = profile.width();
+            int height = profile.height();
+            uint8_t *image = frame->get_image(format, width, height);
+            result.append(reinterpret_cast<const char *>(image), width * height * 2);
+            delete frame;
+        }
+        return result;
+    }
 };
 
 QTEST_APPLESS_MAIN(TestTractor)
@@ -1,5 +1,7 @@
 TEMPLATE = subdirs
 SUBDIRS = test_audio \
+    test_cache \
+    test_consumer \
     test_filter \
     test_events \
     test_frame \
@@ -11,4 +13,5 @@ SUBDIRS = test_audio \
     test_animation \
     test_tractor \
     test_service \
+    test_slices \
     test_xml